@@ -314,6 +314,9 @@ extern uint8_t *startgen0, *endgen0; /* used by x86builtins.S */
 uint8_t *startgen0, *endgen0, *posgen0;
 static ulong minor_offset, save_offset;
 
+/* posgen0 as of the last time allocations were counted in gcstats.allocated */
+static uint8_t *alloc_mark;
+
 static struct ary mcode_ary;    /* currently seen mcode objects */
 
 /* During GC, the newstart0, newend0, newpos0 variables fulfill the same roles
@@ -430,6 +433,7 @@ void garbage_init(void)
   ulong half = (gcblocksize / 2) & ~(sizeof (value) - 1);
   posgen0 = endgen0 = gcblock + gcblocksize;
   startgen0 = endgen0 - half;
+  alloc_mark = posgen0;
 
 #ifdef GCDEBUG
   minorgen = 98146523;		/* Must be odd */
@@ -1162,8 +1166,15 @@ static void new_major_collection(ulong newsize)
 #endif
 }
 
+ulong gc_allocated_bytes(void)
+{
+  return gcstats.allocated + (alloc_mark - posgen0);
+}
+
 void garbage_collect(long n)
 {
+  gcstats.allocated += alloc_mark - posgen0;
+
   /* clear all free lists */
   memset(free_lists, 0, sizeof free_lists);
 
@@ -1315,6 +1326,8 @@ void garbage_collect(long n)
   ary_free(&mcode_ary);
 
   free_static_data_table();
+
+  alloc_mark = posgen0;
 }
 
 long gc_reserve(long x)
@@ -2067,6 +2080,48 @@ static void update_legacy_table(union legacy_table *ltab)
     ltab->o32.o.size = sizeof ltab->o32.o + sizeof ltab->o32.u.new;
 }
 
+/* set when loading data saved before MDATA_VER_TABLE_FIELDS */
+static bool pad_old_tables;
+
+/* tables saved before struct table got its resize and prefix index fields
+   are padded with NULLs on load */
+static ulong loaded_record_size(enum mudlle_type type, ulong size)
+{
+  if (pad_old_tables && type == type_table && size < sizeof (struct table))
+    return sizeof (struct table);
+  return size;
+}
+
+/* Returns an upper bound of how much the tables among the saved objects
+   from 'data' to 'end' grow when padded by loaded_record_size(). */
+static ulong old_tables_growth(const uint8_t *data, const uint8_t *end,
+                               bool obj32)
+{
+  ulong tables = 0;
+  while (data < end)
+    {
+      ulong size;
+      enum mudlle_type type;
+      if (obj32)
+        {
+          const struct obj32 *o = (const struct obj32 *)data;
+          size = MUDLLE_ALIGN(ntohl(o->size), sizeof (uint32_t));
+          type = o->type;
+        }
+      else
+        {
+          const struct obj *o = (const struct obj *)data;
+          size = MUDLLE_ALIGN(ntohlong(o->size), sizeof (value));
+          type = o->type;
+        }
+      assert(size > 0);
+      if (type == type_table)
+        ++tables;
+      data += size;
+    }
+  return tables * MUDLLE_ALIGN(sizeof (struct table), sizeof (value));
+}
+
 static void load_forward(void *_ptr)
 {
   union obj_adr *ptr = _ptr;
@@ -2087,7 +2142,9 @@ static void load_forward(void *_ptr)
 	update_legacy_table((union legacy_table *)obj);
       obj->flags = ntohs(obj->flags);
 
-      ulong asize = MUDLLE_ALIGN(obj->size, sizeof (value));
+      ulong osize = obj->size;
+      ulong nsize = loaded_record_size(obj->type, osize);
+      ulong asize = MUDLLE_ALIGN(nsize, sizeof (value));
       newobj = (struct obj *)(newpos0 -= asize);
       assert(newpos0 >= newstart0);
 #ifdef GCDEBUG
@@ -2097,6 +2154,11 @@ static void load_forward(void *_ptr)
       if (obj->size > maxobjsize) maxobjsize = obj->size;
 #endif
       ptr->o = move_object(obj, newobj, minorgen);
+      if (nsize > osize)
+        {
+          memset((uint8_t *)newobj + osize, 0, nsize - osize);
+          newobj->size = nsize;
+        }
     }
 }
 
@@ -2272,6 +2334,8 @@ static void internal_load_forward32(void *_ptr, bool strip_generation)
     default:
       abort();
     }
+  uint32_t rsize = nsize;	/* native size of the saved data */
+  nsize = loaded_record_size(obj->type, nsize);
   uint32_t asize = MUDLLE_ALIGN(nsize, sizeof (value));
   struct obj *newobj = (struct obj *)(newpos0 -= asize);
   assert(newpos0 >= newstart0);
@@ -2302,6 +2366,7 @@ static void internal_load_forward32(void *_ptr, bool strip_generation)
             ulong d64 = pointerp(d32) ? d32 : (long)(int32_t)d32;
             ((struct grecord *)newobj)->data[i] = (value)htonlong(d64);
           }
+        memset((uint8_t *)newobj + rsize, 0, nsize - rsize);
         break;
       }
     default:
@@ -2374,7 +2439,13 @@ static value gc_load32(void *_load, unsigned long size,
 
   from_offset = (ulong)load - ntohl(*(uint32_t *)load);
 
-  gc_reserve((size - sizeof (uint32_t) - sizeof (uint32_t)) * 2);
+  pad_old_tables = version < MDATA_VER_TABLE_FIELDS;
+  ulong growth = 0;
+  if (pad_old_tables)
+    growth = old_tables_growth((uint8_t *)gone + gsize + sizeof (uint32_t),
+                               load + size, true);
+
+  gc_reserve((size - sizeof (uint32_t) - sizeof (uint32_t)) * 2 + growth);
 
   return _gc_load(forwarder, load, &old, size, true,
                   version < MDATA_VER_RO_SYM_NAMES);
@@ -2419,7 +2490,12 @@ value gc_load(void *_load, unsigned long size,
 
   from_offset = (ulong)load - ntohlong((ulong)*(uint8_t **)load);
 
-  gc_reserve(size - sizeof (uint8_t *) - sizeof (value));
+  pad_old_tables = version < MDATA_VER_TABLE_FIELDS;
+  ulong growth = 0;
+  if (pad_old_tables)
+    growth = old_tables_growth((uint8_t *)(old + 1), load + size, false);
+
+  gc_reserve(size - sizeof (uint8_t *) - sizeof (value) + growth);
 
   return _gc_load(forwarder, load, old, size, version < MDATA_VER_NEW_HASH,
                   version < MDATA_VER_RO_SYM_NAMES);
@@ -272,6 +272,7 @@ struct gcstats_alloc {
 struct gcstats
 {
   ulong minor_count, major_count;
+  ulong allocated;              /* bytes allocated up to the last GC */
 #ifdef GCSTATS
   ulong size, usage_minor, usage_major;
   struct gcstats_gen gen[2];
@@ -291,6 +292,9 @@ static inline void gcstats_add_alloc(enum mudlle_type type, ulong size)
 
 struct vector *all_mudlle_code(void);
 
+ulong gc_allocated_bytes(void);
+/* Returns: the total number of bytes allocated in generation 0 so far */
+
 void garbage_collect(long n);
 /* Effects: Does a garbage collection, ensuring that n bytes will be
      available at its completion.
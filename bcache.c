@@ -0,0 +1,749 @@
+/*
+ * Copyright (c) 1993-2012 David Gay and Gustav Hllberg
+ * All rights reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose, without fee, and without written agreement is hereby granted,
+ * provided that the above copyright notice and the following two paragraphs
+ * appear in all copies of this software.
+ *
+ * IN NO EVENT SHALL DAVID GAY OR GUSTAV HALLBERG BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES ARISING OUT
+ * OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF DAVID GAY OR
+ * GUSTAV HALLBERG HAVE BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * DAVID GAY AND GUSTAV HALLBERG SPECIFICALLY DISCLAIM ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN
+ * "AS IS" BASIS, AND DAVID GAY AND GUSTAV HALLBERG HAVE NO OBLIGATION TO
+ * PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ */
+
+#include "mudlle-config.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <netinet/in.h>
+
+#include <sys/stat.h>
+
+#include "alloc.h"
+#include "bcache.h"
+#include "calloc.h"
+#include "code.h"
+#include "env.h"
+#include "global.h"
+#include "hash.h"
+#include "ins.h"
+#include "mcompile.h"
+#include "module.h"
+#include "mvalues.h"
+#include "tree.h"
+
+/* Bump BCACHE_MAGIC whenever the cache format or the byte code changes */
+#define BCACHE_MAGIC 0x6d626301
+
+/* Cached file layout (a vector) */
+enum {
+  bc_stamp,                     /* modification time and size of source */
+  bc_digest,                    /* SHA-256 of source */
+  bc_seclevel,
+  bc_class,                     /* module header */
+  bc_name,                      /* string or null */
+  bc_line,
+  bc_requires,                  /* lists of (name . line) */
+  bc_defines,
+  bc_reads,
+  bc_writes,
+  bc_statics,
+  bc_depends,                   /* list of vector(bd_xxx) */
+  bc_code,                      /* top-level code (vector(bcc_xxx)) */
+  bc_fields
+};
+
+/* Dependencies on global variables */
+enum {
+  bd_name,
+  bd_module,                    /* owning (protected) module */
+  bd_type,
+  bd_value,                     /* nargs for primitives, value for integers */
+  bd_immutable,
+  bd_fields
+};
+
+/* Code */
+enum {
+  bcc_varname,
+  bcc_help,
+  bcc_arguments,
+  bcc_linenos,
+  bcc_lineno,
+  bcc_column,
+  bcc_return_typeset,
+  bcc_nb_locals,
+  bcc_stkdepth,
+  bcc_instructions,             /* string */
+  bcc_constants,                /* vector, with false for specials */
+  bcc_specials,                 /* list of (index . code vector|global) */
+  bcc_globals,                  /* list of (offset . global) */
+  bcc_fields
+};
+
+static enum mudlle_type value_type(value v)
+{
+  if (v == NULL)
+    return type_null;
+  if (integerp(v))
+    return type_integer;
+  return ((struct obj *)v)->type;
+}
+
+/* directory for cached files, or NULL to keep them next to the source */
+static char *cache_directory;
+
+void bcache_set_directory(const char *dir)
+{
+  free(cache_directory);
+  cache_directory = dir ? xstrdup(dir) : NULL;
+}
+
+/* Returns: the name of the cached file for source file 'path', which the
+     caller must free() */
+static char *cache_filename(const char *path)
+{
+  if (cache_directory == NULL)
+    {
+      char *name = xmalloc(strlen(path) + 2);
+      sprintf(name, "%sc", path);
+      return name;
+    }
+
+  /* name the file by a digest of the full source path */
+  char *full = realpath(path, NULL);
+  unsigned char digest[SHA256_SIZE];
+  const char *key = full ? full : path;
+  sha256(key, strlen(key), digest);
+  free(full);
+
+  char *name = xmalloc(strlen(cache_directory) + 2 * SHA256_SIZE + 7);
+  char *dst = name + sprintf(name, "%s/", cache_directory);
+  for (int i = 0; i < SHA256_SIZE; ++i)
+    dst += sprintf(dst, "%02x", digest[i]);
+  strcpy(dst, ".mudc");
+  return name;
+}
+
+static bool source_stamp(const char *path, char stamp[static 64],
+                         unsigned char digest[static SHA256_SIZE])
+{
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  bool ok = false;
+  struct stat st;
+  if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode))
+    goto done;
+
+  snprintf(stamp, 64, "%lld %lld", (long long)st.st_mtime,
+           (long long)st.st_size);
+
+  char *data = malloc(st.st_size + 1);
+  if (data == NULL)
+    goto done;
+  ok = read(fd, data, st.st_size) == st.st_size;
+  if (ok)
+    sha256(data, st.st_size, digest);
+  free(data);
+
+ done:
+  close(fd);
+  return ok;
+}
+
+/* Returns: the length of the instruction at 'i', or -1 if unknown; sets
+     *is_global if its argument is a global variable offset */
+static int instruction_length(const union instruction *i, bool *is_global)
+{
+  enum operator op = i->op;
+  *is_global = false;
+
+  const int vclasses = vclass_global + 1;
+  if (op >= op_recall && op < op_closure_var + vclasses)
+    {
+      if ((op - op_recall) % vclasses == vclass_global)
+        {
+          *is_global = true;
+          return 3;
+        }
+      return 2;
+    }
+  if (op >= op_builtin_eq && op <= op_builtin_not)
+    return 1;
+  if (op == op_typeset_check
+      || (op >= op_typecheck && op < op_typecheck + last_synthetic_type))
+    return 2;
+
+  switch (op)
+    {
+    case op_return: case op_varargs: case op_discard:
+      return 1;
+    case op_constant1: case op_integer1: case op_closure:
+    case op_closure_code1: case op_execute: case op_execute_secure:
+    case op_execute_varargs: case op_execute_primitive: case op_argcheck:
+    case op_pop_n: case op_exit_n: case op_branch1: case op_loop1:
+    case op_branch_nz1: case op_branch_z1: case op_clear_local:
+      return 2;
+    case op_constant2: case op_integer2: case op_closure_code2:
+    case op_execute2: case op_execute_secure2: case op_execute_varargs2:
+    case op_execute_primitive2: case op_branch2: case op_loop2:
+    case op_branch_nz2: case op_branch_z2:
+      return 3;
+    case op_execute_primitive_1arg: case op_execute_primitive_2arg:
+    case op_execute_global_1arg: case op_execute_global_2arg:
+    case op_define:
+      *is_global = true;
+      return 3;
+    default:
+      return -1;
+    }
+}
+
+/* Writing
+   ------- */
+
+struct dependencies {
+  ulong *n;
+  size_t used, size;
+};
+
+static void add_dependency(ulong n, void *data)
+{
+  struct dependencies *deps = data;
+  if (deps->used == deps->size)
+    {
+      deps->size = deps->size ? 2 * deps->size : 16;
+      deps->n = xrealloc(deps->n, deps->size * sizeof *deps->n);
+    }
+  deps->n[deps->used++] = n;
+}
+
+/* Returns: true if 'v' can be saved with gc_save() */
+static bool saveable(value v)
+{
+  if (!pointerp(v))
+    return true;
+  struct obj *obj = v;
+  return !(obj->garbage_type == garbage_primitive
+           || obj->garbage_type == garbage_temp
+           || obj->garbage_type == garbage_code
+           || obj->garbage_type == garbage_mcode
+           || obj->type == type_closure
+           || obj->type == type_oport
+           || obj->type == type_internal
+           || obj->type == type_private);
+}
+
+static struct vector *encode_code(struct icode *code,
+                                  const struct dependencies *deps)
+{
+  struct vector *result = NULL;
+  value v = NULL;
+  GCPRO(code, result, v);
+
+  result = alloc_vector(bcc_fields);
+  ulong ncsts = code->nb_constants;
+  v = alloc_vector(ncsts);
+  result->data[bcc_constants] = v;
+  for (ulong i = 0; i < ncsts; ++i)
+    {
+#define CST(i) (((struct vector *)result->data[bcc_constants])->data[i])
+      value c = code->constants[i];
+      if (!pointerp(c))
+        {
+          CST(i) = c;
+          continue;
+        }
+
+      /* values inlined from globals are looked up again when loading */
+      v = NULL;
+      for (size_t d = 0; d < deps->used; ++d)
+        if (GVAR(deps->n[d]) == c)
+          {
+            v = GNAME(deps->n[d]);
+            break;
+          }
+
+      if (v == NULL)
+        {
+          if (TYPE(c, code))
+            {
+              v = encode_code(c, deps);
+              if (v == NULL)
+                goto failed;
+            }
+          else if (!saveable(c))
+            goto failed;
+          else
+            {
+              CST(i) = c;
+              continue;
+            }
+        }
+      CST(i) = makebool(false);
+#undef CST
+      v = alloc_list(makeint(i), v);
+      v = alloc_list(v, result->data[bcc_specials]);
+      result->data[bcc_specials] = v;
+    }
+
+  ulong nins = ((union instruction *)((char *)code + code->code.o.size)
+                - (union instruction *)&code->constants[ncsts]);
+  v = alloc_empty_string(nins);
+  memcpy(((struct string *)v)->str, &code->constants[ncsts], nins);
+  result->data[bcc_instructions] = v;
+
+  for (ulong ofs = 0; ofs < nins; )
+    {
+      struct string *ins = result->data[bcc_instructions];
+      bool is_global;
+      int len = instruction_length(
+        (union instruction *)(ins->str + ofs), &is_global);
+      if (len < 0 || ofs + len > nins)
+        goto failed;
+      if (is_global)
+        {
+          const uint8_t *arg = (uint8_t *)ins->str + ofs + 1;
+          ulong n = (arg[0] << 8) | arg[1];
+          /* references to global variables pass their offset as an
+             integer constant, which cannot be relocated */
+          if (strcmp(GNAME(n)->str, "make_variable_ref") == 0)
+            goto failed;
+          v = alloc_list(makeint(ofs + 1), GNAME(n));
+          v = alloc_list(v, result->data[bcc_globals]);
+          result->data[bcc_globals] = v;
+        }
+      ofs += len;
+    }
+
+  result->data[bcc_varname]        = code->code.varname;
+  result->data[bcc_help]           = code->code.help;
+  result->data[bcc_arguments]      = code->code.arguments.obj;
+  result->data[bcc_linenos]        = code->code.linenos;
+  result->data[bcc_lineno]         = makeint(code->code.lineno);
+  result->data[bcc_column]         = makeint(code->code.column);
+  result->data[bcc_return_typeset] = makeint(code->code.return_typeset);
+  result->data[bcc_nb_locals]      = makeint(code->nb_locals);
+  result->data[bcc_stkdepth]       = makeint(code->stkdepth);
+
+  UNGCPRO();
+  return result;
+
+ failed:
+  UNGCPRO();
+  return NULL;
+}
+
+static struct list *encode_vlist(struct vlist *l)
+{
+  struct list *result = NULL;
+  struct string *name = NULL;
+  GCPRO(result, name);
+  for (; l; l = l->next)
+    {
+      name = alloc_string(l->var);
+      result = alloc_list(alloc_list(name, makeint(l->loc.line)), result);
+    }
+  UNGCPRO();
+  return result;
+}
+
+static struct vector *encode_dependency(ulong n)
+{
+  struct vector *dep = alloc_vector(bd_fields);
+  struct string *mod;
+  enum vstatus status = module_vstatus(n, &mod);
+  assert(status == var_module);
+
+  value v = GVAR(n);
+  enum mudlle_type type = value_type(v);
+  dep->data[bd_name]      = GNAME(n);
+  dep->data[bd_module]    = mod;
+  dep->data[bd_type]      = makeint(type);
+  dep->data[bd_immutable] = makebool(immutablep(v));
+  if (type == type_primitive || type == type_secure || type == type_varargs)
+    dep->data[bd_value] = makeint(((struct primitive *)v)->op->nargs);
+  else if (type == type_integer)
+    dep->data[bd_value] = v;
+  else
+    dep->data[bd_value] = makebool(false);
+  return dep;
+}
+
+static void save_cache(const char *path, value cache)
+{
+  ulong size;
+  void *data = gc_save(cache, &size);
+  if (data == NULL)
+    return;
+
+  char *cname = cache_filename(path);
+  static const char tpattern[] = "%s.XXXXXX";
+  char tmpname[strlen(cname) + sizeof tpattern];
+  sprintf(tmpname, tpattern, cname);
+
+  int fd = mkstemp(tmpname);
+  if (fd < 0)
+    {
+      free(cname);
+      return;
+    }
+
+  uint32_t header[] = {
+    htonl(BCACHE_MAGIC),
+    htonl(MDATA_VER_CURRENT),
+    htonl(size)
+  };
+  bool ok = (write(fd, header, sizeof header) == sizeof header
+             && write(fd, data, size) == size);
+  fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  ok = close(fd) == 0 && ok;
+  if (!ok || rename(tmpname, cname) < 0)
+    unlink(tmpname);
+  free(cname);
+}
+
+void bcache_write(const char *path, struct mfile *f, struct closure *closure,
+                  seclev_t seclev)
+{
+  char stamp[64];
+  unsigned char digest[SHA256_SIZE];
+  if (!source_stamp(path, stamp, digest))
+    return;
+
+  struct dependencies deps = { 0 };
+  mforeach_dependency(add_dependency, &deps);
+
+  struct vector *cache = NULL;
+  struct list *l = NULL;
+  GCPRO(closure, cache, l);
+
+  cache = alloc_vector(bc_fields);
+  cache->data[bc_seclevel] = makeint(seclev);
+  cache->data[bc_class]    = makeint(f->vclass);
+  cache->data[bc_line]     = makeint(f->loc.line);
+
+  /* n.b., assign allocated values via a temporary as cache may move */
+  value v;
+  v = alloc_string(stamp);
+  cache->data[bc_stamp] = v;
+  v = alloc_string_length((char *)digest, SHA256_SIZE);
+  cache->data[bc_digest] = v;
+  if (f->name)
+    {
+      v = alloc_string(f->name);
+      cache->data[bc_name] = v;
+    }
+  v = encode_vlist(f->requires);
+  cache->data[bc_requires] = v;
+  v = encode_vlist(f->defines);
+  cache->data[bc_defines] = v;
+  v = encode_vlist(f->reads);
+  cache->data[bc_reads] = v;
+  v = encode_vlist(f->writes);
+  cache->data[bc_writes] = v;
+  v = encode_vlist(f->statics);
+  cache->data[bc_statics] = v;
+
+  for (size_t d = 0; d < deps.used; ++d)
+    {
+      struct vector *dep = encode_dependency(deps.n[d]);
+      l = alloc_list(dep, l);
+    }
+  cache->data[bc_depends] = l;
+
+  struct vector *code = encode_code((struct icode *)closure->code, &deps);
+  if (code == NULL)
+    goto done;
+  cache->data[bc_code] = code;
+
+  save_cache(path, cache);
+
+ done:
+  UNGCPRO();
+  free(deps.n);
+}
+
+/* Reading
+   ------- */
+
+struct vector *bcache_read(const char *path, seclev_t seclev)
+{
+  char *cname = cache_filename(path);
+  int fd = open(cname, O_RDONLY);
+  free(cname);
+  if (fd < 0)
+    return NULL;
+
+  value result = NULL;
+  uint32_t header[3];
+  if (read(fd, header, sizeof header) != sizeof header
+      || ntohl(header[0]) != BCACHE_MAGIC
+      || ntohl(header[1]) > MDATA_VER_CURRENT)
+    goto done;
+
+  uint32_t size = ntohl(header[2]);
+  void *data = malloc(size);
+  if (data == NULL)
+    goto done;
+  if (read(fd, data, size) == size)
+    result = gc_load(data, size, ntohl(header[1]));
+  free(data);
+
+ done:
+  close(fd);
+
+  struct vector *cache = result;
+  if (!TYPE(cache, vector) || vector_len(cache) != bc_fields)
+    return NULL;
+
+  char stamp[64];
+  unsigned char digest[SHA256_SIZE];
+  struct string *cstamp = cache->data[bc_stamp];
+  struct string *cdigest = cache->data[bc_digest];
+  if (cache->data[bc_seclevel] != makeint(seclev)
+      || !TYPE(cstamp, string) || !TYPE(cdigest, string)
+      || string_len(cdigest) != SHA256_SIZE
+      || !TYPE(cache->data[bc_code], vector)
+      || !source_stamp(path, stamp, digest)
+      || strcmp(cstamp->str, stamp) != 0
+      || memcmp(cdigest->str, digest, SHA256_SIZE) != 0)
+    return NULL;
+
+  return cache;
+}
+
+static struct vlist *decode_vlist(struct alloc_block *heap, value l,
+                                  const struct filename *fname)
+{
+  struct vlist *result = NULL;
+  for (; TYPE(l, pair); l = ((struct list *)l)->cdr)
+    {
+      struct list *entry = ((struct list *)l)->car;
+      struct string *name = entry->car;
+      const struct loc loc = {
+        .fname = fname,
+        .line  = intval(entry->cdr),
+        .col   = 1
+      };
+      result = new_vlist(heap, heap_allocate_string(heap, name->str),
+                         TYPESET_ANY, &loc, result);
+    }
+  return result;
+}
+
+struct mfile *bcache_mfile(struct alloc_block *heap, struct vector *cache,
+                           const struct filename *fname)
+{
+  struct string *name = cache->data[bc_name];
+  const struct loc loc = {
+    .fname = fname,
+    .line  = intval(cache->data[bc_line]),
+    .col   = 1
+  };
+  return new_file(heap, intval(cache->data[bc_class]),
+                  name ? heap_allocate_string(heap, name->str) : NULL,
+                  decode_vlist(heap, cache->data[bc_requires], fname),
+                  decode_vlist(heap, cache->data[bc_defines], fname),
+                  decode_vlist(heap, cache->data[bc_reads], fname),
+                  decode_vlist(heap, cache->data[bc_writes], fname),
+                  decode_vlist(heap, cache->data[bc_statics], fname),
+                  NULL, &loc);
+}
+
+static bool valid_dependency(struct vector *dep)
+{
+  GCPRO(dep);
+  ulong n = mglobal_lookup(dep->data[bd_name]);
+  UNGCPRO();
+  struct string *mod;
+  if (module_vstatus(n, &mod) != var_module
+      || strcasecmp(mod->str, ((struct string *)dep->data[bd_module])->str)
+      || module_status(mod->str) != module_protected)
+    return false;
+
+  value v = GVAR(n);
+  enum mudlle_type type = value_type(v);
+  if (makeint(type) != dep->data[bd_type]
+      || makebool(immutablep(v)) != dep->data[bd_immutable])
+    return false;
+  if (type == type_primitive || type == type_secure || type == type_varargs)
+    return makeint(((struct primitive *)v)->op->nargs) == dep->data[bd_value];
+  if (type == type_integer)
+    return v == dep->data[bd_value];
+  return true;
+}
+
+bool bcache_valid(struct vector *cache)
+{
+  struct list *l = cache->data[bc_depends];
+  bool ok = true;
+  GCPRO(l);
+  for (; ok && l; l = l->cdr)
+    ok = valid_dependency(l->car);
+  UNGCPRO();
+  return ok;
+}
+
+/* Returns: true if the current module may use the global variables
+     referenced by code 'v' and the functions it contains */
+static bool check_code(struct vector *v, const struct filename *fname)
+{
+  struct list *l = NULL;
+  bool ok = true;
+  GCPRO(v, l);
+
+  const struct loc loc = {
+    .fname = fname,
+    .line  = intval(v->data[bcc_lineno]),
+    .col   = intval(v->data[bcc_column])
+  };
+  for (l = v->data[bcc_globals]; l; l = l->cdr)
+    {
+      struct list *entry = l->car;
+      struct string *instructions = v->data[bcc_instructions];
+      ulong ofs = intval(entry->car);
+      enum mglobal_use use = mglobal_read;
+      if ((uint8_t)instructions->str[ofs - 1] == op_define)
+        use = mglobal_define;
+      else if ((uint8_t)instructions->str[ofs - 1] == op_assign_global)
+        use = mglobal_write;
+      if (!mcheck_global(&loc, mglobal_lookup(entry->cdr), use))
+        ok = false;
+    }
+
+  for (l = v->data[bcc_specials]; l; l = l->cdr)
+    {
+      struct list *entry = l->car;
+      if (TYPE(entry->cdr, vector) && !check_code(entry->cdr, fname))
+        ok = false;
+    }
+
+  UNGCPRO();
+  return ok;
+}
+
+bool bcache_check(struct vector *cache, const struct filename *fname)
+{
+  return check_code(cache->data[bc_code], fname);
+}
+
+static struct icode *decode_code(struct vector *v,
+                                 const struct filename *fname,
+                                 seclev_t seclev)
+{
+  struct string *filename = NULL, *nicename = NULL;
+  struct list *l = NULL;
+  value special = NULL;
+  GCPRO(v, filename, nicename, l, special);
+
+  struct string *instructions = v->data[bcc_instructions];
+  struct vector *csts = v->data[bcc_constants];
+  if (!TYPE(instructions, string) || !TYPE(csts, vector))
+    goto failed;
+  ulong ncsts = vector_len(csts);
+  ulong nins = string_len(instructions);
+
+  /* The code object is immutable, so resolve everything it refers to
+     in the (mutable) cache before allocating it. */
+  for (l = v->data[bcc_specials]; l; l = l->cdr)
+    {
+      struct list *entry = l->car;
+      ulong i = intval(entry->car);
+      special = entry->cdr;
+      if (TYPE(special, vector))
+        special = decode_code(special, fname, seclev);
+      else if (TYPE(special, string))
+        special = GVAR(mglobal_lookup(special));
+      else
+        special = NULL;
+      if (special == NULL || i >= ncsts)
+        goto failed;
+      csts = v->data[bcc_constants];
+      csts->data[i] = special;
+    }
+
+  for (l = v->data[bcc_globals]; l; l = l->cdr)
+    {
+      struct list *entry = l->car;
+      ulong ofs = intval(entry->car);
+      ulong n = mglobal_lookup(entry->cdr);
+      if (n > UINT16_MAX || ofs + 2 > nins)
+        goto failed;
+      instructions = v->data[bcc_instructions];
+      instructions->str[ofs] = n >> 8;
+      instructions->str[ofs + 1] = n & 0xff;
+    }
+
+  filename = make_readonly(alloc_string(fname->path));
+  nicename = make_readonly(alloc_string(fname->nice));
+
+  ulong size = (offsetof(struct icode, constants)
+                + ncsts * sizeof (value)
+                + nins * sizeof (union instruction));
+  struct icode *code = gc_allocate(size);
+  *code = (struct icode){
+    .code = {
+      .o = {
+        .size         = size,
+        .garbage_type = garbage_code,
+        .type         = type_code,
+        .flags        = OBJ_IMMUTABLE, /* code is immutable */
+#ifdef GCDEBUG
+        .generation   = code->code.o.generation,
+#endif
+      },
+      .varname        = v->data[bcc_varname],
+      .filename       = filename,
+      .nicename       = nicename,
+      .help           = v->data[bcc_help],
+      .arguments.obj  = v->data[bcc_arguments],
+      .linenos        = v->data[bcc_linenos],
+      .lineno         = intval(v->data[bcc_lineno]),
+      .column         = intval(v->data[bcc_column]),
+      .seclevel       = seclev,
+      .return_typeset = intval(v->data[bcc_return_typeset]),
+    },
+    .nb_constants      = ncsts,
+    .nb_locals         = intval(v->data[bcc_nb_locals]),
+    .stkdepth          = intval(v->data[bcc_stkdepth]),
+    .instruction_count = 0,
+  };
+  csts = v->data[bcc_constants];
+  memcpy(code->constants, csts->data, ncsts * sizeof (value));
+  instructions = v->data[bcc_instructions];
+  memcpy(&code->constants[ncsts], instructions->str, nins);
+  set_icode_dispatch(code);
+
+  UNGCPRO();
+  return code;
+
+ failed:
+  UNGCPRO();
+  return NULL;
+}
+
+struct closure *bcache_closure(struct vector *cache,
+                               const struct filename *fname)
+{
+  struct icode *code = decode_code(cache->data[bc_code], fname,
+                                   intval(cache->data[bc_seclevel]));
+  if (code == NULL)
+    return NULL;
+  return alloc_closure0(&code->code);
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 1993-2012 David Gay and Gustav Hllberg
+ * All rights reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose, without fee, and without written agreement is hereby granted,
+ * provided that the above copyright notice and the following two paragraphs
+ * appear in all copies of this software.
+ *
+ * IN NO EVENT SHALL DAVID GAY OR GUSTAV HALLBERG BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES ARISING OUT
+ * OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF DAVID GAY OR
+ * GUSTAV HALLBERG HAVE BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * DAVID GAY AND GUSTAV HALLBERG SPECIFICALLY DISCLAIM ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN
+ * "AS IS" BASIS, AND DAVID GAY AND GUSTAV HALLBERG HAVE NO OBLIGATION TO
+ * PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ */
+
+#ifndef BCACHE_H
+#define BCACHE_H
+
+#include "mudlle-config.h"
+
+#include <stdbool.h>
+
+#include "types.h"
+
+struct alloc_block;
+struct filename;
+struct mfile;
+
+/* Bytecode cache for interpreted files
+
+   When an interpreted file is compiled, its code is saved in a sidecar
+   file next to it (the file name with a 'c' appended), or in the directory
+   set with bcache_set_directory(). The cached code is used instead of
+   compiling the file again as long as the source file is unchanged and the
+   globals whose values the compiler used (e.g., to inline constants or call
+   primitives directly) still have compatible values. */
+
+void bcache_set_directory(const char *dir);
+/* Effects: Cached code is kept in directory 'dir', named by a digest of
+     the full source path, or next to the source files if 'dir' is NULL
+*/
+
+struct vector *bcache_read(const char *path, seclev_t seclev);
+/* Returns: the cached code for source file 'path', compiled at seclevel
+     'seclev', or NULL if there is none or if it is out of date
+*/
+
+struct mfile *bcache_mfile(struct alloc_block *heap, struct vector *cache,
+                           const struct filename *fname);
+/* Returns: the module header of the cached code 'cache', allocated in
+     'heap'. The header has no body.
+*/
+
+bool bcache_valid(struct vector *cache);
+/* Returns: true if the global variables whose values were used to
+     generate the code in 'cache' are unchanged.
+   Requires: the modules required by 'cache' are loaded
+*/
+
+bool bcache_check(struct vector *cache, const struct filename *fname);
+/* Effects: Checks that the current module may read, write and define the
+     global variables used by the code in 'cache', as when compiling it.
+     Logs error messages otherwise.
+   Returns: true if allowed
+   Requires: called between mstart() and mstop() for the cached module
+*/
+
+struct closure *bcache_closure(struct vector *cache,
+                               const struct filename *fname);
+/* Returns: the top-level closure of the code in 'cache', or NULL if
+     'cache' is invalid
+*/
+
+void bcache_write(const char *path, struct mfile *f, struct closure *closure,
+                  seclev_t seclev);
+/* Effects: Saves the code of 'closure', the result of compiling module 'f'
+     from source file 'path', in the bytecode cache. Silently does nothing
+     if the code cannot be cached.
+   Requires: called between mstart(f) and mstop(f)
+*/
+
+#endif
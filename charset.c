@@ -25,8 +25,14 @@
 
 #include "mudlle-config.h"
 
+#include <stdbool.h>
 #include <stdlib.h>
 
+#if defined __i386__ || defined __x86_64__
+#  include <immintrin.h>
+#  define USE_SIMD_KERNELS
+#endif
+
 #include "charset.h"
 #include "mudlle-macro.h"
 
@@ -284,7 +290,7 @@ int str7icmp(const char *s1, const char *s2)
   return (c1 < c2) ? -1 : (c1 != c2);
 }
 
-int mem7icmp(const void *_s1, const void *_s2, size_t n)
+static int scalar_mem7icmp(const void *_s1, const void *_s2, size_t n)
 {
   const char *s1 = _s1, *s2 = _s2;
   int c1, c2;
@@ -309,7 +315,7 @@ int str7nicmp(const char *s1, const char *s2, int n)
   return 0;
 }
 
-void *mem7ichr(const void *_s, int _c, size_t n)
+static void *scalar_mem7ichr(const void *_s, int _c, size_t n)
 {
   int c = TO_7LOWER(_c);
   const char *s = _s;
@@ -323,6 +329,193 @@ void *mem7ichr(const void *_s, int _c, size_t n)
   return NULL;
 }
 
+static void scalar_memtrans(char *dst, const char *src, size_t n,
+                            const unsigned char *table)
+{
+  for (; n; --n, ++src, ++dst)
+    *dst = table[(unsigned char)*src];
+}
+
+/* The translation tables only differ from the identity on 7-bit characters
+   by mapping letters to lower or upper case. The vector kernels below
+   handle blocks of 7-bit characters directly, and hand any block containing
+   8-bit characters to the table-driven code. */
+
+#ifdef USE_SIMD_KERNELS
+
+/* folds_from_8bit[c] is true if an 8-bit character has TO_7LOWER() == c */
+static bool folds_from_8bit[256];
+
+/* vector operations for each instruction set */
+#define sse2_vec      __m128i
+#define sse2_width    16
+#define sse2_load     _mm_loadu_si128
+#define sse2_store    _mm_storeu_si128
+#define sse2_set1     _mm_set1_epi8
+#define sse2_cmpeq    _mm_cmpeq_epi8
+#define sse2_cmpgt    _mm_cmpgt_epi8
+#define sse2_and      _mm_and_si128
+#define sse2_or       _mm_or_si128
+#define sse2_xor      _mm_xor_si128
+#define sse2_movemask _mm_movemask_epi8
+
+#define avx2_vec      __m256i
+#define avx2_width    32
+#define avx2_load     _mm256_loadu_si256
+#define avx2_store    _mm256_storeu_si256
+#define avx2_set1     _mm256_set1_epi8
+#define avx2_cmpeq    _mm256_cmpeq_epi8
+#define avx2_cmpgt    _mm256_cmpgt_epi8
+#define avx2_and      _mm256_and_si256
+#define avx2_or       _mm256_or_si256
+#define avx2_xor      _mm256_xor_si256
+#define avx2_movemask _mm256_movemask_epi8
+
+#define V(isa, op) isa ## _ ## op
+
+/* lo..hi (signed) is the range of characters to flip the case of */
+#define DEF_SIMD_MEMTRANS(isa)                                          \
+static __attribute__((target(#isa)))                                    \
+void isa ## _memtrans(char *dst, const char *src, size_t n,             \
+                      const unsigned char *table, char lo, char hi)     \
+{                                                                       \
+  const V(isa, vec) vlo = V(isa, set1)(lo - 1);                         \
+  const V(isa, vec) vhi = V(isa, set1)(hi + 1);                         \
+  const V(isa, vec) vcase = V(isa, set1)(0x20);                         \
+  for (; n >= V(isa, width); n -= V(isa, width),                        \
+         src += V(isa, width), dst += V(isa, width))                    \
+    {                                                                   \
+      V(isa, vec) v = V(isa, load)((const V(isa, vec) *)src);           \
+      if (V(isa, movemask)(v))                                          \
+        {                                                               \
+          scalar_memtrans(dst, src, V(isa, width), table);              \
+          continue;                                                     \
+        }                                                               \
+      V(isa, vec) m = V(isa, and)(V(isa, cmpgt)(v, vlo),                \
+                                  V(isa, cmpgt)(vhi, v));               \
+      V(isa, store)((V(isa, vec) *)dst,                                 \
+                    V(isa, xor)(v, V(isa, and)(m, vcase)));             \
+    }                                                                   \
+  scalar_memtrans(dst, src, n, table);                                  \
+}
+
+#define SIMD_LOWER(isa, v)                                              \
+  V(isa, or)(v, V(isa, and)(V(isa, and)(V(isa, cmpgt)(v, vlo),          \
+                                        V(isa, cmpgt)(vhi, v)),         \
+                            vcase))
+
+#define DEF_SIMD_MEM7ICMP(isa)                                          \
+static __attribute__((target(#isa)))                                    \
+int isa ## _mem7icmp(const void *_s1, const void *_s2, size_t n)        \
+{                                                                       \
+  const char *s1 = _s1, *s2 = _s2;                                      \
+  const V(isa, vec) vlo = V(isa, set1)('A' - 1);                        \
+  const V(isa, vec) vhi = V(isa, set1)('Z' + 1);                        \
+  const V(isa, vec) vcase = V(isa, set1)(0x20);                         \
+  for (; n >= V(isa, width); n -= V(isa, width),                        \
+         s1 += V(isa, width), s2 += V(isa, width))                      \
+    {                                                                   \
+      V(isa, vec) a = V(isa, load)((const V(isa, vec) *)s1);            \
+      V(isa, vec) b = V(isa, load)((const V(isa, vec) *)s2);            \
+      if (V(isa, movemask)(V(isa, or)(a, b)))                           \
+        {                                                               \
+          int r = scalar_mem7icmp(s1, s2, V(isa, width));               \
+          if (r)                                                        \
+            return r;                                                   \
+          continue;                                                     \
+        }                                                               \
+      unsigned eq = V(isa, movemask)(                                   \
+        V(isa, cmpeq)(SIMD_LOWER(isa, a), SIMD_LOWER(isa, b)));         \
+      if (eq != (unsigned)((1ULL << V(isa, width)) - 1))                \
+        {                                                               \
+          int i = __builtin_ctz(~eq);                                   \
+          return scalar_mem7icmp(s1 + i, s2 + i, 1);                    \
+        }                                                               \
+    }                                                                   \
+  return scalar_mem7icmp(s1, s2, n);                                    \
+}
+
+#define DEF_SIMD_MEM7ICHR(isa)                                          \
+static __attribute__((target(#isa)))                                    \
+void *isa ## _mem7ichr(const void *_s, int c, size_t n)                 \
+{                                                                       \
+  const char *s = _s;                                                   \
+  unsigned char lc = TO_7LOWER(c);                                      \
+  unsigned char uc = lc >= 'a' && lc <= 'z' ? lc - 0x20 : lc;           \
+  bool check_8bit = folds_from_8bit[lc];                                \
+  const V(isa, vec) vlc = V(isa, set1)(lc), vuc = V(isa, set1)(uc);     \
+  for (; n >= V(isa, width); n -= V(isa, width), s += V(isa, width))    \
+    {                                                                   \
+      V(isa, vec) v = V(isa, load)((const V(isa, vec) *)s);             \
+      if (check_8bit && V(isa, movemask)(v))                            \
+        {                                                               \
+          void *r = scalar_mem7ichr(s, c, V(isa, width));               \
+          if (r)                                                        \
+            return r;                                                   \
+          continue;                                                     \
+        }                                                               \
+      unsigned m = V(isa, movemask)(V(isa, or)(V(isa, cmpeq)(v, vlc),   \
+                                               V(isa, cmpeq)(v, vuc))); \
+      if (m)                                                            \
+        return (void *)(s + __builtin_ctz(m));                          \
+    }                                                                   \
+  return scalar_mem7ichr(s, c, n);                                      \
+}
+
+DEF_SIMD_MEMTRANS(sse2)
+DEF_SIMD_MEM7ICMP(sse2)
+DEF_SIMD_MEM7ICHR(sse2)
+
+DEF_SIMD_MEMTRANS(avx2)
+DEF_SIMD_MEM7ICMP(avx2)
+DEF_SIMD_MEM7ICHR(avx2)
+
+#endif  /* USE_SIMD_KERNELS */
+
+static void generic_memtrans(char *dst, const char *src, size_t n,
+                             const unsigned char *table, char lo, char hi)
+{
+  scalar_memtrans(dst, src, n, table);
+}
+
+/* The best kernels for this CPU; set by charset_init() */
+static struct {
+  int (*mem7icmp)(const void *s1, const void *s2, size_t n);
+  void *(*mem7ichr)(const void *s, int c, size_t n);
+  void (*memtrans)(char *dst, const char *src, size_t n,
+                   const unsigned char *table, char lo, char hi);
+} kernels = {
+  .mem7icmp = scalar_mem7icmp,
+  .mem7ichr = scalar_mem7ichr,
+  .memtrans = generic_memtrans,
+};
+
+int mem7icmp(const void *s1, const void *s2, size_t n)
+{
+  return kernels.mem7icmp(s1, s2, n);
+}
+
+void *mem7ichr(const void *s, int c, size_t n)
+{
+  return kernels.mem7ichr(s, c, n);
+}
+
+void mem8lwr(char *dst, const char *src, size_t n)
+{
+  kernels.memtrans(dst, src, n, latin1_to_lower, 'A', 'Z');
+}
+
+void mem8upr(char *dst, const char *src, size_t n)
+{
+  kernels.memtrans(dst, src, n, latin1_to_upper, 'a', 'z');
+}
+
+void mem7prt(char *dst, const char *src, size_t n)
+{
+  /* an empty range: 7-bit characters are all printable as is */
+  kernels.memtrans(dst, src, n, latin1_to_ascii_print, 1, 0);
+}
+
 void strto7print(char *str)
 {
   while (*str)
@@ -588,3 +781,25 @@ int lookup_named_character(const char *name, size_t namelen)
     return -1;
   return iso88591chars[entry - iso88591names];
 }
+
+void charset_init(void)
+{
+#ifdef USE_SIMD_KERNELS
+  for (int c = 0x80; c < 0x100; ++c)
+    folds_from_8bit[TO_7LOWER(c)] = true;
+
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    {
+      kernels.mem7icmp = avx2_mem7icmp;
+      kernels.mem7ichr = avx2_mem7ichr;
+      kernels.memtrans = avx2_memtrans;
+    }
+  else if (__builtin_cpu_supports("sse2"))
+    {
+      kernels.mem7icmp = sse2_mem7icmp;
+      kernels.mem7ichr = sse2_mem7ichr;
+      kernels.memtrans = sse2_memtrans;
+    }
+#endif
+}
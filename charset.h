@@ -57,12 +57,18 @@ int str7icmp(const char *s1, const char *s2);
 int mem7icmp(const void *_s1, const void *_s2, size_t n);
 int str7nicmp(const char *s1, const char *s2, int n);
 void *mem7ichr(const void *_s, int _c, size_t n);
+/* copy n characters from src to dst, converting them */
+void mem8lwr(char *dst, const char *src, size_t n);
+void mem8upr(char *dst, const char *src, size_t n);
+void mem7prt(char *dst, const char *src, size_t n);
 void strto7print(char *str);
 void str8lwr(char *str);
 void str7lwr(char *str);
 
 int lookup_named_character(const char *name, size_t namelen);
 
+void charset_init(void);
+
 #define FOR_CHAR_ESCAPES(op, sep)               \
   op('\a', 'a') sep()                           \
   op('\b', 'b') sep()                           \
@@ -25,6 +25,7 @@
 #include <string.h>
 
 #include "alloc.h"
+#include "bcache.h"
 #include "call.h"
 #include "calloc.h"
 #include "code.h"
@@ -929,7 +930,32 @@ static void docall0(void *_ci)
   *ci->result = call0(ci->f);
 }
 
-bool interpret(value *result, seclev_t seclev, bool reload)
+static bool run_module(value *result, struct mfile *f,
+                       struct closure *closure, seclev_t seclev)
+/* Effects: Runs closure, the top-level code of module f, and updates
+     the module's status
+   Returns: true if successful
+*/
+{
+  bool ok;
+  if (closure)
+    {
+      struct call_info ci = {
+        .f      = closure,
+        .result = result
+      };
+      ok = mcatch(docall0, &ci, call_trace_barrier);
+    }
+  else
+    ok = false;
+
+  if (f->name)
+    module_set(f->name, ok ? module_loaded : module_error, seclev);
+  return ok;
+}
+
+static bool interpret_file(value *result, seclev_t seclev, bool reload,
+                           const char *cache_path)
 {
   ASSERT_NOALLOC_START();
   struct alloc_block *parser_block = new_block();
@@ -953,23 +979,19 @@ bool interpret(value *result, seclev_t seclev, bool reload)
   if (mstart(parser_block, f, seclev))
     {
       struct closure *closure = compile_code(f, seclev);
-      if (closure)
-        mwarn_module(seclev, f->body);
-      mstop(f);
-
       if (closure)
         {
-          struct call_info ci = {
-            .f      = closure,
-            .result = result
-          };
-          ok = mcatch(docall0, &ci, call_trace_barrier);
+          mwarn_module(seclev, f->body);
+          if (cache_path)
+            {
+              GCPRO(closure);
+              bcache_write(cache_path, f, closure, seclev);
+              UNGCPRO();
+            }
         }
-      else
-        ok = false;
+      mstop(f);
 
-      if (f->name)
-        module_set(f->name, ok ? module_loaded : module_error, seclev);
+      ok = run_module(result, f, closure, seclev);
     }
   this_mfile = prev_mfile;
 
@@ -978,9 +1000,86 @@ bool interpret(value *result, seclev_t seclev, bool reload)
   return ok;
 }
 
+bool interpret(value *result, seclev_t seclev, bool reload)
+{
+  return interpret_file(result, seclev, reload, NULL);
+}
+
+ulong bcache_hits;
+
+static bool load_cached_file(const char *fullname,
+                             const struct filename *fname,
+                             seclev_t seclev, bool reload, bool *ok)
+/* Effects: Loads fullname from the bytecode cache, setting *ok to true if
+     successful
+   Returns: false if there was no valid cached code for fullname
+*/
+{
+  struct vector *cache = bcache_read(fullname, seclev);
+  if (cache == NULL)
+    return false;
+
+  bool used = false;
+  struct closure *closure = NULL;
+  GCPRO(cache, closure);
+  struct alloc_block *heap = new_block();
+  struct mfile *f = bcache_mfile(heap, cache, fname);
+
+  enum module_status status;
+  if (f->name && !reload
+      && (status = module_status(f->name)) != module_unloaded)
+    {
+      *ok = status == module_loaded;
+      used = true;
+      goto done;
+    }
+
+  /* the dependencies can only be checked once the required modules are
+     loaded; on failure, let the compiler report the errors */
+  for (struct vlist *mods = f->requires; mods; mods = mods->next)
+    if (module_require(mods->var) < module_loaded)
+      goto done;
+
+  if (!bcache_valid(cache)
+      || (closure = bcache_closure(cache, fname)) == NULL)
+    goto done;
+
+  used = true;
+  ++bcache_hits;
+  struct mfile *prev_mfile = this_mfile;
+  this_mfile = f;
+  if (mstart(heap, f, seclev))
+    {
+      /* redo the checks of the compiler on the globals the code uses */
+      bool allowed = bcache_check(cache, fname);
+      mstop(f);
+      value result;
+      if (allowed)
+        *ok = run_module(&result, f, closure, seclev);
+      else
+        {
+          if (f->name)
+            module_set(f->name, module_error, seclev);
+          *ok = false;
+        }
+    }
+  else
+    *ok = false;
+  this_mfile = prev_mfile;
+
+ done:
+  UNGCPRO();
+  free_block(heap);
+  return used;
+}
+
 bool load_file(const char *fullname, const struct filename *fname,
                seclev_t seclev, bool reload)
 {
+  bool ok;
+  if (load_cached_file(fullname, fname, seclev, reload, &ok))
+    return ok;
+
   FILE *f = fopen(fullname, "r");
   if (f == NULL)
     runtime_error(error_bad_value);
@@ -989,7 +1088,7 @@ bool load_file(const char *fullname, const struct filename *fname,
   save_reader_state(&rstate);
   read_from_file(f, fname);
   value result;
-  bool ok = interpret(&result, seclev, reload);
+  ok = interpret_file(&result, seclev, reload, fullname);
   fclose(f);
   restore_reader_state(&rstate);
 
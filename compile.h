@@ -52,5 +52,7 @@ extern struct mfile *this_mfile;
 
 bool load_file(const char *fullname, const struct filename *fname,
                seclev_t seclev, bool reload);
+/* number of files load_file() has taken from the bytecode cache */
+extern ulong bcache_hits;
 
 #endif
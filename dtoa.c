@@ -0,0 +1,305 @@
+/*
+ * Copyright (c) 1993-2012 David Gay and Gustav Hllberg
+ * All rights reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose, without fee, and without written agreement is hereby granted,
+ * provided that the above copyright notice and the following two paragraphs
+ * appear in all copies of this software.
+ *
+ * IN NO EVENT SHALL DAVID GAY OR GUSTAV HALLBERG BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES ARISING OUT
+ * OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF DAVID GAY OR
+ * GUSTAV HALLBERG HAVE BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * DAVID GAY AND GUSTAV HALLBERG SPECIFICALLY DISCLAIM ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN
+ * "AS IS" BASIS, AND DAVID GAY AND GUSTAV HALLBERG HAVE NO OBLIGATION TO
+ * PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ */
+
+/* Shortest round-trip double to decimal conversion, after Ulf Adams,
+   "Ryu: Fast Float-to-String Conversion" (PLDI 2018). */
+
+#include "mudlle-config.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "dtoa.h"
+
+#include "dtoa-tables.h"
+
+#define DOUBLE_MANTISSA_BITS 52
+#define DOUBLE_EXPONENT_BITS 11
+#define DOUBLE_BIAS          1023
+
+#define POW5_INV_BITCOUNT 125
+#define POW5_BITCOUNT     125
+
+/* %g switches to exponential notation at this many digits */
+#define DTOA_PRECISION 17
+
+/* ceil(log2(5^e)) for 0 < e <= 3528; 1 for e == 0 */
+static inline int pow5bits(int e)
+{
+  return ((uint32_t)e * 1217359 >> 19) + 1;
+}
+
+/* floor(log10(2^e)) for 0 <= e <= 1650 */
+static inline int log10_pow2(int e)
+{
+  return (uint32_t)e * 78913 >> 18;
+}
+
+/* floor(log10(5^e)) for 0 <= e <= 2620 */
+static inline int log10_pow5(int e)
+{
+  return (uint32_t)e * 732923 >> 20;
+}
+
+static int pow5_factor(uint64_t v)
+{
+  int n = 0;
+  for (; v % 5 == 0; v /= 5)
+    ++n;
+  return n;
+}
+
+static inline bool multiple_of_pow5(uint64_t v, int p)
+{
+  return pow5_factor(v) >= p;
+}
+
+static inline bool multiple_of_pow2(uint64_t v, int p)
+{
+  return (v & ((UINT64_C(1) << p) - 1)) == 0;
+}
+
+/* return (m * mul) >> j, where mul is a 128-bit { low, high } value and
+   64 < j < 128 */
+static uint64_t mul_shift64(uint64_t m, const uint64_t mul[2], int j)
+{
+  assert(j > 64 && j < 128);
+#ifdef HAVE___UINT128_T
+  __uint128_t b0 = (__uint128_t)m * mul[0];
+  __uint128_t b2 = (__uint128_t)m * mul[1];
+  return ((b0 >> 64) + b2) >> (j - 64);
+#else
+  /* from Hacker's Delight by Henry S. Warren, Jr. */
+  uint64_t hi[2], lo[2];
+  for (int i = 0; i < 2; ++i)
+    {
+      uint64_t b = mul[i];
+      uint32_t al = m, ah = m >> 32;
+      uint32_t bl = b, bh = b >> 32;
+      uint64_t albl = (uint64_t)al * bl;
+      uint64_t albh = (uint64_t)al * bh;
+      uint64_t ahbl = (uint64_t)ah * bl;
+      uint64_t ahbh = (uint64_t)ah * bh;
+
+      uint64_t s = albh + (albl >> 32);
+      uint64_t t = ahbl + (uint32_t)s;
+
+      lo[i] = (uint32_t)albl + (t << 32);
+      hi[i] = ahbh + (s >> 32) + (t >> 32);
+    }
+  uint64_t l = hi[0] + lo[1];
+  uint64_t h = hi[1] + (l < hi[0]);
+  int dist = j - 64;
+  return (h << (64 - dist)) | (l >> dist);
+#endif
+}
+
+/* compute the shortest decimal 'output' * 10^'exp' that lies within
+   the rounding interval of the double with the given fields */
+static void d2d(uint64_t ieee_mantissa, uint32_t ieee_exponent,
+                uint64_t *output, int *exp)
+{
+  int e2;
+  uint64_t m2;
+  if (ieee_exponent == 0)
+    {
+      e2 = 1 - DOUBLE_BIAS - DOUBLE_MANTISSA_BITS - 2;
+      m2 = ieee_mantissa;
+    }
+  else
+    {
+      e2 = (int)ieee_exponent - DOUBLE_BIAS - DOUBLE_MANTISSA_BITS - 2;
+      m2 = (UINT64_C(1) << DOUBLE_MANTISSA_BITS) | ieee_mantissa;
+    }
+  bool accept_bounds = (m2 & 1) == 0;
+
+  /* the interval is [mv - mm_shift - 1, mv + 2] / 4 * 2^e2 */
+  uint64_t mv = 4 * m2;
+  int mm_shift = ieee_mantissa != 0 || ieee_exponent <= 1;
+
+  uint64_t vr, vp, vm;
+  int e10;
+  bool vm_trailing_zeros = false, vr_trailing_zeros = false;
+  if (e2 >= 0)
+    {
+      int q = log10_pow2(e2) - (e2 > 3);
+      e10 = q;
+      int k = POW5_INV_BITCOUNT + pow5bits(q) - 1;
+      int i = -e2 + q + k;
+      vr = mul_shift64(mv, POW5_INV_SPLIT[q], i);
+      vp = mul_shift64(mv + 2, POW5_INV_SPLIT[q], i);
+      vm = mul_shift64(mv - 1 - mm_shift, POW5_INV_SPLIT[q], i);
+      if (q <= 21)
+        {
+          /* only one of mp, mv, and mm can be a multiple of 5 */
+          if (mv % 5 == 0)
+            vr_trailing_zeros = multiple_of_pow5(mv, q);
+          else if (accept_bounds)
+            vm_trailing_zeros = multiple_of_pow5(mv - 1 - mm_shift, q);
+          else
+            vp -= multiple_of_pow5(mv + 2, q);
+        }
+    }
+  else
+    {
+      int q = log10_pow5(-e2) - (-e2 > 1);
+      e10 = q + e2;
+      int i = -e2 - q;
+      int k = pow5bits(i) - POW5_BITCOUNT;
+      int j = q - k;
+      vr = mul_shift64(mv, POW5_SPLIT[i], j);
+      vp = mul_shift64(mv + 2, POW5_SPLIT[i], j);
+      vm = mul_shift64(mv - 1 - mm_shift, POW5_SPLIT[i], j);
+      if (q <= 1)
+        {
+          /* mv has at least q trailing zero bits since it is 4 * m2 */
+          vr_trailing_zeros = true;
+          if (accept_bounds)
+            vm_trailing_zeros = mm_shift == 1;
+          else
+            --vp;
+        }
+      else if (q < 63)
+        vr_trailing_zeros = multiple_of_pow2(mv, q);
+    }
+
+  int removed = 0;
+  unsigned last_removed = 0;
+  if (vm_trailing_zeros || vr_trailing_zeros)
+    {
+      /* rare case; keep track of whether everything removed was zero */
+      for (; vp / 10 > vm / 10; ++removed)
+        {
+          vm_trailing_zeros &= vm % 10 == 0;
+          vr_trailing_zeros &= last_removed == 0;
+          last_removed = vr % 10;
+          vr /= 10;
+          vp /= 10;
+          vm /= 10;
+        }
+      if (vm_trailing_zeros)
+        for (; vm % 10 == 0; ++removed)
+          {
+            vr_trailing_zeros &= last_removed == 0;
+            last_removed = vr % 10;
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+          }
+      /* round half to even */
+      if (vr_trailing_zeros && last_removed == 5 && vr % 2 == 0)
+        last_removed = 4;
+      *output = vr + ((vr == vm && (!accept_bounds || !vm_trailing_zeros))
+                      || last_removed >= 5);
+    }
+  else
+    {
+      bool round_up = false;
+      for (; vp / 10 > vm / 10; ++removed)
+        {
+          round_up = vr % 10 >= 5;
+          vr /= 10;
+          vp /= 10;
+          vm /= 10;
+        }
+      *output = vr + (vr == vm || round_up);
+    }
+  *exp = e10 + removed;
+}
+
+int dtoa_shortest(char buf[static DTOA_BUFSIZE], double d)
+{
+  assert(isfinite(d));
+
+  uint64_t bits;
+  memcpy(&bits, &d, sizeof bits);
+  bool sign = bits >> (DOUBLE_MANTISSA_BITS + DOUBLE_EXPONENT_BITS);
+  uint64_t ieee_mantissa = bits & ((UINT64_C(1) << DOUBLE_MANTISSA_BITS) - 1);
+  uint32_t ieee_exponent = ((bits >> DOUBLE_MANTISSA_BITS)
+                            & ((1u << DOUBLE_EXPONENT_BITS) - 1));
+
+  char *s = buf;
+  if (sign)
+    *s++ = '-';
+
+  if (ieee_exponent == 0 && ieee_mantissa == 0)
+    {
+      *s++ = '0';
+      *s = 0;
+      return s - buf;
+    }
+
+  uint64_t output;
+  int exp;
+  d2d(ieee_mantissa, ieee_exponent, &output, &exp);
+
+  char digits[DTOA_PRECISION + 1];
+  int ndigits = 0;
+  for (uint64_t o = output; o > 0; o /= 10)
+    digits[ndigits++] = '0' + o % 10;
+  assert(ndigits <= DTOA_PRECISION);
+
+  /* decimal exponent of the most significant digit */
+  int x = exp + ndigits - 1;
+  if (x < -4 || x >= DTOA_PRECISION)
+    {
+      *s++ = digits[--ndigits];
+      if (ndigits > 0)
+        {
+          *s++ = '.';
+          while (ndigits > 0)
+            *s++ = digits[--ndigits];
+        }
+      *s++ = 'e';
+      *s++ = x < 0 ? '-' : '+';
+      unsigned ax = x < 0 ? -x : x;
+      if (ax >= 100)
+        *s++ = '0' + ax / 100;
+      *s++ = '0' + ax / 10 % 10;
+      *s++ = '0' + ax % 10;
+    }
+  else if (x < 0)
+    {
+      *s++ = '0';
+      *s++ = '.';
+      for (int i = -1; i > x; --i)
+        *s++ = '0';
+      while (ndigits > 0)
+        *s++ = digits[--ndigits];
+    }
+  else
+    {
+      for (int i = x; i >= 0; --i)
+        {
+          *s++ = ndigits > 0 ? digits[--ndigits] : '0';
+          if (i == 0 && ndigits > 0)
+            *s++ = '.';
+        }
+      while (ndigits > 0)
+        *s++ = digits[--ndigits];
+    }
+  *s = 0;
+  assert(s - buf < DTOA_BUFSIZE);
+  return s - buf;
+}
@@ -12,4 +12,7 @@ unsigned int string_nhash(const char *s, size_t len);
 unsigned int string_hash(const char *s);
 unsigned int string_7hash(const char *s);
 
+#define SHA256_SIZE 32
+void sha256(const void *data, size_t len, unsigned char digest[SHA256_SIZE]);
+
 #endif  /* HASH_H */
@@ -475,6 +475,35 @@ static struct string *build_lineno_data(struct ilist *ins)
   return lni;
 }
 
+void set_icode_dispatch(struct icode *code)
+/* Effects: Sets up the machine code in 'code' that jumps to the
+     interpreter
+*/
+{
+#ifndef NOCOMPILER
+#ifdef __i386__
+  static const struct magic_dispatch magic_dispatch = {
+    .movl_ecx = 0xb9,
+    .invoke   = interpreter_invoke,
+    .jmp_ecx  = { 0xff, 0xe1 },
+    .nop1     = NOP1,
+  };
+  CASSERT_SIZEOF(magic_dispatch, 1 + 4 + 2 + 1);
+#elif defined __x86_64__
+  static const struct magic_dispatch magic_dispatch = {
+    .movq_r11 = { 0x49, 0xbb },
+    .invoke   = interpreter_invoke,
+    .jmpq_r11 = { 0x41, 0xff, 0xe3 },
+    .nop3     = NOP3,
+  };
+  CASSERT_SIZEOF(magic_dispatch, 2 + 8 + 3 + 3);
+#else
+  #error Unsupported architecture
+#endif
+  code->magic_dispatch = magic_dispatch;
+#endif
+}
+
 struct icode *generate_fncode(struct fncode *fn,
                               struct string *help,
                               struct string *varname,
@@ -576,30 +605,7 @@ struct icode *generate_fncode(struct fncode *fn,
     assert(csts == NULL);
   }
 
-  /* Jump to interpreter to execute interpreted code - machine specific */
-
-#ifndef NOCOMPILER
-#ifdef __i386__
-  static const struct magic_dispatch magic_dispatch = {
-    .movl_ecx = 0xb9,
-    .invoke   = interpreter_invoke,
-    .jmp_ecx  = { 0xff, 0xe1 },
-    .nop1     = NOP1,
-  };
-  CASSERT_SIZEOF(magic_dispatch, 1 + 4 + 2 + 1);
-#elif defined __x86_64__
-  static const struct magic_dispatch magic_dispatch = {
-    .movq_r11 = { 0x49, 0xbb },
-    .invoke   = interpreter_invoke,
-    .jmpq_r11 = { 0x41, 0xff, 0xe3 },
-    .nop3     = NOP3,
-  };
-  CASSERT_SIZEOF(magic_dispatch, 2 + 8 + 3 + 3);
-#else
-  #error Unsupported architecture
-#endif
-  gencode->magic_dispatch = magic_dispatch;
-#endif
+  set_icode_dispatch(gencode);
 
 #ifdef GCSTATS
   gcstats_add_alloc(type_code, MUDLLE_ALIGN(size, sizeof (long)));
@@ -124,6 +124,11 @@ struct icode *generate_fncode(struct fncode *fn,
      in reverse temporal order)
 */
 
+void set_icode_dispatch(struct icode *code);
+/* Effects: Sets up the machine code in 'code' that jumps to the
+     interpreter
+*/
+
 struct label *new_label(struct fncode *fn);
 /* Returns: A new label which points to nothing. Use label() to make it
      point at a particular instruction.
@@ -0,0 +1,59 @@
+#!/usr/bin/perl -w
+
+# Generate the tables of 125-bit approximations of powers of five used
+# by the shortest round-trip double formatter in dtoa.c.
+
+use strict;
+use Math::BigInt;
+
+use constant POW5_INV_SIZE => 342;
+use constant POW5_SIZE     => 326;
+use constant BITCOUNT      => 125;
+
+my $mask64 = Math::BigInt->new(1)->blsft(64)->bsub(1);
+
+sub pow5bits {
+    my ($e) = @_;
+    return (($e * 1217359) >> 19) + 1;
+}
+
+sub entry {
+    my ($v) = @_;
+    my $lo = $v->copy->band($mask64);
+    my $hi = $v->copy->brsft(64);
+    return sprintf("  { UINT64_C(%s), UINT64_C(%s) }",
+                   $lo->bstr, $hi->bstr);
+}
+
+print "/* automatically generated by $0 */
+
+/* POW5_INV_SPLIT[q] = floor(2^(pow5bits(q) - 1 + ", BITCOUNT,
+    ") / 5^q) + 1, as { low, high } */
+static const uint64_t POW5_INV_SPLIT[", POW5_INV_SIZE, "][2] = {
+";
+my @rows;
+for my $q (0 .. POW5_INV_SIZE - 1) {
+    my $p5 = Math::BigInt->new(5)->bpow($q);
+    my $v = Math::BigInt->new(1)->blsft(pow5bits($q) - 1 + BITCOUNT);
+    $v->bdiv($p5);
+    $v->binc;
+    push @rows, entry($v);
+}
+print join(",\n", @rows), "\n};
+
+/* POW5_SPLIT[i] = 5^i normalized to ", BITCOUNT,
+    " bits, as { low, high } */
+static const uint64_t POW5_SPLIT[", POW5_SIZE, "][2] = {
+";
+@rows = ();
+for my $i (0 .. POW5_SIZE - 1) {
+    my $p5 = Math::BigInt->new(5)->bpow($i);
+    my $len = length($p5->as_bin) - 2;
+    if ($len > BITCOUNT) {
+        $p5->brsft($len - BITCOUNT);
+    } else {
+        $p5->blsft(BITCOUNT - $len);
+    }
+    push @rows, entry($p5);
+}
+print join(",\n", @rows), "\n};\n";
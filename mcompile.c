@@ -122,6 +122,22 @@ static enum module_status imported(const char *name, int do_mark)
 
 static struct mfile *current_mfile;
 
+/* Globals of protected modules whose values were used to generate code */
+static struct glist *dependencies;
+static struct alloc_block *dependency_heap;
+
+static void add_dependency(ulong n, const struct loc *loc)
+{
+  if (!in_glist(n, dependencies, false))
+    dependencies = new_glist(dependency_heap, n, loc, dependencies);
+}
+
+void mforeach_dependency(void (*fn)(ulong n, void *data), void *data)
+{
+  for (struct glist *l = dependencies; l; l = l->next)
+    fn(l->n, data);
+}
+
 bool mstart(struct alloc_block *heap, struct mfile *f, seclev_t seclev)
 /* Effects: Start processing module f:
      - unload f
@@ -168,6 +184,8 @@ bool mstart(struct alloc_block *heap, struct mfile *f, seclev_t seclev)
     }
 
   current_mfile = f;
+  dependencies = NULL;
+  dependency_heap = heap;
 
   all_writable = f->vclass == f_plain;
   all_readable = f->vclass == f_plain;
@@ -304,6 +322,7 @@ void mrecall(const struct loc *loc, ulong n, const char *name,
       if (module_status(mod->str) == module_protected)
         {
           imported(mod->str, 1);
+          add_dependency(n, loc);
           if (immutablep(GVAR(n))) /* Use value */
             {
               ins_constant(GVAR(n), fn);
@@ -347,6 +366,7 @@ void mexecute(const struct loc *loc, ulong n, const char *name, int count,
           value gvar = GVAR(n);
 
           imported(mod->str, 1);
+          add_dependency(n, loc);
 
           if (TYPE(gvar, primitive))
             {
@@ -454,6 +474,57 @@ void massign(const struct loc *loc, ulong n, const char *name,
     ins2(op_assign_global, n, fn);
 }
 
+bool mcheck_global(const struct loc *loc, ulong n, enum mglobal_use use)
+{
+  assert(current_mfile != NULL);
+
+  const char *name = GNAME(n)->str;
+  struct string *mod;
+  enum vstatus status = module_vstatus(n, &mod);
+
+  switch (use)
+    {
+    case mglobal_define:
+      if (status == var_module && mod == this_module
+          && in_glist(n, definable, true))
+        return true;
+      compile_error(loc, "cannot define %s", name);
+      return false;
+    case mglobal_write:
+      if (status == var_module)
+        {
+          compile_error(loc, "write of global %s (module %s)", name,
+                        mod->str);
+          return false;
+        }
+      return mwritable(loc, n, name);
+    case mglobal_read:
+      if (in_glist(n, definable, false)
+          || in_glist(n, readable, true)
+          || in_glist(n, writable, false)
+          || status == var_system_write
+          || status == var_system_mutable)
+        return true;
+      if (status == var_module)
+        {
+          if (module_status(mod->str) == module_protected)
+            {
+              imported(mod->str, 1);
+              return true;
+            }
+          if (all_readable || imported(mod->str, 1) != module_unloaded)
+            return true;
+          compile_error(loc, "read of global %s (module %s)", name, mod->str);
+          return false;
+        }
+      if (all_readable)
+        return true;
+      compile_error(loc, "read of global %s", name);
+      return false;
+    }
+  abort();
+}
+
 void mwarn_module(seclev_t seclev, struct block *b)
 {
   assert(current_mfile != NULL);
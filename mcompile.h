@@ -71,10 +71,30 @@ void massign(const struct loc *loc, unsigned long n, const char *name,
 /* Effects: Generate code to assign to variable n
 */
 
+enum mglobal_use {
+  mglobal_read,                 /* recall or call */
+  mglobal_write,
+  mglobal_define
+};
+
+bool mcheck_global(const struct loc *loc, unsigned long n,
+                   enum mglobal_use use);
+/* Effects: Checks that variable n may be used as 'use' by the current
+     module, as mrecall(), mexecute() and massign() do when generating
+     code. Logs an error message otherwise.
+   Returns: true if allowed
+*/
+
 void mwarn_module(seclev_t seclev, struct block *b);
 /* Effects: Warns about unused variables in module name
  */
 
+void mforeach_dependency(void (*fn)(unsigned long n, void *data), void *data);
+/* Effects: Calls fn(n, data) for each global variable n of a protected
+     module whose value was used when generating code for the last module
+     passed to mstart()
+*/
+
 void mcompile_init(void);
 
 #endif
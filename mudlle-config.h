@@ -47,6 +47,10 @@
 #  define HAVE_CRYPT 1
 #endif
 
+#ifdef __linux__
+#  define HAVE_EPOLL 1
+#endif
+
 #ifndef PATH_MAX
 #  define PATH_MAX 1024
 #endif
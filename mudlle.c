@@ -20,6 +20,7 @@
  */
 
 #include "alloc.h"
+#include "charset.h"
 #include "compile.h"
 #include "context.h"
 #include "error.h"
@@ -40,6 +41,7 @@ void mudlle_init(void)
 {
   assert(table_good_size(MAX_TABLE_ENTRIES) <= MAX_VECTOR_SIZE);
   assert(table_good_size(MAX_TABLE_ENTRIES + 1) > MAX_VECTOR_SIZE);
+  charset_init();
   random_init();
   garbage_init();
   global_init();
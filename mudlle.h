@@ -27,6 +27,7 @@ enum mudlle_data_version {
   MDATA_VER_LEGACY,
   MDATA_VER_NEW_HASH,       /* new hash algorithm for symbol tables */
   MDATA_VER_RO_SYM_NAMES,   /* symbols forced to have readonly names */
+  MDATA_VER_TABLE_FIELDS,   /* tables have resize and prefix index fields */
 
   MDATA_VERSIONS,
   MDATA_VER_CURRENT = MDATA_VERSIONS - 1
@@ -30,6 +30,7 @@
 
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
 #include "alloc.h"
 #include "charset.h"
@@ -46,6 +47,7 @@
 #undef LOCAL_MUDLLE_TYPES
 #define LOCAL_MUDLLE_TYPES                      \
   struct capped_oport *:       true,            \
+  struct fd_oport *:           true,            \
   struct file_oport *:         true,            \
   struct line_oport *:         true,            \
   struct mudout_oport *:       true,            \
@@ -60,7 +62,11 @@ static int string_oport_cache_used;
 
 struct oport *mudout_port;
 
-#define STRING_BLOCK_SIZE 512	/* Size of each block */
+#define STRING_BLOCK_SIZE 512	/* Size of the first block */
+#define STRING_BLOCK_MAX_SIZE 65536
+/* Each block is twice the size of the previous one, up to
+   STRING_BLOCK_MAX_SIZE, so large outputs need few blocks. Only blocks of
+   STRING_BLOCK_SIZE are recycled through free_blocks. */
 
 struct string_oport_block /* A structure in which to accumulate output */
 {
@@ -76,6 +82,7 @@ struct string_oport /* Output to a string */
   struct oport p;
   struct string_oport_block *first, *current;
   value pos;
+  value size;                   /* characters in blocks before current */
 };
 
 struct file_oport /* Output to a FILE * */
@@ -112,16 +119,39 @@ static struct string_oport *get_string_port(struct oport *p)
 
 static ulong port_length(struct string_oport *p)
 {
-  struct string_oport_block *block = p->first;
-  ulong size = intval(p->pos);
-  while ((block = block->next))
-    size += STRING_BLOCK_SIZE;
-  return size;
+  return intval(p->size) + intval(p->pos);
+}
+
+static size_t block_capacity(struct string_oport_block *block)
+{
+  return block->data->o.size - sizeof (struct obj);
+}
+
+static size_t next_block_size(struct string_oport_block *block)
+{
+  size_t size = 2 * block_capacity(block);
+  return size < STRING_BLOCK_MAX_SIZE ? size : STRING_BLOCK_MAX_SIZE;
+}
+
+static void free_string_blocks(struct string_oport_block *block)
+{
+  while (block)
+    {
+      struct string_oport_block *next = block->next;
+      GCCHECK(block);
+      assert(!readonlyp(block));
+      if (block_capacity(block) == STRING_BLOCK_SIZE)
+        {
+          block->next = free_blocks;
+          free_blocks = block;
+        }
+      block = next;
+    }
 }
 
-static struct string_oport_block *new_string_block(void)
+static struct string_oport_block *new_string_block(size_t size)
 {
-  if (free_blocks)
+  if (size == STRING_BLOCK_SIZE && free_blocks)
     {
       struct string_oport_block *newp = free_blocks;
       assert(!readonlyp(newp));
@@ -135,44 +165,39 @@ static struct string_oport_block *new_string_block(void)
   newp = (struct string_oport_block *)allocate_record(
     type_internal, grecord_fields(*newp));
   GCPRO(newp);
-  struct string *s = (struct string *)allocate_string(
-    type_internal, STRING_BLOCK_SIZE);
+  struct string *s = (struct string *)allocate_string(type_internal, size);
   UNGCPRO();
   newp->data = s;
   return newp;
 }
 
-void empty_string_oport(struct oport *_p)
+static void empty_string_port(struct string_oport *p)
 {
-  struct string_oport *p = get_string_port(_p);
-
   assert(p->first);
   assert(p->current);
 
   if (p->first != p->current)
     {
-      p->current->next = free_blocks;
-      free_blocks = p->first->next;
+      free_string_blocks(p->first->next);
       p->first->next = NULL;
       p->current = p->first;
     }
 
   p->pos = makeint(0);
+  p->size = makeint(0);
+}
+
+void empty_string_oport(struct oport *p)
+{
+  empty_string_port(get_string_port(p));
 }
 
 static void free_string_oport(struct string_oport *p)
 {
   set_oport_methods(&p->p, NULL);
 
-  for (struct string_oport_block *b = p->first; b; b = b->next)
-    {
-      GCCHECK(b);
-      assert(!readonlyp(b));
-    }
-
   /* Free data (add blocks to free block list) */
-  p->current->next = free_blocks;
-  free_blocks = p->first;
+  free_string_blocks(p->first);
   p->first = p->current = NULL;
 }
 
@@ -202,7 +227,7 @@ static void string_putnc(struct oport *_p, int c, size_t n)
 
   while (n > 0)
     {
-      size_t left = STRING_BLOCK_SIZE - pos;
+      size_t left = block_capacity(current) - pos;
       size_t cnt = n < left ? n : left;
       memset(current->data->str + pos, c, cnt);
       n -= cnt;
@@ -212,8 +237,9 @@ static void string_putnc(struct oport *_p, int c, size_t n)
 
       struct string_oport_block *blk;
       GCPRO(p, current);
-      blk = new_string_block();
+      blk = new_string_block(next_block_size(current));
       UNGCPRO();
+      p->size = makeint(intval(p->size) + pos);
       p->current = current->next = blk;
       current = p->current;
       pos = 0;
@@ -229,11 +255,13 @@ static void string_write(struct oport *_p, const char *data, size_t nchars)
   long pos = intval(p->pos);
   GCPRO(p, current);
   size_t fit;
-  while ((fit = STRING_BLOCK_SIZE - pos) < nchars)
+  while ((fit = block_capacity(current) - pos) < nchars)
     {
-      struct string_oport_block *blk = new_string_block();
+      struct string_oport_block *blk = new_string_block(
+        next_block_size(current));
 
       memcpy(current->data->str + pos, data, fit);
+      p->size = makeint(intval(p->size) + pos + fit);
       p->current = current->next = blk;
       current = p->current;
       data += fit;
@@ -251,15 +279,17 @@ static void string_swrite(struct oport *_p, struct string *s, size_t from,
   struct string_oport *p = (struct string_oport *)_p;
   assert(!readonlyp(p));
   struct string_oport_block *current = p->current;
-  int fit;
+  size_t fit;
   long pos = intval(p->pos);
 
   GCPRO(p, current, s);
-  while ((fit = STRING_BLOCK_SIZE - pos) < nchars)
+  while ((fit = block_capacity(current) - pos) < nchars)
     {
-      struct string_oport_block *blk = new_string_block();
+      struct string_oport_block *blk = new_string_block(
+        next_block_size(current));
 
       memcpy(current->data->str + pos, s->str + from, fit);
+      p->size = makeint(intval(p->size) + pos + fit);
       p->current = current->next = blk;
       current = p->current;
       from += fit;
@@ -304,9 +334,10 @@ static struct string_oport *init_string_oport(struct string_oport *p)
   assert(!readonlyp(p));
   GCPRO(p);
   set_oport_methods(&p->p, &string_port_methods);
-  struct string_oport_block *blk = new_string_block();
+  struct string_oport_block *blk = new_string_block(STRING_BLOCK_SIZE);
   p->first = p->current = blk;
   p->pos = makeint(0);
+  p->size = makeint(0);
   UNGCPRO();
   return p;
 }
@@ -616,7 +647,7 @@ static void port_copy(char *s, struct string_oport *p, size_t maxlen)
        current = current->next)
     {
       bool last = current->next == NULL;
-      size_t n = last ? intval(p->pos) : STRING_BLOCK_SIZE;
+      size_t n = last ? intval(p->pos) : block_capacity(current);
       if (n > maxlen)
         n = maxlen;
       memcpy(s, current->data->str, n);
@@ -688,7 +719,7 @@ bool port_for_blocks(struct oport *_p,
   GCPRO(current);
   while (current->next)
     {
-      if (!f(data, current->data, STRING_BLOCK_SIZE))
+      if (!f(data, current->data, block_capacity(current)))
         {
           result = false;
           goto done;
@@ -701,6 +732,54 @@ bool port_for_blocks(struct oport *_p,
   return result;
 }
 
+/* Writes the characters of p from index skip onwards to fd, using a
+   single writev() call. Returns the result of writev(). */
+static ssize_t blocks_writev(struct string_oport *p, int fd, size_t skip)
+{
+  struct string_oport_block *block = p->first;
+  for (;;)
+    {
+      size_t len = block->next ? block_capacity(block) : intval(p->pos);
+      if (skip < len || block->next == NULL)
+        break;
+      skip -= len;
+      block = block->next;
+    }
+
+  struct iovec iov[64];
+  int n = 0;
+  for (; block && n < VLENGTH(iov); block = block->next)
+    {
+      size_t len = block->next ? block_capacity(block) : intval(p->pos);
+      iov[n++] = (struct iovec){
+        .iov_base = block->data->str + skip,
+        .iov_len  = len - skip
+      };
+      skip = 0;
+    }
+  return writev(fd, iov, n);
+}
+
+bool port_writev(struct oport *_p, int fd)
+{
+  struct string_oport *p = get_string_port(_p);
+  size_t len = port_length(p);
+
+  /* nothing here can cause GC */
+  for (size_t done = 0; done < len; )
+    {
+      ssize_t w = blocks_writev(p, fd, done);
+      if (w < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          return false;
+        }
+      done += w;
+    }
+  return true;
+}
+
 void port_append(struct oport *p1, struct oport *_p2)
 /* Effects: The characters of port p2 are appended to the end of port p1.
    Modifies: p1
@@ -713,7 +792,7 @@ void port_append(struct oport *p1, struct oport *_p2)
   GCPRO(p1, current);
   while (current->next)
     {
-      pswrite_substring(p1, current->data, 0, STRING_BLOCK_SIZE);
+      pswrite_substring(p1, current->data, 0, block_capacity(current));
       current = current->next;
     }
   pswrite_substring(p1, current->data, 0, pos);
@@ -725,10 +804,54 @@ void port_append(struct oport *p1, struct oport *_p2)
 
 static const char basechars[16] = "0123456789abcdef";
 
+/* the decimal digits of 0 to 99, two at a time */
+static const char digit_pairs[200] =
+  "0001020304050607080910111213141516171819"
+  "2021222324252627282930313233343536373839"
+  "4041424344454647484950515253545556575859"
+  "6061626364656667686970717273747576777879"
+  "8081828384858687888990919293949596979899";
+
+/* Prints u in decimal, two digits at a time, before pos. Returns: the
+   start of the result */
+static char *put_decimal(char *pos, unsigned long long u)
+{
+  while (u >= 100)
+    {
+      unsigned i = (u % 100) * 2;
+      u /= 100;
+      pos -= 2;
+      memcpy(pos, digit_pairs + i, 2);
+    }
+  if (u >= 10)
+    {
+      pos -= 2;
+      memcpy(pos, digit_pairs + u * 2, 2);
+    }
+  else
+    *--pos = '0' + u;
+  return pos;
+}
+
 char *ulongtostr(struct intstr *str, unsigned base, unsigned long u)
 {
   char *pos = str->s + sizeof str->s;
   *--pos = '\0';
+  if (base == 10)
+    return put_decimal(pos, u);
+
+  if ((base & (base - 1)) == 0)
+    {
+      int bits = __builtin_ctz(base);
+      do
+        {
+          *--pos = basechars[u & (base - 1)];
+          u >>= bits;
+        }
+      while (u > 0);
+      return pos;
+    }
+
   do
     {
       *--pos = basechars[u % base];
@@ -756,24 +879,43 @@ static char *internal_inttostr(struct intstr *str, unsigned base,
   char *pos = str->s + sizeof str->s;
   *--pos = '\0';
 
-  int i = wide ? 3 : -1;
   bool minus = is_signed && (long long)n < 0;
   if (minus)
     n = -((long long)n + 1) + 1ULL; /* handle LLONG_MIN */
 
-  do
+  if (base == 10 && !wide)
+    pos = put_decimal(pos, n);
+  else if (base == 10)
     {
-      if (i == 0)
+      /* groups of three digits separated by commas */
+      while (n >= 1000)
         {
+          unsigned group = n % 1000;
+          n /= 1000;
+          pos -= 2;
+          memcpy(pos, digit_pairs + (group % 100) * 2, 2);
+          *--pos = '0' + group / 100;
           *--pos = ',';
-          i = 2;
         }
-      else
-        --i;
-      *--pos = basechars[n % base];
-      n /= base;
+      pos = put_decimal(pos, n);
+    }
+  else
+    {
+      int i = wide ? 3 : -1;
+      do
+        {
+          if (i == 0)
+            {
+              *--pos = ',';
+              i = 2;
+            }
+          else
+            --i;
+          *--pos = basechars[n % base];
+          n /= base;
+        }
+      while (n > 0);
     }
-  while (n > 0);
   if (minus)
     *--pos = '-';
 
@@ -1266,6 +1408,187 @@ struct oport *make_capped_oport(struct oport *p, size_t n)
   return &cport->p;
 }
 
+struct fd_oport {
+  struct string_oport soport;   /* output not yet sent */
+  value fd;
+  value sent;                   /* characters of soport already sent */
+  value limit;                  /* maximum number of queued characters */
+  value overflow;               /* true if output has been discarded */
+  value watcher;                /* event loop watching the port, or null */
+};
+
+static long fd_port_queued_chars(struct fd_oport *p)
+{
+  return port_length(&p->soport) - intval(p->sent);
+}
+
+/* Returns: true if n more characters fit in the queue of p; otherwise
+   marks p as overflowed */
+static bool fd_port_room(struct fd_oport *p, size_t n)
+{
+  if (intval(p->fd) < 0)
+    return false;
+  if (fd_port_queued_chars(p) + n <= intval(p->limit))
+    return true;
+  p->overflow = makebool(true);
+  return false;
+}
+
+static void fd_port_putnc(struct oport *_p, int c, size_t n)
+{
+  struct fd_oport *p = (struct fd_oport *)_p;
+  if (fd_port_room(p, n))
+    string_putnc(_p, c, n);
+}
+
+static void fd_port_write(struct oport *_p, const char *data, size_t nchars)
+{
+  struct fd_oport *p = (struct fd_oport *)_p;
+  if (fd_port_room(p, nchars))
+    string_write(_p, data, nchars);
+}
+
+static void fd_port_swrite(struct oport *_p, struct string *s, size_t from,
+                           size_t nchars)
+{
+  struct fd_oport *p = (struct fd_oport *)_p;
+  if (fd_port_room(p, nchars))
+    string_swrite(_p, s, from, nchars);
+}
+
+static void fd_port_flush(struct oport *p)
+{
+  fd_port_send(p);
+}
+
+static void fd_port_close(struct oport *_p)
+{
+  struct fd_oport *p = (struct fd_oport *)_p;
+  close(intval(p->fd));
+  p->fd = makeint(-1);
+  free_string_oport(&p->soport);
+}
+
+static void fd_port_stat(struct oport *_p, struct oport_stat *buf)
+{
+  struct fd_oport *p = (struct fd_oport *)_p;
+  *buf = (struct oport_stat){ .size = fd_port_queued_chars(p) };
+}
+
+static const struct oport_methods fd_port_methods = {
+  .name   = "fd",
+  .close  = fd_port_close,
+  .putnc  = fd_port_putnc,
+  .write  = fd_port_write,
+  .swrite = fd_port_swrite,
+  .flush  = fd_port_flush,
+  .stat   = fd_port_stat,
+};
+
+bool is_fd_port(struct oport *p)
+{
+  return TYPE(p, oport) && oport_methods(p) == &fd_port_methods;
+}
+
+struct oport *make_fd_oport(int fd, size_t limit)
+{
+  struct fd_oport *p = ALLOC_OPORT(fd);
+  p = (struct fd_oport *)init_string_oport(&p->soport);
+  set_oport_methods(&p->soport.p, &fd_port_methods);
+  p->fd = makeint(fd);
+  p->sent = makeint(0);
+  p->limit = makeint(limit > MAX_TAGGED_INT ? MAX_TAGGED_INT : limit);
+  p->overflow = makebool(false);
+  p->watcher = NULL;
+  return &p->soport.p;
+}
+
+/* Frees the blocks before the current one in p whose characters have all
+   been sent, so partially sent output does not accumulate. Returns the
+   number of sent characters left in p. */
+static size_t drop_sent_blocks(struct string_oport *p, size_t sent)
+{
+  struct string_oport_block *block;
+  while ((block = p->first) != p->current
+         && sent >= block_capacity(block))
+    {
+      size_t cap = block_capacity(block);
+      p->first = block->next;
+      block->next = NULL;
+      free_string_blocks(block);
+      p->size = makeint(intval(p->size) - cap);
+      sent -= cap;
+    }
+  return sent;
+}
+
+long fd_port_send(struct oport *_p)
+{
+  struct fd_oport *p = (struct fd_oport *)_p;
+  assert(is_fd_port(_p));
+  if (intval(p->fd) < 0)
+    {
+      errno = EBADF;
+      return -1;
+    }
+
+  size_t len = port_length(&p->soport), sent = intval(p->sent);
+  while (sent < len)
+    {
+      ssize_t w = blocks_writev(&p->soport, intval(p->fd), sent);
+      if (w < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          if (errno == EAGAIN || errno == EWOULDBLOCK)
+            break;
+          p->sent = makeint(drop_sent_blocks(&p->soport, sent));
+          return -1;
+        }
+      sent += w;
+    }
+
+  if (sent == len)
+    {
+      empty_string_port(&p->soport);
+      sent = 0;
+    }
+  else
+    sent = drop_sent_blocks(&p->soport, sent);
+  p->sent = makeint(sent);
+  return fd_port_queued_chars(p);
+}
+
+size_t fd_port_queued(struct oport *p)
+{
+  assert(is_fd_port(p));
+  return fd_port_queued_chars((struct fd_oport *)p);
+}
+
+bool fd_port_overflow(struct oport *p)
+{
+  assert(is_fd_port(p));
+  return istrue(((struct fd_oport *)p)->overflow);
+}
+
+int fd_port_fd(struct oport *p)
+{
+  assert(is_fd_port(p));
+  return intval(((struct fd_oport *)p)->fd);
+}
+
+value fd_port_watcher(struct oport *p)
+{
+  assert(is_fd_port(p));
+  return ((struct fd_oport *)p)->watcher;
+}
+
+void fd_port_set_watcher(struct oport *p, value watcher)
+{
+  assert(is_fd_port(p));
+  ((struct fd_oport *)p)->watcher = watcher;
+}
+
 void ports_init(void)
 {
   staticpro(&free_blocks);
@@ -82,6 +82,22 @@ struct oport *make_line_oport(const struct line_oport_methods *methods,
 
 struct oport *make_sink_oport(void);
 
+/* Output to a non-blocking file descriptor, queueing up to 'limit'
+   characters; output that does not fit is discarded and the port marked
+   as overflowed. Closing the port closes 'fd'. */
+struct oport *make_fd_oport(int fd, size_t limit);
+bool is_fd_port(struct oport *p);
+/* Sends as much queued output as 'fd' accepts without blocking.
+   Returns: the number of characters still queued, or -1 on error (with
+   errno set) */
+long fd_port_send(struct oport *p);
+size_t fd_port_queued(struct oport *p);
+bool fd_port_overflow(struct oport *p);
+int fd_port_fd(struct oport *p);
+/* The event loop watching p, if any (cf. runtime/files.c) */
+value fd_port_watcher(struct oport *p);
+void fd_port_set_watcher(struct oport *p, value watcher);
+
 struct string *port_string(struct oport *p, size_t maxlen);
 /* Returns: A mudlle string representing all the data send to port p.
    Requires: p be a string-type output port
@@ -114,6 +130,11 @@ bool port_for_blocks(struct oport *p,
                      bool (*f)(void *data, struct string *str, size_t len),
                      void *data);
 
+/* Writes the contents of string port p to file descriptor fd, using as
+   few writev() calls as possible. Returns true if successful; otherwise
+   sets errno. */
+bool port_writev(struct oport *p, int fd);
+
 /* C-like I/O routines for ports */
 static inline const struct oport_methods *oport_methods(struct oport *p)
 {
@@ -23,6 +23,7 @@
 
 #include <ctype.h>
 #include <float.h>
+#include <limits.h>
 #include <math.h>
 #include <stddef.h>
 #include <stdlib.h>
@@ -32,6 +33,7 @@
 #include "charset.h"
 #include "code.h"
 #include "context.h"
+#include "dtoa.h"
 #include "dwarf.h"
 #include "global.h"
 #include "ins.h"
@@ -659,15 +661,32 @@ static bool write_float(struct print_config *config, value v)
 
   assert(isfinite(d));
 
-#ifndef DBL_DECIMAL_DIG
-  /* clang 3.8 doesn't define this C11 macro */
-#define DBL_DECIMAL_DIG __DBL_DECIMAL_DIG__
-#endif
+  bool exact = config->level == prt_constant;
+
+  /* integral values print like integers as long as "%g" would not use
+     an exponent and they fit in a long */
+  if (d == trunc(d) && fabs(d) < (exact ? 1e15 : 1e6)
+      && fabs(d) < -(double)LONG_MIN)
+    {
+      struct intstr ibuf;
+      if (d == 0 && signbit(d))
+        pputc('-', config->f);
+      pputs(longtostr(&ibuf, 10, (long)d), config->f);
+      pputs(".0", config->f);
+      return true;
+    }
 
-  char buf[DBL_DECIMAL_DIG + 16];
-  int prec = config->level == prt_constant ? DBL_DECIMAL_DIG : 6;
-  int len = snprintf(buf, sizeof buf, "%.*g", prec, d);
-  assert(len < sizeof buf);
+  char buf[DTOA_BUFSIZE];
+  if (exact)
+    {
+      /* use the fewest digits that read back as the same value */
+      dtoa_shortest(buf, d);
+    }
+  else
+    {
+      int len = snprintf(buf, sizeof buf, "%.6g", d);
+      assert(len < sizeof buf);
+    }
   pputs(buf, config->f);
 
   /* append ".0" if the result looks like an integer */
@@ -749,6 +768,65 @@ static bool write_private(struct print_config *config, value v)
     case PRIVATE_REGEXP:
       pputs("{regexp}", config->f);
       break;
+    case PRIVATE_KMATCHER:
+      pputs("{keyword matcher}", config->f);
+      break;
+    case PRIVATE_CFORMAT:
+      pputs("{compiled format}", config->f);
+      break;
+    case PRIVATE_IPORT:
+      pputs("{input port}", config->f);
+      break;
+    case PRIVATE_EVLOOP:
+      pputs("{event loop}", config->f);
+      break;
+    case PRIVATE_WITER:
+      pputs("{word iterator}", config->f);
+      break;
+    case PRIVATE_TITER:
+      pputs("{table iterator}", config->f);
+      break;
+    case PRIVATE_HMAP:
+      pputs("{hash map}", config->f);
+      break;
+    case PRIVATE_OMAP:
+      pputs("{ordered map}", config->f);
+      break;
+    case PRIVATE_PQUEUE:
+      pputs("{priority queue}", config->f);
+      break;
+    case PRIVATE_PQENTRY:
+      pputs("{priority queue entry}", config->f);
+      break;
+    case PRIVATE_TWHEEL:
+      pputs("{timer wheel}", config->f);
+      break;
+    case PRIVATE_TIMER:
+      pputs("{timer wheel entry}", config->f);
+      break;
+    case PRIVATE_DEQUE:
+      pputs("{deque}", config->f);
+      break;
+    case PRIVATE_CSRGRAPH:
+      pputs("{csr graph}", config->f);
+      break;
+    case PRIVATE_RBITSET:
+      pputs("{compressed bitset}", config->f);
+      break;
+    case PRIVATE_SBUILDER:
+    case PRIVATE_SSLICE:
+      if (config->level == prt_display)
+        {
+          struct string *str;
+          long start, len;
+          text_parts(v, &str, &start, &len);
+          pswrite_substring(config->f, str, start, len);
+        }
+      else if (intval(val->ptype) == PRIVATE_SBUILDER)
+        pputs("{string builder}", config->f);
+      else
+        pputs("{string slice}", config->f);
+      break;
     default:
       pputs("{private}", config->f);
     }
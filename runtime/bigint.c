@@ -114,6 +114,18 @@ double bigint_to_double(struct bigint *bi)
   return mpz_get_d(bi->mpz);
 }
 
+bool bigint_to_llong(struct bigint *bi, long long *dst)
+{
+  check_bigint(bi);
+  /* conservatively rejects LLONG_MIN */
+  if (mpz_sizeinbase(bi->mpz, 2) >= CHAR_BIT * sizeof (long long))
+    return false;
+  unsigned long long u = 0;
+  mpz_export(&u, NULL, 1, sizeof u, 0, 0, bi->mpz);
+  *dst = mpz_sgn(bi->mpz) < 0 ? -(long long)u : (long long)u;
+  return true;
+}
+
 TYPEDOP(itobi, , "`n -> `bi. Return `n as a bigint", (value n),
         OP_LEAF | OP_NOESCAPE | OP_CONST, "n.b")
 {
@@ -34,6 +34,8 @@ void free_mpz_temps(void);
 #ifdef USE_GMP
 struct bigint;
 double bigint_to_double(struct bigint *bi);
+/* returns false if bi does not fit in a long long */
+bool bigint_to_llong(struct bigint *bi, long long *dst);
 #endif
 
 value make_unsigned_int_or_bigint(unsigned long long u);
@@ -19,8 +19,15 @@
  * PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
  */
 
+#include "../mudlle-config.h"
+
 #include <string.h>
 
+#if defined __i386__ || defined __x86_64__
+#  include <immintrin.h>
+#  define USE_SIMD_KERNELS
+#endif
+
 #include "bitset.h"
 #include "check-types.h"
 #include "prims.h"
@@ -28,6 +35,248 @@
 #include "../interpret.h"
 #include "../utils.h"
 
+/* Bitsets are strings, with bit n stored as P(n % CHAR_BIT) in byte
+   n / CHAR_BIT.
+
+   The set operations below run a word at a time, or a vector at a time
+   on CPUs with SSE2 or AVX2, picking the best kernels in bitset_init().
+   The vector kernels handle whole vectors and leave any tail to the
+   scalar ones. */
+
+typedef unsigned long bword;
+
+static inline bword load_bword(const char *s)
+{
+  bword w;
+  memcpy(&w, s, sizeof w);
+  return w;
+}
+
+static inline void store_bword(char *s, bword w)
+{
+  memcpy(s, &w, sizeof w);
+}
+
+#define BOP_or(a, b)     ((a) | (b))
+#define BOP_and(a, b)    ((a) & (b))
+#define BOP_andnot(a, b) ((a) & ~(b))
+#define BOP_xor(a, b)    ((a) ^ (b))
+
+/* to = s1 op s2; to may be s1 */
+#define DEF_SCALAR_BITOP(op)                                            \
+static void scalar_b ## op(const char *s1, const char *s2, char *to,    \
+                           size_t n)                                    \
+{                                                                       \
+  for (; n >= sizeof (bword); n -= sizeof (bword), s1 += sizeof (bword), \
+         s2 += sizeof (bword), to += sizeof (bword))                    \
+    store_bword(to, BOP_ ## op(load_bword(s1), load_bword(s2)));        \
+  for (; n; --n)                                                        \
+    *to++ = BOP_ ## op(*s1++, *s2++);                                   \
+}
+
+/* true if any bit of s1 op s2 is set */
+#define DEF_SCALAR_BITTEST(op)                                          \
+static bool scalar_any_ ## op(const char *s1, const char *s2, size_t n) \
+{                                                                       \
+  for (; n >= sizeof (bword); n -= sizeof (bword), s1 += sizeof (bword), \
+         s2 += sizeof (bword))                                          \
+    if (BOP_ ## op(load_bword(s1), load_bword(s2)))                     \
+      return true;                                                      \
+  for (; n; --n)                                                        \
+    if ((unsigned char)BOP_ ## op(*s1++, *s2++))                        \
+      return true;                                                      \
+  return false;                                                         \
+}
+
+DEF_SCALAR_BITOP(or)
+DEF_SCALAR_BITOP(and)
+DEF_SCALAR_BITOP(andnot)
+
+DEF_SCALAR_BITTEST(and)
+DEF_SCALAR_BITTEST(andnot)
+DEF_SCALAR_BITTEST(xor)
+
+static inline long count_body(const char *s, size_t n)
+{
+  long count = 0;
+  for (; n >= sizeof (bword); n -= sizeof (bword), s += sizeof (bword))
+    count += popcountl(load_bword(s));
+  for (; n; --n)
+    count += popcount((unsigned char)*s++);
+  return count;
+}
+
+static long scalar_count(const char *s, size_t n)
+{
+  return count_body(s, n);
+}
+
+#ifdef USE_SIMD_KERNELS
+
+/* vector operations for each instruction set */
+#define sse2_vec      __m128i
+#define sse2_width    16
+#define sse2_load     _mm_loadu_si128
+#define sse2_store    _mm_storeu_si128
+#define sse2_zero     _mm_setzero_si128
+#define sse2_cmpeq    _mm_cmpeq_epi8
+#define sse2_and      _mm_and_si128
+#define sse2_andnot   _mm_andnot_si128
+#define sse2_or       _mm_or_si128
+#define sse2_xor      _mm_xor_si128
+#define sse2_movemask _mm_movemask_epi8
+
+#define avx2_vec      __m256i
+#define avx2_width    32
+#define avx2_load     _mm256_loadu_si256
+#define avx2_store    _mm256_storeu_si256
+#define avx2_zero     _mm256_setzero_si256
+#define avx2_cmpeq    _mm256_cmpeq_epi8
+#define avx2_and      _mm256_and_si256
+#define avx2_andnot   _mm256_andnot_si256
+#define avx2_or       _mm256_or_si256
+#define avx2_xor      _mm256_xor_si256
+#define avx2_movemask _mm256_movemask_epi8
+
+#define V(isa, op) isa ## _ ## op
+
+/* the andnot instructions complement their first operand */
+#define VBOP_or(isa, a, b)     V(isa, or)(a, b)
+#define VBOP_and(isa, a, b)    V(isa, and)(a, b)
+#define VBOP_andnot(isa, a, b) V(isa, andnot)(b, a)
+#define VBOP_xor(isa, a, b)    V(isa, xor)(a, b)
+
+#define VLOAD(isa, s) V(isa, load)((const V(isa, vec) *)(s))
+
+/* true if any bit of v is set */
+#define VANY(isa, v)                                                    \
+  ((unsigned)V(isa, movemask)(V(isa, cmpeq)(v, V(isa, zero)()))        \
+   != (unsigned)((1ULL << V(isa, width)) - 1))
+
+#define DEF_SIMD_BITOP(isa, op)                                         \
+static __attribute__((target(#isa)))                                    \
+void isa ## _b ## op(const char *s1, const char *s2, char *to, size_t n) \
+{                                                                       \
+  for (; n >= V(isa, width); n -= V(isa, width), s1 += V(isa, width),   \
+         s2 += V(isa, width), to += V(isa, width))                      \
+    V(isa, store)((V(isa, vec) *)to,                                    \
+                  VBOP_ ## op(isa, VLOAD(isa, s1), VLOAD(isa, s2)));    \
+  scalar_b ## op(s1, s2, to, n);                                        \
+}
+
+#define DEF_SIMD_BITTEST(isa, op)                                       \
+static __attribute__((target(#isa)))                                    \
+bool isa ## _any_ ## op(const char *s1, const char *s2, size_t n)       \
+{                                                                       \
+  for (; n >= V(isa, width); n -= V(isa, width), s1 += V(isa, width),   \
+         s2 += V(isa, width))                                           \
+    if (VANY(isa, VBOP_ ## op(isa, VLOAD(isa, s1), VLOAD(isa, s2))))    \
+      return true;                                                      \
+  return scalar_any_ ## op(s1, s2, n);                                  \
+}
+
+#define DEF_SIMD_KERNELS(isa)                   \
+DEF_SIMD_BITOP(isa, or)                         \
+DEF_SIMD_BITOP(isa, and)                        \
+DEF_SIMD_BITOP(isa, andnot)                     \
+DEF_SIMD_BITTEST(isa, and)                      \
+DEF_SIMD_BITTEST(isa, andnot)                   \
+DEF_SIMD_BITTEST(isa, xor)
+
+DEF_SIMD_KERNELS(sse2)
+DEF_SIMD_KERNELS(avx2)
+
+/* the popcount builtin only becomes a single instruction with popcnt */
+static __attribute__((target("popcnt")))
+long popcnt_count(const char *s, size_t n)
+{
+  return count_body(s, n);
+}
+
+#endif  /* USE_SIMD_KERNELS */
+
+/* The best kernels for this CPU; set by bitset_init() */
+static struct {
+  void (*bor)(const char *s1, const char *s2, char *to, size_t n);
+  void (*band)(const char *s1, const char *s2, char *to, size_t n);
+  void (*bandnot)(const char *s1, const char *s2, char *to, size_t n);
+  bool (*any_and)(const char *s1, const char *s2, size_t n);
+  bool (*any_andnot)(const char *s1, const char *s2, size_t n);
+  bool (*any_xor)(const char *s1, const char *s2, size_t n);
+  long (*count)(const char *s, size_t n);
+} kernels = {
+  .bor        = scalar_bor,
+  .band       = scalar_band,
+  .bandnot    = scalar_bandnot,
+  .any_and    = scalar_any_and,
+  .any_andnot = scalar_any_andnot,
+  .any_xor    = scalar_any_xor,
+  .count      = scalar_count,
+};
+
+void bits_or(const char *s1, const char *s2, char *to, size_t n)
+{
+  kernels.bor(s1, s2, to, n);
+}
+
+void bits_and(const char *s1, const char *s2, char *to, size_t n)
+{
+  kernels.band(s1, s2, to, n);
+}
+
+void bits_andnot(const char *s1, const char *s2, char *to, size_t n)
+{
+  kernels.bandnot(s1, s2, to, n);
+}
+
+bool bits_intersect(const char *s1, const char *s2, size_t n)
+{
+  return kernels.any_and(s1, s2, n);
+}
+
+bool bits_subset(const char *s1, const char *s2, size_t n)
+{
+  return !kernels.any_andnot(s1, s2, n);
+}
+
+bool bits_equal(const char *s1, const char *s2, size_t n)
+{
+  return !kernels.any_xor(s1, s2, n);
+}
+
+bool bits_empty(const char *s, size_t n)
+{
+  return !kernels.any_and(s, s, n);
+}
+
+long bits_count(const char *s, size_t n)
+{
+  return kernels.count(s, n);
+}
+
+long bits_next(const char *s, size_t n, ulong from)
+{
+  ulong i = from / CHAR_BIT;
+  if (i >= n)
+    return -1;
+  unsigned char c = s[i] & ~(P(from % CHAR_BIT) - 1);
+  if (c == 0)
+    {
+      /* skip whole zero words before looking at single bytes */
+      for (++i; i % sizeof (bword) && i < n && s[i] == 0; ++i)
+        ;
+      for (; i + sizeof (bword) <= n && load_bword(s + i) == 0;
+           i += sizeof (bword))
+        ;
+      for (; i < n && s[i] == 0; ++i)
+        ;
+      if (i == n)
+        return -1;
+      c = s[i];
+    }
+  return i * CHAR_BIT + __builtin_ctz(c);
+}
+
 TYPEDOP(new_bitset, ,
         "`n -> `bitset. Returns an empty bitset usable for storing at"
         " least `n bits.",
@@ -159,25 +408,12 @@ static struct string *bitset_binop(const struct prim_op *pop,
   return result;
 }
 
-static void bunion_op(const char *s1, const char *s2, char *to, size_t length)
-{
-  while (length--)
-    *to++ = *s1++ | *s2++;
-}
-
 TYPEDOP(bunion, ,
         "`bitset1 `bitset2 -> `bitset3. `bitset3 = `bitset1 U `bitset2",
 	(struct string *b1, struct string *b2),
 	OP_TRIVIAL | OP_LEAF | OP_NOESCAPE, "ss.s")
 {
-  return bitset_binop(THIS_OP, b1, b2, true, bunion_op);
-}
-
-static void bintersection_op(const char *s1, const char *s2, char *to,
-                             size_t length)
-{
-  while (length--)
-    *to++ = *s1++ & *s2++;
+  return bitset_binop(THIS_OP, b1, b2, true, kernels.bor);
 }
 
 TYPEDOP(bintersection, ,
@@ -185,14 +421,7 @@ TYPEDOP(bintersection, ,
 	(struct string *b1, struct string *b2),
 	OP_TRIVIAL | OP_LEAF | OP_NOESCAPE, "ss.s")
 {
-  return bitset_binop(THIS_OP, b1, b2, true, bintersection_op);
-}
-
-static void bdifference_op(const char *s1, const char *s2, char *to,
-                           size_t length)
-{
-  while (length--)
-    *to++ = *s1++ & ~*s2++;
+  return bitset_binop(THIS_OP, b1, b2, true, kernels.band);
 }
 
 TYPEDOP(bdifference, ,
@@ -200,7 +429,7 @@ TYPEDOP(bdifference, ,
 	(struct string *b1, struct string *b2),
 	OP_TRIVIAL | OP_LEAF | OP_NOESCAPE, "ss.s")
 {
-  return bitset_binop(THIS_OP, b1, b2, true, bdifference_op);
+  return bitset_binop(THIS_OP, b1, b2, true, kernels.bandnot);
 }
 
 TYPEDOP(bunionb, "bunion!",
@@ -208,7 +437,7 @@ TYPEDOP(bunionb, "bunion!",
 	(struct string *b1, struct string *b2),
 	OP_TRIVIAL | OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "ss.s")
 {
-  return bitset_binop(THIS_OP, b1, b2, false, bunion_op);
+  return bitset_binop(THIS_OP, b1, b2, false, kernels.bor);
 }
 
 TYPEDOP(bintersectionb, "bintersection!",
@@ -216,7 +445,7 @@ TYPEDOP(bintersectionb, "bintersection!",
 	(struct string *b1, struct string *b2),
 	OP_TRIVIAL | OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "ss.s")
 {
-  return bitset_binop(THIS_OP, b1, b2, false, bintersection_op);
+  return bitset_binop(THIS_OP, b1, b2, false, kernels.band);
 }
 
 TYPEDOP(bdifferenceb, "bdifference!",
@@ -224,7 +453,7 @@ TYPEDOP(bdifferenceb, "bdifference!",
 	(struct string *b1, struct string *b2),
 	OP_TRIVIAL | OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "ss.s")
 {
-  return bitset_binop(THIS_OP, b1, b2, false, bdifference_op);
+  return bitset_binop(THIS_OP, b1, b2, false, kernels.bandnot);
 }
 
 static void bassign_op(const char *s1, const char *s2, char *to,
@@ -251,12 +480,20 @@ TYPEDOP(bitset_inp, "bitset_in?",
   if (l != string_len(b2))
     RUNTIME_ERROR(error_bad_value, "arguments of different length");
 
-  const char *sb1 = b1->str, *sb2 = b2->str;
-  while (l-- >= 0)
-    if (*sb1++ & ~*sb2++)
-      return makebool(false);
+  return makebool(bits_subset(b1->str, b2->str, l));
+}
 
-  return makebool(true);
+TYPEDOP(bintersectsp, "bintersects?",
+        "`bitset1 `bitset2 -> `b. True if `bitset1 and `bitset2 have a bit"
+        " in common",
+	(struct string *b1, struct string *b2),
+	OP_TRIVIAL | OP_LEAF | OP_NOALLOC | OP_NOESCAPE | OP_CONST, "ss.n")
+{
+  CHECK_TYPES(b1, string, b2, string);
+  long l = string_len(b1);
+  if (l != string_len(b2))
+    RUNTIME_ERROR(error_bad_value, "arguments of different length");
+  return makebool(bits_intersect(b1->str, b2->str, l));
 }
 
 TYPEDOP(bitset_eqp, "bitset_eq?",
@@ -268,7 +505,7 @@ TYPEDOP(bitset_eqp, "bitset_eq?",
   long l = string_len(b1);
   if (l != string_len(b2))
     RUNTIME_ERROR(error_bad_value, "arguments of different length");
-  return makebool(memcmp(b1->str, b2->str, l) == 0);
+  return makebool(bits_equal(b1->str, b2->str, l));
 }
 
 TYPEDOP(bemptyp, "bempty?",
@@ -277,12 +514,7 @@ TYPEDOP(bemptyp, "bempty?",
 	OP_TRIVIAL | OP_LEAF | OP_NOALLOC | OP_NOESCAPE | OP_CONST, "s.n")
 {
   CHECK_TYPES(b, string);
-  long l = string_len(b);
-  const char *sb = b->str;
-  while (l-- > 0)
-    if (*sb++) return makebool(false);
-
-  return makebool(true);
+  return makebool(bits_empty(b->str, string_len(b)));
 }
 
 TYPEDOP(bcount, , "`bitset -> `n. Returns the number of bits set in `bitset",
@@ -290,25 +522,19 @@ TYPEDOP(bcount, , "`bitset -> `n. Returns the number of bits set in `bitset",
 	OP_TRIVIAL | OP_LEAF | OP_NOALLOC | OP_NOESCAPE | OP_CONST, "s.n")
 {
   CHECK_TYPES(b, string);
+  return makeint(bits_count(b->str, string_len(b)));
+}
 
-  long l = string_len(b);
-  const unsigned char *sb = (const unsigned char *)b->str;
-  int n = 0;
-  while (l >= sizeof (unsigned long))
-    {
-      n += popcountl(*(unsigned long *)sb);
-      l -= sizeof (unsigned long);
-      sb += sizeof (unsigned long);
-    }
-  if (l > 0)
-    {
-      unsigned long u = 0;
-      do
-        u = (u << CHAR_BIT) | *sb++;
-      while (--l > 0);
-      n += popcountl(u);
-    }
-  return makeint(n);
+TYPEDOP(bnext_set, ,
+        "`bitset `n -> `n. Returns the first bit at or after bit `n that is"
+        " set in `bitset, or -1 if there is none",
+	(struct string *b, value mfrom),
+	OP_TRIVIAL | OP_LEAF | OP_NOALLOC | OP_NOESCAPE | OP_CONST, "sn.n")
+{
+  long from;
+  CHECK_TYPES(b,     string,
+              mfrom, CT_RANGE(from, 0, MAX_TAGGED_INT));
+  return makeint(bits_next(b->str, string_len(b), from));
 }
 
 void bitset_init(void)
@@ -327,7 +553,33 @@ void bitset_init(void)
   DEFINE(bdifferenceb);
   DEFINE(bassignb);
   DEFINE(bitset_inp);
+  DEFINE(bintersectsp);
   DEFINE(bitset_eqp);
   DEFINE(bemptyp);
   DEFINE(bcount);
+  DEFINE(bnext_set);
+
+#ifdef USE_SIMD_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    {
+      kernels.bor        = avx2_bor;
+      kernels.band       = avx2_band;
+      kernels.bandnot    = avx2_bandnot;
+      kernels.any_and    = avx2_any_and;
+      kernels.any_andnot = avx2_any_andnot;
+      kernels.any_xor    = avx2_any_xor;
+    }
+  else if (__builtin_cpu_supports("sse2"))
+    {
+      kernels.bor        = sse2_bor;
+      kernels.band       = sse2_band;
+      kernels.bandnot    = sse2_bandnot;
+      kernels.any_and    = sse2_any_and;
+      kernels.any_andnot = sse2_any_andnot;
+      kernels.any_xor    = sse2_any_xor;
+    }
+  if (__builtin_cpu_supports("popcnt"))
+    kernels.count = popcnt_count;
+#endif
 }
@@ -25,6 +25,18 @@
 #include "../types.h"
 
 void bitset_init(void);
+
+/* Kernels on bitset data of n bytes; to may be one of the inputs. */
+void bits_or(const char *s1, const char *s2, char *to, size_t n);
+void bits_and(const char *s1, const char *s2, char *to, size_t n);
+void bits_andnot(const char *s1, const char *s2, char *to, size_t n);
+bool bits_intersect(const char *s1, const char *s2, size_t n);
+bool bits_subset(const char *s1, const char *s2, size_t n);
+bool bits_equal(const char *s1, const char *s2, size_t n);
+bool bits_empty(const char *s, size_t n);
+long bits_count(const char *s, size_t n);
+/* returns the first set bit at or after 'from', or -1 */
+long bits_next(const char *s, size_t n, ulong from);
 value code_bit_setp(struct string *b, value n);
 
 #endif /* RUNTIME_BITSET_H */
@@ -0,0 +1,746 @@
+/*
+ * Copyright (c) 1993-2012 David Gay and Gustav Hllberg
+ * All rights reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose, without fee, and without written agreement is hereby granted,
+ * provided that the above copyright notice and the following two paragraphs
+ * appear in all copies of this software.
+ *
+ * IN NO EVENT SHALL DAVID GAY OR GUSTAV HALLBERG BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES ARISING OUT
+ * OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF DAVID GAY OR
+ * GUSTAV HALLBERG HAVE BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * DAVID GAY AND GUSTAV HALLBERG SPECIFICALLY DISCLAIM ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN
+ * "AS IS" BASIS, AND DAVID GAY AND GUSTAV HALLBERG HAVE NO OBLIGATION TO
+ * PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ */
+
+
+#include <string.h>
+
+#include "btree.h"
+#include "check-types.h"
+#include "prims.h"
+
+#include "../alloc.h"
+#include "../call.h"
+
+/* Ordered maps from integer and string keys to values, stored as B-trees.
+   Integers sort before strings; strings sort bytewise.
+
+   Each node is a vector holding its number of keys, the number of entries
+   in its subtree (for rank queries), its keys, its values and, for
+   internal nodes only, its children. Keys are kept sorted, so each node
+   is searched with a binary search over a contiguous array. */
+
+#define BT_T       16           /* minimum degree */
+#define BT_MAXKEYS (2 * BT_T - 1)
+
+enum {
+  NODE_NKEYS    = 0,
+  NODE_SIZE     = 1,
+  NODE_KEYS     = 2,
+  NODE_VALUES   = NODE_KEYS + BT_MAXKEYS,
+  NODE_CHILDREN = NODE_VALUES + BT_MAXKEYS,
+  LEAF_LEN      = NODE_CHILDREN,
+  INTERNAL_LEN  = NODE_CHILDREN + BT_MAXKEYS + 1
+};
+
+struct omap {
+  struct mprivate p;
+  struct vector *root;
+};
+
+#ifdef LOCAL_MUDLLE_TYPES
+#undef LOCAL_MUDLLE_TYPES
+#define LOCAL_MUDLLE_TYPES struct omap *: true,
+#endif
+
+static bool is_omap(value _m)
+{
+  struct omap *m = _m;
+  return (TYPE(m, private)
+          && m->p.ptype == makeint(PRIVATE_OMAP));
+}
+
+static enum runtime_error ct_omap(value v, const char **errmsg, bool write)
+{
+  if (!is_omap(v))
+    {
+      *errmsg = "expected ordered map";
+      return error_bad_type;
+    }
+  if (write && readonlyp(v))
+    return error_value_read_only;
+  return error_none;
+}
+
+#define CT_OMAP(write) F(TSET(private), ct_omap, write)
+#define CT_OMAP_KEY CT_TYPES(integer, string)
+#define CT_OMAP_BOUND CT_TYPES(null, integer, string)
+
+static long nkeys(struct vector *n)
+{
+  return intval(n->data[NODE_NKEYS]);
+}
+
+static long node_size(struct vector *n)
+{
+  return intval(n->data[NODE_SIZE]);
+}
+
+static bool is_leaf(struct vector *n)
+{
+  return vector_len(n) == LEAF_LEN;
+}
+
+static value *node_keys(struct vector *n)
+{
+  return &n->data[NODE_KEYS];
+}
+
+static value *node_values(struct vector *n)
+{
+  return &n->data[NODE_VALUES];
+}
+
+static struct vector **node_children(struct vector *n)
+{
+  assert(!is_leaf(n));
+  return (struct vector **)&n->data[NODE_CHILDREN];
+}
+
+static void set_nkeys(struct vector *n, long nk)
+{
+  n->data[NODE_NKEYS] = makeint(nk);
+}
+
+static void add_size(struct vector *n, long delta)
+{
+  n->data[NODE_SIZE] = makeint(node_size(n) + delta);
+}
+
+/* recompute the subtree size of n from its contents */
+static void recount(struct vector *n)
+{
+  long size = nkeys(n);
+  if (!is_leaf(n))
+    {
+      struct vector **children = node_children(n);
+      for (long i = 0; i <= nkeys(n); ++i)
+        size += node_size(children[i]);
+    }
+  n->data[NODE_SIZE] = makeint(size);
+}
+
+static int key_cmp(value a, value b)
+{
+  if (integerp(a))
+    {
+      if (!integerp(b))
+        return -1;
+      long ia = intval(a), ib = intval(b);
+      return ia < ib ? -1 : ia > ib;
+    }
+  if (integerp(b))
+    return 1;
+  struct string *sa = a, *sb = b;
+  size_t la = string_len(sa), lb = string_len(sb);
+  int r = memcmp(sa->str, sb->str, la < lb ? la : lb);
+  if (r != 0)
+    return r;
+  return la < lb ? -1 : la > lb;
+}
+
+/* returns the index of the first key in n that is >= key; *found is set
+   if it is equal */
+static long node_search(struct vector *n, value key, bool *found)
+{
+  value *keys = node_keys(n);
+  long lo = 0, hi = nkeys(n);
+  while (lo < hi)
+    {
+      long mid = (lo + hi) / 2;
+      if (key_cmp(keys[mid], key) < 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+  *found = lo < nkeys(n) && key_cmp(keys[lo], key) == 0;
+  return lo;
+}
+
+static struct vector *alloc_node(bool leaf)
+{
+  struct vector *n = alloc_vector(leaf ? LEAF_LEN : INTERNAL_LEN);
+  set_nkeys(n, 0);
+  n->data[NODE_SIZE] = makeint(0);
+  return n;
+}
+
+/* returns the slot of key's value, or NULL */
+static value *omap_find(struct omap *m, value key)
+{
+  struct vector *n = m->root;
+  for (;;)
+    {
+      bool found;
+      long i = node_search(n, key, &found);
+      if (found)
+        return &node_values(n)[i];
+      if (is_leaf(n))
+        return NULL;
+      n = node_children(n)[i];
+    }
+}
+
+/* move the entries [from, from + count) of src to dst at index to */
+static void move_entries(struct vector *dst, long to, struct vector *src,
+                         long from, long count)
+{
+  memmove(&node_keys(dst)[to], &node_keys(src)[from],
+          count * sizeof (value));
+  memmove(&node_values(dst)[to], &node_values(src)[from],
+          count * sizeof (value));
+}
+
+static void move_children(struct vector *dst, long to, struct vector *src,
+                          long from, long count)
+{
+  memmove(&node_children(dst)[to], &node_children(src)[from],
+          count * sizeof (value));
+}
+
+/* clear entries (and children) from index nk on, so the GC does not keep
+   stale values alive */
+static void clear_tail(struct vector *n, long nk)
+{
+  for (long i = nk; i < BT_MAXKEYS; ++i)
+    node_keys(n)[i] = node_values(n)[i] = NULL;
+  if (!is_leaf(n))
+    for (long i = nk + 1; i <= BT_MAXKEYS; ++i)
+      node_children(n)[i] = NULL;
+}
+
+/* split the full child i of parent; may GC */
+static void split_child(struct vector *parent, long i)
+{
+  bool leaf = is_leaf(node_children(parent)[i]);
+  GCPRO(parent);
+  struct vector *right = alloc_node(leaf);
+  UNGCPRO();
+  struct vector *left = node_children(parent)[i];
+  assert(nkeys(left) == BT_MAXKEYS);
+
+  move_entries(right, 0, left, BT_T, BT_T - 1);
+  if (!leaf)
+    move_children(right, 0, left, BT_T, BT_T);
+  set_nkeys(right, BT_T - 1);
+
+  long pn = nkeys(parent);
+  move_entries(parent, i + 1, parent, i, pn - i);
+  move_children(parent, i + 2, parent, i + 1, pn - i);
+  node_keys(parent)[i] = node_keys(left)[BT_T - 1];
+  node_values(parent)[i] = node_values(left)[BT_T - 1];
+  node_children(parent)[i + 1] = right;
+  set_nkeys(parent, pn + 1);
+
+  set_nkeys(left, BT_T - 1);
+  clear_tail(left, BT_T - 1);
+  recount(left);
+  recount(right);
+}
+
+/* add key, which must not be in m; may GC */
+static void omap_insert(struct omap *m, value key, value val)
+{
+  struct vector *n = NULL;
+  GCPRO(m, key, val, n);
+
+  if (nkeys(m->root) == BT_MAXKEYS)
+    {
+      n = alloc_node(false);
+      node_children(n)[0] = m->root;
+      recount(n);
+      m->root = n;
+      split_child(n, 0);
+    }
+
+  n = m->root;
+  for (;;)
+    {
+      add_size(n, 1);
+      bool found;
+      long i = node_search(n, key, &found);
+      assert(!found);
+      if (is_leaf(n))
+        {
+          move_entries(n, i + 1, n, i, nkeys(n) - i);
+          node_keys(n)[i] = key;
+          node_values(n)[i] = val;
+          set_nkeys(n, nkeys(n) + 1);
+          break;
+        }
+      if (nkeys(node_children(n)[i]) == BT_MAXKEYS)
+        {
+          split_child(n, i);
+          if (key_cmp(key, node_keys(n)[i]) > 0)
+            ++i;
+        }
+      n = node_children(n)[i];
+    }
+  UNGCPRO();
+}
+
+/* merge child i + 1 of n and key i into child i */
+static void merge_children(struct vector *n, long i)
+{
+  struct vector *left = node_children(n)[i];
+  struct vector *right = node_children(n)[i + 1];
+  long ln = nkeys(left), rn = nkeys(right);
+
+  node_keys(left)[ln] = node_keys(n)[i];
+  node_values(left)[ln] = node_values(n)[i];
+  move_entries(left, ln + 1, right, 0, rn);
+  if (!is_leaf(left))
+    move_children(left, ln + 1, right, 0, rn + 1);
+  set_nkeys(left, ln + 1 + rn);
+  recount(left);
+
+  long pn = nkeys(n);
+  move_entries(n, i, n, i + 1, pn - i - 1);
+  move_children(n, i + 1, n, i + 2, pn - i - 1);
+  set_nkeys(n, pn - 1);
+  clear_tail(n, pn - 1);
+}
+
+/* make sure child i of n has at least BT_T keys; returns the index of the
+   child that now covers the same keys */
+static long fill_child(struct vector *n, long i)
+{
+  struct vector **children = node_children(n);
+  struct vector *c = children[i];
+  if (nkeys(c) >= BT_T)
+    return i;
+
+  if (i > 0 && nkeys(children[i - 1]) >= BT_T)
+    {
+      /* borrow the last entry of the left sibling via n */
+      struct vector *left = children[i - 1];
+      long ln = nkeys(left), cn = nkeys(c);
+      move_entries(c, 1, c, 0, cn);
+      node_keys(c)[0] = node_keys(n)[i - 1];
+      node_values(c)[0] = node_values(n)[i - 1];
+      node_keys(n)[i - 1] = node_keys(left)[ln - 1];
+      node_values(n)[i - 1] = node_values(left)[ln - 1];
+      if (!is_leaf(c))
+        {
+          move_children(c, 1, c, 0, cn + 1);
+          node_children(c)[0] = node_children(left)[ln];
+        }
+      set_nkeys(c, cn + 1);
+      set_nkeys(left, ln - 1);
+      clear_tail(left, ln - 1);
+      recount(left);
+      recount(c);
+      return i;
+    }
+
+  if (i < nkeys(n) && nkeys(children[i + 1]) >= BT_T)
+    {
+      /* borrow the first entry of the right sibling via n */
+      struct vector *right = children[i + 1];
+      long rn = nkeys(right), cn = nkeys(c);
+      node_keys(c)[cn] = node_keys(n)[i];
+      node_values(c)[cn] = node_values(n)[i];
+      node_keys(n)[i] = node_keys(right)[0];
+      node_values(n)[i] = node_values(right)[0];
+      if (!is_leaf(c))
+        {
+          node_children(c)[cn + 1] = node_children(right)[0];
+          move_children(right, 0, right, 1, rn);
+        }
+      move_entries(right, 0, right, 1, rn - 1);
+      set_nkeys(c, cn + 1);
+      set_nkeys(right, rn - 1);
+      clear_tail(right, rn - 1);
+      recount(right);
+      recount(c);
+      return i;
+    }
+
+  if (i == nkeys(n))
+    --i;
+  merge_children(n, i);
+  return i;
+}
+
+/* remove key, which must be in m; does not allocate */
+static void omap_delete(struct omap *m, value key)
+{
+  struct vector *n = m->root;
+  for (;;)
+    {
+      add_size(n, -1);
+      bool found;
+      long i = node_search(n, key, &found);
+      if (is_leaf(n))
+        {
+          assert(found);
+          long nk = nkeys(n);
+          move_entries(n, i, n, i + 1, nk - i - 1);
+          set_nkeys(n, nk - 1);
+          clear_tail(n, nk - 1);
+          break;
+        }
+
+      struct vector **children = node_children(n);
+      if (found)
+        {
+          if (nkeys(children[i]) >= BT_T)
+            {
+              /* replace with the predecessor and delete that instead */
+              struct vector *p = children[i];
+              while (!is_leaf(p))
+                p = node_children(p)[nkeys(p)];
+              key = node_keys(n)[i] = node_keys(p)[nkeys(p) - 1];
+              node_values(n)[i] = node_values(p)[nkeys(p) - 1];
+              n = children[i];
+            }
+          else if (nkeys(children[i + 1]) >= BT_T)
+            {
+              /* replace with the successor and delete that instead */
+              struct vector *s = children[i + 1];
+              while (!is_leaf(s))
+                s = node_children(s)[0];
+              key = node_keys(n)[i] = node_keys(s)[0];
+              node_values(n)[i] = node_values(s)[0];
+              n = children[i + 1];
+            }
+          else
+            {
+              merge_children(n, i);
+              n = children[i];
+            }
+          continue;
+        }
+
+      i = fill_child(n, i);
+      n = node_children(n)[i];
+    }
+
+  struct vector *root = m->root;
+  if (nkeys(root) == 0 && !is_leaf(root))
+    m->root = node_children(root)[0];
+}
+
+/* number of keys < key (or <= key if inclusive) */
+static long omap_rank(struct omap *m, value key, bool inclusive)
+{
+  long rank = 0;
+  struct vector *n = m->root;
+  for (;;)
+    {
+      bool found;
+      long i = node_search(n, key, &found);
+      rank += i;
+      if (!is_leaf(n))
+        for (long j = 0; j < i; ++j)
+          rank += node_size(node_children(n)[j]);
+      if (found)
+        {
+          if (!is_leaf(n))
+            rank += node_size(node_children(n)[i]);
+          return rank + inclusive;
+        }
+      if (is_leaf(n))
+        return rank;
+      n = node_children(n)[i];
+    }
+}
+
+/* returns the node containing the idx'th entry, setting *pos to its
+   index there */
+static struct vector *omap_nth(struct omap *m, long idx, long *pos)
+{
+  assert(idx >= 0 && idx < node_size(m->root));
+  struct vector *n = m->root;
+  for (;;)
+    {
+      if (is_leaf(n))
+        {
+          *pos = idx;
+          return n;
+        }
+      struct vector **children = node_children(n);
+      long i = 0;
+      for (;; ++i)
+        {
+          long csize = node_size(children[i]);
+          if (idx < csize)
+            break;
+          idx -= csize;
+          if (idx == 0)
+            {
+              *pos = i;
+              return n;
+            }
+          --idx;
+        }
+      n = children[i];
+    }
+}
+
+/* store the entries of n's subtree with index in [from, to) in dst as
+   (key, value), starting at dst->data[*d] */
+static void collect_entries(struct vector *n, long from, long to,
+                            struct vector *dst, long *d)
+{
+  bool leaf = is_leaf(n);
+  long idx = 0;
+  for (long i = 0; i <= nkeys(n) && idx < to; ++i)
+    {
+      if (!leaf)
+        {
+          struct vector *c = node_children(n)[i];
+          long csize = node_size(c);
+          if (idx + csize > from)
+            collect_entries(c, from - idx, to - idx, dst, d);
+          idx += csize;
+        }
+      if (i < nkeys(n) && idx >= from && idx < to)
+        {
+          dst->data[(*d)++] = node_keys(n)[i];
+          dst->data[(*d)++] = node_values(n)[i];
+        }
+      ++idx;
+    }
+}
+
+/* returns a list of (key . value) for entries from..to-1 */
+static struct list *entry_list(struct omap *m, long from, long to)
+{
+  struct vector *v = NULL;
+  struct list *l = NULL;
+  GCPRO(m, v, l);
+  v = alloc_vector(2 * (to - from));
+  long d = 0;
+  collect_entries(m->root, from, to, v, &d);
+  for (long i = vector_len(v); i > 0; i -= 2)
+    {
+      struct list *kv = alloc_list(v->data[i - 2], v->data[i - 1]);
+      l = alloc_list(kv, l);
+    }
+  UNGCPRO();
+  return l;
+}
+
+static value entry_pair(struct omap *m, long idx)
+{
+  long pos;
+  struct vector *n = omap_nth(m, idx, &pos);
+  return alloc_list(node_keys(n)[pos], node_values(n)[pos]);
+}
+
+TYPEDOP(make_ordered_map, ,
+        "-> `m. Returns a new, empty ordered map. Its keys must be integers"
+        " or strings; integers sort before strings, and strings sort as"
+        " by `string_cmp().",
+        (void), OP_LEAF | OP_NOESCAPE, ".o")
+{
+  struct omap *m = (struct omap *)alloc_private(PRIVATE_OMAP, 1);
+  GCPRO(m);
+  struct vector *root = alloc_node(true);
+  UNGCPRO();
+  m->root = root;
+  return m;
+}
+
+TYPEDOP(ordered_mapp, "ordered_map?", "`x -> `b. True if `x is an ordered"
+        " map.",
+        (value x), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "x.n")
+{
+  return makebool(is_omap(x));
+}
+
+TYPEDOP(ordered_map_entries, ,
+        "`m -> `n. Returns the number of entries in ordered map `m.",
+        (struct omap *m), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "o.n")
+{
+  CHECK_TYPES(m, CT_OMAP(false));
+  return m->root->data[NODE_SIZE];
+}
+
+TYPEDOP(ordered_map_ref, ,
+        "`m `k -> `x. Returns the value for key `k in ordered map `m, or"
+        " null if there is none.",
+        (struct omap *m, value key), OP_LEAF | OP_NOALLOC | OP_NOESCAPE,
+        "o[ns].x")
+{
+  CHECK_TYPES(m,   CT_OMAP(false),
+              key, CT_OMAP_KEY);
+  value *slot = omap_find(m, key);
+  return slot ? *slot : NULL;
+}
+
+TYPEDOP(ordered_map_hasp, "ordered_map_has?",
+        "`m `k -> `b. True if ordered map `m has an entry for key `k.",
+        (struct omap *m, value key), OP_LEAF | OP_NOALLOC | OP_NOESCAPE,
+        "o[ns].n")
+{
+  CHECK_TYPES(m,   CT_OMAP(false),
+              key, CT_OMAP_KEY);
+  return makebool(omap_find(m, key) != NULL);
+}
+
+TYPEDOP(ordered_map_set, "ordered_map_set!",
+        "`m `k `x -> `x. Sets the value for key `k in ordered map `m to"
+        " `x.",
+        (struct omap *m, value key, value x), OP_LEAF | OP_NOESCAPE,
+        "o[ns]x.3")
+{
+  CHECK_TYPES(m,   CT_OMAP(true),
+              key, CT_OMAP_KEY,
+              x,   any);
+  value *slot = omap_find(m, key);
+  if (slot)
+    {
+      *slot = x;
+      return x;
+    }
+  GCPRO(m, x);
+  /* string keys are copied, as changing them would break the order */
+  if (!readonlyp(key))
+    key = make_readonly(mudlle_string_copy(key));
+  omap_insert(m, key, x);
+  UNGCPRO();
+  return x;
+}
+
+TYPEDOP(ordered_map_remove, "ordered_map_remove!",
+        "`m `k -> `b. Removes the entry for key `k from ordered map `m."
+        " Returns true if there was one.",
+        (struct omap *m, value key), OP_LEAF | OP_NOALLOC | OP_NOESCAPE,
+        "o[ns].n")
+{
+  CHECK_TYPES(m,   CT_OMAP(true),
+              key, CT_OMAP_KEY);
+  if (omap_find(m, key) == NULL)
+    return makebool(false);
+  omap_delete(m, key);
+  return makebool(true);
+}
+
+TYPEDOP(ordered_map_first, ,
+        "`m -> `x. Returns the entry with the smallest key in ordered map"
+        " `m as (`key . `value), or false if `m is empty.",
+        (struct omap *m), OP_LEAF | OP_NOESCAPE, "o.[kz]")
+{
+  CHECK_TYPES(m, CT_OMAP(false));
+  if (node_size(m->root) == 0)
+    return makebool(false);
+  return entry_pair(m, 0);
+}
+
+TYPEDOP(ordered_map_last, ,
+        "`m -> `x. Returns the entry with the largest key in ordered map"
+        " `m as (`key . `value), or false if `m is empty.",
+        (struct omap *m), OP_LEAF | OP_NOESCAPE, "o.[kz]")
+{
+  CHECK_TYPES(m, CT_OMAP(false));
+  long size = node_size(m->root);
+  if (size == 0)
+    return makebool(false);
+  return entry_pair(m, size - 1);
+}
+
+TYPEDOP(ordered_map_rank, ,
+        "`m `k -> `n. Returns the number of keys in ordered map `m that"
+        " are smaller than `k.",
+        (struct omap *m, value key), OP_LEAF | OP_NOALLOC | OP_NOESCAPE,
+        "o[ns].n")
+{
+  CHECK_TYPES(m,   CT_OMAP(false),
+              key, CT_OMAP_KEY);
+  return makeint(omap_rank(m, key, false));
+}
+
+TYPEDOP(ordered_map_nth, ,
+        "`m `n -> `x. Returns the entry of ordered map `m with the `n'th"
+        " smallest key (counting from 0) as (`key . `value), or false if"
+        " `m has too few entries.",
+        (struct omap *m, value n), OP_LEAF | OP_NOESCAPE, "on.[kz]")
+{
+  long idx;
+  CHECK_TYPES(m, CT_OMAP(false),
+              n, CT_INT(idx));
+  if (idx < 0 || idx >= node_size(m->root))
+    return makebool(false);
+  return entry_pair(m, idx);
+}
+
+TYPEDOP(ordered_map_range, ,
+        "`m `k0 `k1 -> `l. Returns a list of (`key . `value) for the"
+        " entries in ordered map `m with `k0 <= `key <= `k1, in order."
+        " A null bound is unlimited.",
+        (struct omap *m, value lo, value hi), OP_LEAF | OP_NOESCAPE,
+        "o[nsu][nsu].l")
+{
+  CHECK_TYPES(m,  CT_OMAP(false),
+              lo, CT_OMAP_BOUND,
+              hi, CT_OMAP_BOUND);
+  long from = lo ? omap_rank(m, lo, false) : 0;
+  long to = hi ? omap_rank(m, hi, true) : node_size(m->root);
+  if (from >= to)
+    return NULL;
+  return entry_list(m, from, to);
+}
+
+TYPEDOP(ordered_map_list, ,
+        "`m -> `l. Returns a list of (`key . `value) for the entries in"
+        " ordered map `m, in order.",
+        (struct omap *m), OP_LEAF | OP_NOESCAPE, "o.l")
+{
+  CHECK_TYPES(m, CT_OMAP(false));
+  return entry_list(m, 0, node_size(m->root));
+}
+
+TYPEDOP(ordered_map_foreach, ,
+        "`c `m -> . Calls `c(`key, `value) for each entry in ordered map"
+        " `m, in order. It is safe to modify `m from `c().",
+        (value f, struct omap *m), 0, "fo.")
+{
+  CHECK_TYPES(f, CT_CALLABLE(2),
+              m, CT_OMAP(false));
+  struct vector *v = NULL;
+  GCPRO(f, v, m);
+  v = alloc_vector(2 * node_size(m->root));
+  long d = 0;
+  collect_entries(m->root, 0, vector_len(v) / 2, v, &d);
+  for (long i = 0, len = vector_len(v); i < len; i += 2)
+    call2(f, v->data[i], v->data[i + 1]);
+  UNGCPRO();
+  undefined();
+}
+
+void btree_init(void)
+{
+  DEFINE(make_ordered_map);
+  DEFINE(ordered_mapp);
+  DEFINE(ordered_map_entries);
+  DEFINE(ordered_map_ref);
+  DEFINE(ordered_map_hasp);
+  DEFINE(ordered_map_set);
+  DEFINE(ordered_map_remove);
+  DEFINE(ordered_map_first);
+  DEFINE(ordered_map_last);
+  DEFINE(ordered_map_rank);
+  DEFINE(ordered_map_nth);
+  DEFINE(ordered_map_range);
+  DEFINE(ordered_map_list);
+  DEFINE(ordered_map_foreach);
+}
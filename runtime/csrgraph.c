@@ -0,0 +1,568 @@
+/*
+ * Copyright (c) 1993-2012 David Gay and Gustav Hllberg
+ * All rights reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose, without fee, and without written agreement is hereby granted,
+ * provided that the above copyright notice and the following two paragraphs
+ * appear in all copies of this software.
+ *
+ * IN NO EVENT SHALL DAVID GAY OR GUSTAV HALLBERG BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES ARISING OUT
+ * OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF DAVID GAY OR
+ * GUSTAV HALLBERG HAVE BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * DAVID GAY AND GUSTAV HALLBERG SPECIFICALLY DISCLAIM ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN
+ * "AS IS" BASIS, AND DAVID GAY AND GUSTAV HALLBERG HAVE NO OBLIGATION TO
+ * PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ */
+
+
+#include <stdint.h>
+#include <string.h>
+
+#include "check-types.h"
+#include "csrgraph.h"
+#include "prims.h"
+
+#include "../alloc.h"
+#include "../call.h"
+
+/* Immutable directed graphs with integer node ids and non-negative integer
+   edge weights, in compressed sparse row form: the out-edges of node v
+   are targets[offsets[v]] ... targets[offsets[v + 1] - 1], with matching
+   weights. All three arrays are uint32_t arrays in strings, so the garbage
+   collector never scans them.
+
+   The search algorithms keep their state in a single scratch string,
+   which is allocated up front and found again after any callback. */
+
+#define NO_NODE   UINT32_MAX
+#define INF_DIST  INT64_MAX
+#define MAX_EDGES (MAX_STRING_SIZE / sizeof (uint32_t))
+
+struct csrgraph {
+  struct mprivate p;
+  value nodes;                  /* makeint(number of nodes) */
+  value edges;                  /* makeint(number of edges) */
+  struct string *offsets;       /* uint32_t[nodes + 1] */
+  struct string *targets;       /* uint32_t[edges] */
+  struct string *weights;       /* uint32_t[edges] */
+};
+
+#ifdef LOCAL_MUDLLE_TYPES
+#undef LOCAL_MUDLLE_TYPES
+#define LOCAL_MUDLLE_TYPES struct csrgraph *: true,
+#endif
+
+static bool is_csrgraph(value _g)
+{
+  struct csrgraph *g = _g;
+  return (TYPE(g, private)
+          && g->p.ptype == makeint(PRIVATE_CSRGRAPH));
+}
+
+static enum runtime_error ct_csrgraph(value v, const char **errmsg)
+{
+  if (!is_csrgraph(v))
+    {
+      *errmsg = "expected CSR graph";
+      return error_bad_type;
+    }
+  return error_none;
+}
+
+static enum runtime_error ct_node(long idx, const char **errmsg,
+                                  struct csrgraph *g, long *dst)
+{
+  if (idx < 0 || idx >= intval(g->nodes))
+    {
+      *errmsg = "node id out of range";
+      return error_bad_index;
+    }
+  *dst = idx;
+  return error_none;
+}
+
+/* heuristics are null, a vector of estimates, or a function */
+static enum runtime_error ct_heuristic(value v, const char **errmsg,
+                                      struct csrgraph *g)
+{
+  if (TYPE(v, vector))
+    {
+      if (vector_len((struct vector *)v) != intval(g->nodes))
+        {
+          *errmsg = "heuristic vector length must match node count";
+          return error_bad_value;
+        }
+      return error_none;
+    }
+  if (v == NULL)
+    return error_none;
+  return function_callable(v, errmsg, 1);
+}
+
+#define __CT_CSRGRAPH_E(v, msg, arg) ct_csrgraph(v, msg)
+#define CT_CSRGRAPH F(TSET(private), __CT_CSRGRAPH_E, )
+#define __CT_NODE_E(v, msg, dst_g)                                      \
+  ct_node(v, msg, ARGN2 dst_g, &(ARGN1 dst_g))
+#define CT_NODE(dst, g) CT_INT_P((dst, g), __CT_NODE_E)
+#define CT_HEURISTIC(g)                                                 \
+  F(TSET(null) | TSET(vector) | TYPESET_FUNCTION, ct_heuristic, g)
+
+static uint32_t *u32(struct string *s)
+{
+  return (uint32_t *)s->str;
+}
+
+static struct string *alloc_scratch(size_t bytes)
+{
+  if (bytes > MAX_STRING_SIZE)
+    runtime_error_message(error_bad_value, "graph too large");
+  return alloc_empty_string(bytes);
+}
+
+/* returns true if v is a valid edge of a graph with n nodes */
+static bool valid_edge(value v, long n)
+{
+  if (!TYPE(v, vector))
+    return false;
+  struct vector *e = v;
+  long len = vector_len(e);
+  if (len != 2 && len != 3)
+    return false;
+  for (long i = 0; i < 2; ++i)
+    if (!integerp(e->data[i]) || intval(e->data[i]) < 0
+        || intval(e->data[i]) >= n)
+      return false;
+  return (len == 2
+          || (integerp(e->data[2]) && intval(e->data[2]) >= 0
+              && intval(e->data[2]) <= INT32_MAX
+              && intval(e->data[2]) <= MAX_TAGGED_INT));
+}
+
+TYPEDOP(make_csr_graph, ,
+        "`n `l -> `g. Returns a new CSR graph with nodes 0 to `n - 1 and"
+        " the edges in list `l. Each edge is a vector [`from `to] or"
+        " [`from `to `weight], where the weight is a non-negative integer"
+        " and defaults to 1.",
+        (value n, struct list *l), OP_LEAF | OP_NOESCAPE, "nl.o")
+{
+  long nnodes;
+  CHECK_TYPES(n, CT_RANGE(nnodes, 0, (long)MAX_EDGES - 1),
+              l, CT_TYPES(null, pair));
+
+  long nedges = 0;
+  for (struct list *scan = l, *slow = l; scan; scan = scan->cdr)
+    {
+      if (!TYPE(scan, pair) || !valid_edge(scan->car, nnodes))
+        RUNTIME_ERROR(error_bad_value, "invalid edge list");
+      if (++nedges > (long)MAX_EDGES)
+        RUNTIME_ERROR(error_bad_value, "too many edges");
+      /* slow follows at half speed, so scan meets it if l is circular */
+      if ((nedges & 1) == 0)
+        slow = slow->cdr;
+      if (scan->cdr == slow)
+        RUNTIME_ERROR(error_bad_value, "circular edge list");
+    }
+
+  struct csrgraph *g = NULL;
+  struct string *offsets = NULL, *targets = NULL, *weights = NULL;
+  GCPRO(l, g, offsets, targets, weights);
+  offsets = alloc_empty_string((nnodes + 1) * sizeof (uint32_t));
+  targets = alloc_empty_string(nedges * sizeof (uint32_t));
+  weights = alloc_empty_string(nedges * sizeof (uint32_t));
+  g = (struct csrgraph *)alloc_private(PRIVATE_CSRGRAPH, 5);
+  UNGCPRO();
+  g->nodes = makeint(nnodes);
+  g->edges = makeint(nedges);
+  g->offsets = offsets;
+  g->targets = targets;
+  g->weights = weights;
+
+  /* count out-degrees, then turn them into start offsets */
+  uint32_t *offs = u32(offsets);
+  memset(offs, 0, (nnodes + 1) * sizeof (uint32_t));
+  for (struct list *scan = l; scan; scan = scan->cdr)
+    {
+      struct vector *e = scan->car;
+      ++offs[intval(e->data[0]) + 1];
+    }
+  for (long v = 0; v < nnodes; ++v)
+    offs[v + 1] += offs[v];
+  for (struct list *scan = l; scan; scan = scan->cdr)
+    {
+      struct vector *e = scan->car;
+      uint32_t pos = offs[intval(e->data[0])]++;
+      u32(targets)[pos] = intval(e->data[1]);
+      u32(weights)[pos] = vector_len(e) == 3 ? intval(e->data[2]) : 1;
+    }
+  memmove(offs + 1, offs, nnodes * sizeof (uint32_t));
+  offs[0] = 0;
+
+  return g;
+}
+
+TYPEDOP(csr_graphp, "csr_graph?", "`x -> `b. True if `x is a CSR graph.",
+        (value x), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "x.n")
+{
+  return makebool(is_csrgraph(x));
+}
+
+TYPEDOP(csr_graph_nodes, ,
+        "`g -> `n. Returns the number of nodes in CSR graph `g.",
+        (struct csrgraph *g), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "o.n")
+{
+  CHECK_TYPES(g, CT_CSRGRAPH);
+  return g->nodes;
+}
+
+TYPEDOP(csr_graph_edges, ,
+        "`g -> `n. Returns the number of edges in CSR graph `g.",
+        (struct csrgraph *g), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "o.n")
+{
+  CHECK_TYPES(g, CT_CSRGRAPH);
+  return g->edges;
+}
+
+TYPEDOP(csr_graph_neighbours, ,
+        "`g `n -> `l. Returns a list of (`to . `weight) for the edges"
+        " from node `n in CSR graph `g.",
+        (struct csrgraph *g, value n), OP_LEAF | OP_NOESCAPE, "on.l")
+{
+  long v;
+  CHECK_TYPES(g, CT_CSRGRAPH,
+              n, CT_NODE(v, g));
+  struct list *l = NULL;
+  GCPRO(g, l);
+  for (uint32_t i = u32(g->offsets)[v + 1]; i-- > u32(g->offsets)[v]; )
+    {
+      struct list *e = alloc_list(makeint(u32(g->targets)[i]),
+                                  makeint(u32(g->weights)[i]));
+      l = alloc_list(e, l);
+    }
+  UNGCPRO();
+  return l;
+}
+
+TYPEDOP(csr_graph_bfs, ,
+        "`g `n -> `v. Returns a vector of the number of edges on the"
+        " shortest path from node `n to each node of CSR graph `g, or"
+        " null for nodes that cannot be reached.",
+        (struct csrgraph *g, value n), OP_LEAF | OP_NOESCAPE, "on.v")
+{
+  long src;
+  CHECK_TYPES(g, CT_CSRGRAPH,
+              n, CT_NODE(src, g));
+  long nnodes = intval(g->nodes);
+  struct vector *dist = NULL;
+  struct string *queue;
+  GCPRO(g, dist);
+  dist = alloc_vector(nnodes);
+  queue = alloc_scratch(nnodes * sizeof (uint32_t));
+  UNGCPRO();
+
+  const uint32_t *offs = u32(g->offsets), *targets = u32(g->targets);
+  uint32_t *q = u32(queue);
+  long head = 0, tail = 0;
+  dist->data[src] = makeint(0);
+  q[tail++] = src;
+  while (head < tail)
+    {
+      uint32_t u = q[head++];
+      value d = makeint(intval(dist->data[u]) + 1);
+      for (uint32_t i = offs[u]; i < offs[u + 1]; ++i)
+        {
+          uint32_t v = targets[i];
+          if (dist->data[v] == NULL)
+            {
+              dist->data[v] = d;
+              q[tail++] = v;
+            }
+        }
+    }
+  return dist;
+}
+
+/* state for Dijkstra's algorithm and A*, kept in a scratch string */
+struct search {
+  struct csrgraph *g;
+  struct string *scratch;
+  value heuristic;
+  long nnodes, used;
+  /* pointers into scratch; refreshed by search_load() */
+  int64_t *dist, *key, *hcache;
+  uint32_t *heap, *pos, *parent;
+};
+
+#define SEARCH_BYTES_PER_NODE (3 * sizeof (int64_t) + 3 * sizeof (uint32_t))
+
+static void search_load(struct search *s)
+{
+  char *p = s->scratch->str;
+  long n = s->nnodes;
+  s->dist   = (int64_t *)p;
+  s->key    = s->dist + n;
+  s->hcache = s->key + n;
+  s->heap   = (uint32_t *)(s->hcache + n);
+  s->pos    = s->heap + n;
+  s->parent = s->pos + n;
+}
+
+static bool search_less(struct search *s, uint32_t a, uint32_t b)
+{
+  return s->key[a] < s->key[b];
+}
+
+static void search_place(struct search *s, long i, uint32_t v)
+{
+  s->heap[i] = v;
+  s->pos[v] = i;
+}
+
+static void search_sift_up(struct search *s, long i)
+{
+  uint32_t v = s->heap[i];
+  while (i > 0)
+    {
+      long parent = (i - 1) / 2;
+      if (!search_less(s, v, s->heap[parent]))
+        break;
+      search_place(s, i, s->heap[parent]);
+      i = parent;
+    }
+  search_place(s, i, v);
+}
+
+static uint32_t search_pop(struct search *s)
+{
+  uint32_t top = s->heap[0];
+  s->pos[top] = NO_NODE;
+  uint32_t v = s->heap[--s->used];
+  long i = 0;
+  if (s->used == 0)
+    return top;
+  for (;;)
+    {
+      long c = 2 * i + 1;
+      if (c >= s->used)
+        break;
+      if (c + 1 < s->used && search_less(s, s->heap[c + 1], s->heap[c]))
+        ++c;
+      if (!search_less(s, s->heap[c], v))
+        break;
+      search_place(s, i, s->heap[c]);
+      i = c;
+    }
+  search_place(s, i, v);
+  return top;
+}
+
+/* returns the heuristic estimate for node v; may GC */
+static int64_t search_estimate(struct search *s, uint32_t v)
+{
+  if (s->heuristic == NULL)
+    return 0;
+  if (s->hcache[v] >= 0)
+    return s->hcache[v];
+
+  value h;
+  if (TYPE(s->heuristic, vector))
+    h = ((struct vector *)s->heuristic)->data[v];
+  else
+    {
+      h = call1(s->heuristic, makeint(v));
+      search_load(s);
+    }
+  if (!integerp(h) || intval(h) < 0)
+    runtime_error_message(error_bad_value,
+                          "heuristic must be a non-negative integer");
+  return s->hcache[v] = intval(h);
+}
+
+/* returns path length d as an integer; errors if it is too large */
+static value dist_value(int64_t d)
+{
+  if (d > MAX_TAGGED_INT)
+    runtime_error_message(error_bad_value, "path length too large");
+  return makeint(d);
+}
+
+/* set up s for a search of g from src; may GC; s->g, s->scratch and
+   s->heuristic must be protected by the caller */
+static void search_start(struct search *s, long src)
+{
+  s->nnodes = intval(s->g->nodes);
+  s->scratch = alloc_scratch(s->nnodes * SEARCH_BYTES_PER_NODE);
+  search_load(s);
+  for (long v = 0; v < s->nnodes; ++v)
+    {
+      s->dist[v] = INF_DIST;
+      s->hcache[v] = -1;
+      s->pos[v] = s->parent[v] = NO_NODE;
+    }
+  s->dist[src] = 0;
+  /* search_estimate() may GC and move s->key */
+  int64_t h = search_estimate(s, src);
+  s->key[src] = h;
+  s->used = 0;
+  search_place(s, s->used++, src);
+}
+
+/* run the search until dst (or, if dst < 0, every reachable node) has
+   its final distance; may GC */
+static void search_run(struct search *s, long dst)
+{
+  while (s->used > 0)
+    {
+      uint32_t u = search_pop(s);
+      if (u == dst)
+        return;
+      int64_t du = s->dist[u];
+      for (uint32_t i = u32(s->g->offsets)[u];
+           i < u32(s->g->offsets)[u + 1];
+           ++i)
+        {
+          uint32_t v = u32(s->g->targets)[i];
+          int64_t dv = du + u32(s->g->weights)[i];
+          if (dv >= s->dist[v])
+            continue;
+          int64_t h = search_estimate(s, v);
+          s->dist[v] = dv;
+          s->parent[v] = u;
+          s->key[v] = dv + h;
+          /* nodes are queued again if a shorter path is found, which
+             only happens with inconsistent heuristics */
+          if (s->pos[v] == NO_NODE)
+            search_place(s, s->used++, v);
+          search_sift_up(s, s->pos[v]);
+        }
+    }
+}
+
+TYPEDOP(csr_graph_dijkstra, ,
+        "`g `n -> `v. Returns a vector of the length of the shortest path"
+        " from node `n to each node of CSR graph `g, or null for nodes"
+        " that cannot be reached.",
+        (struct csrgraph *g, value n), OP_LEAF | OP_NOESCAPE, "on.v")
+{
+  long src;
+  CHECK_TYPES(g, CT_CSRGRAPH,
+              n, CT_NODE(src, g));
+  struct search s = { .g = g };
+  struct vector *dist = NULL;
+  GCPRO(s.g, s.scratch, dist);
+  dist = alloc_vector(intval(g->nodes));
+  search_start(&s, src);
+  UNGCPRO();
+  search_run(&s, -1);
+  for (long v = 0; v < s.nnodes; ++v)
+    if (s.dist[v] != INF_DIST)
+      dist->data[v] = dist_value(s.dist[v]);
+  return dist;
+}
+
+TYPEDOP(csr_graph_shortest_path, ,
+        "`g `n0 `n1 `h -> `x. Returns (`length . `l) for the shortest path"
+        " from node `n0 to node `n1 in CSR graph `g, where `l is the list"
+        " of nodes on the path, or false if there is none.\n"
+        "Uses A* search if `h is a vector of estimates or a function `h(`n)"
+        " estimating the remaining length from node `n. Estimates must be"
+        " non-negative and must not exceed the actual remaining length."
+        " If `h is null, uses Dijkstra's algorithm.",
+        (struct csrgraph *g, value n0, value n1, value h), OP_NOESCAPE,
+        "onn[vfu].[kz]")
+{
+  long src, dst;
+  CHECK_TYPES(g,  CT_CSRGRAPH,
+              n0, CT_NODE(src, g),
+              n1, CT_NODE(dst, g),
+              h,  CT_HEURISTIC(g));
+  struct search s = { .g = g, .heuristic = h };
+  struct list *path = NULL;
+  GCPRO(s.g, s.scratch, s.heuristic, path);
+  search_start(&s, src);
+  search_run(&s, dst);
+
+  if (s.dist[dst] == INF_DIST)
+    {
+      UNGCPRO();
+      return makebool(false);
+    }
+  value length = dist_value(s.dist[dst]);
+  for (uint32_t v = dst; v != NO_NODE; )
+    {
+      path = alloc_list(makeint(v), path);
+      search_load(&s);
+      v = v == src ? NO_NODE : s.parent[v];
+    }
+  path = alloc_list(length, path);
+  UNGCPRO();
+  return path;
+}
+
+static uint32_t uf_find(uint32_t *parent, uint32_t v)
+{
+  while (parent[v] != v)
+    v = parent[v] = parent[parent[v]];
+  return v;
+}
+
+TYPEDOP(csr_graph_components, ,
+        "`g -> `v. Returns a vector with the (weakly) connected component"
+        " of each node of CSR graph `g, numbered from 0 in order of their"
+        " lowest node.",
+        (struct csrgraph *g), OP_LEAF | OP_NOESCAPE, "o.v")
+{
+  CHECK_TYPES(g, CT_CSRGRAPH);
+  long nnodes = intval(g->nodes);
+  struct vector *comp = NULL;
+  struct string *scratch;
+  GCPRO(g, comp);
+  comp = alloc_vector(nnodes);
+  scratch = alloc_scratch(2 * nnodes * sizeof (uint32_t));
+  UNGCPRO();
+
+  uint32_t *parent = u32(scratch), *label = parent + nnodes;
+  const uint32_t *offs = u32(g->offsets), *targets = u32(g->targets);
+  for (long v = 0; v < nnodes; ++v)
+    {
+      parent[v] = v;
+      label[v] = NO_NODE;
+    }
+  for (long u = 0; u < nnodes; ++u)
+    for (uint32_t i = offs[u]; i < offs[u + 1]; ++i)
+      {
+        uint32_t a = uf_find(parent, u), b = uf_find(parent, targets[i]);
+        /* keep the lowest node as the root */
+        if (a < b)
+          parent[b] = a;
+        else if (b < a)
+          parent[a] = b;
+      }
+
+  long ncomps = 0;
+  for (long v = 0; v < nnodes; ++v)
+    {
+      uint32_t r = uf_find(parent, v);
+      if (label[r] == NO_NODE)
+        label[r] = ncomps++;
+      comp->data[v] = makeint(label[r]);
+    }
+  return comp;
+}
+
+void csrgraph_init(void)
+{
+  DEFINE(make_csr_graph);
+  DEFINE(csr_graphp);
+  DEFINE(csr_graph_nodes);
+  DEFINE(csr_graph_edges);
+  DEFINE(csr_graph_neighbours);
+  DEFINE(csr_graph_bfs);
+  DEFINE(csr_graph_dijkstra);
+  DEFINE(csr_graph_shortest_path);
+  DEFINE(csr_graph_components);
+}
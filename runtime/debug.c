@@ -417,6 +417,13 @@ TYPEDOP(gc_generation, , "-> `n. Returns the number of garbage collections"
   return makeint(gcstats.minor_count + gcstats.major_count);
 }
 
+TYPEDOP(gc_allocated, , "-> `n. Returns the number of bytes allocated so"
+        " far. Only use the difference between two calls.",
+	(void), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, ".n")
+{
+  return makeint(gc_allocated_bytes());
+}
+
 TYPEDOP(gc_cmp, , "`x0 `x1 -> `n. Compares `x0 and `x1 as == does, and"
         " returns -1 if `x0 is less than `x1, 0 if they are equal, or 1 if `x0"
 	" is greater than `x1. The results are only stable within"
@@ -468,6 +475,7 @@ void debug_init(void)
   DEFINE(reset_gcstats);
 #endif  /* GCSTATS */
   DEFINE(gc_generation);
+  DEFINE(gc_allocated);
   DEFINE(gc_cmp);
   DEFINE(gc_hash);
 }
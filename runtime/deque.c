@@ -0,0 +1,588 @@
+/*
+ * Copyright (c) 1993-2012 David Gay and Gustav Hllberg
+ * All rights reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose, without fee, and without written agreement is hereby granted,
+ * provided that the above copyright notice and the following two paragraphs
+ * appear in all copies of this software.
+ *
+ * IN NO EVENT SHALL DAVID GAY OR GUSTAV HALLBERG BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES ARISING OUT
+ * OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF DAVID GAY OR
+ * GUSTAV HALLBERG HAVE BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * DAVID GAY AND GUSTAV HALLBERG SPECIFICALLY DISCLAIM ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN
+ * "AS IS" BASIS, AND DAVID GAY AND GUSTAV HALLBERG HAVE NO OBLIGATION TO
+ * PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ */
+
+
+#include <string.h>
+
+#include "check-types.h"
+#include "deque.h"
+#include "prims.h"
+
+#include "../alloc.h"
+
+/* Deques stored in ring buffers, and native versions of the dlist.mud
+   operations on doubly-linked, circular lists of [contents next prev]
+   cells. */
+
+#define DEQUE_MIN_SIZE 8
+
+struct deque {
+  struct mprivate p;
+  value head;                   /* makeint(index of the first element) */
+  value used;                   /* makeint(number of elements) */
+  struct vector *data;          /* length is a power of two */
+};
+
+#ifdef LOCAL_MUDLLE_TYPES
+#undef LOCAL_MUDLLE_TYPES
+#define LOCAL_MUDLLE_TYPES struct deque *: true,
+#endif
+
+static bool is_deque(value _q)
+{
+  struct deque *q = _q;
+  return (TYPE(q, private)
+          && q->p.ptype == makeint(PRIVATE_DEQUE));
+}
+
+static enum runtime_error ct_deque(value v, const char **errmsg, bool write)
+{
+  if (!is_deque(v))
+    {
+      *errmsg = "expected deque";
+      return error_bad_type;
+    }
+  if (write && readonlyp(v))
+    return error_value_read_only;
+  return error_none;
+}
+
+static enum runtime_error ct_deque_index(long idx, const char **errmsg,
+                                         struct deque *q, long *dst)
+{
+  long used = intval(q->used);
+  if (idx < 0)
+    idx += used;
+  if (idx < 0 || idx >= used)
+    {
+      *errmsg = "deque index out of range";
+      return error_bad_index;
+    }
+  *dst = idx;
+  return error_none;
+}
+
+#define CT_DEQUE(write) F(TSET(private), ct_deque, write)
+#define __CT_DEQUE_IDX_E(v, msg, dst_q)                                 \
+  ct_deque_index(v, msg, ARGN2 dst_q, &(ARGN1 dst_q))
+#define CT_DEQUE_IDX(dst, q) CT_INT_P((dst, q), __CT_DEQUE_IDX_E)
+
+static value *deque_slot(struct deque *q, long idx)
+{
+  long mask = vector_len(q->data) - 1;
+  return &q->data->data[(intval(q->head) + idx) & mask];
+}
+
+/* make room for one more element; may GC */
+static struct deque *deque_reserve(struct deque *q)
+{
+  long used = intval(q->used), size = vector_len(q->data);
+  if (used < size)
+    return q;
+  GCPRO(q);
+  struct vector *data = alloc_vector(2 * size);
+  UNGCPRO();
+  for (long i = 0; i < used; ++i)
+    data->data[i] = *deque_slot(q, i);
+  q->data = data;
+  q->head = makeint(0);
+  return q;
+}
+
+static void deque_empty_check(struct deque *q)
+{
+  if (q->used == makeint(0))
+    runtime_error_message(error_bad_value, "deque is empty");
+}
+
+static struct list *deque_list(struct deque *q)
+{
+  struct list *l = NULL;
+  GCPRO(q, l);
+  for (long i = intval(q->used); i-- > 0; )
+    l = alloc_list(*deque_slot(q, i), l);
+  UNGCPRO();
+  return l;
+}
+
+TYPEDOP(make_deque, ,
+        "-> `q. Returns a new, empty deque.",
+        (void), OP_LEAF | OP_NOESCAPE, ".o")
+{
+  struct deque *q = (struct deque *)alloc_private(PRIVATE_DEQUE, 3);
+  q->head = q->used = makeint(0);
+  GCPRO(q);
+  struct vector *data = alloc_vector(DEQUE_MIN_SIZE);
+  UNGCPRO();
+  q->data = data;
+  return q;
+}
+
+TYPEDOP(dequep, "deque?", "`x -> `b. True if `x is a deque.",
+        (value x), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "x.n")
+{
+  return makebool(is_deque(x));
+}
+
+TYPEDOP(deque_length, ,
+        "`q -> `n. Returns the number of elements in deque `q.",
+        (struct deque *q), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "o.n")
+{
+  CHECK_TYPES(q, CT_DEQUE(false));
+  return q->used;
+}
+
+TYPEDOP(deque_push_front, "deque_push_front!",
+        "`q `x -> `x. Adds `x to the front of deque `q.",
+        (struct deque *q, value x), OP_LEAF | OP_NOESCAPE, "ox.2")
+{
+  CHECK_TYPES(q, CT_DEQUE(true),
+              x, any);
+  GCPRO(x);
+  q = deque_reserve(q);
+  UNGCPRO();
+  long mask = vector_len(q->data) - 1;
+  q->head = makeint((intval(q->head) - 1) & mask);
+  q->used = makeint(intval(q->used) + 1);
+  *deque_slot(q, 0) = x;
+  return x;
+}
+
+TYPEDOP(deque_push_back, "deque_push_back!",
+        "`q `x -> `x. Adds `x to the back of deque `q.",
+        (struct deque *q, value x), OP_LEAF | OP_NOESCAPE, "ox.2")
+{
+  CHECK_TYPES(q, CT_DEQUE(true),
+              x, any);
+  GCPRO(x);
+  q = deque_reserve(q);
+  UNGCPRO();
+  long used = intval(q->used);
+  q->used = makeint(used + 1);
+  *deque_slot(q, used) = x;
+  return x;
+}
+
+TYPEDOP(deque_pop_front, "deque_pop_front!",
+        "`q -> `x. Removes and returns the first element of deque `q.",
+        (struct deque *q), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "o.x")
+{
+  CHECK_TYPES(q, CT_DEQUE(true));
+  deque_empty_check(q);
+  value *slot = deque_slot(q, 0);
+  value x = *slot;
+  *slot = NULL;
+  long mask = vector_len(q->data) - 1;
+  q->head = makeint((intval(q->head) + 1) & mask);
+  q->used = makeint(intval(q->used) - 1);
+  return x;
+}
+
+TYPEDOP(deque_pop_back, "deque_pop_back!",
+        "`q -> `x. Removes and returns the last element of deque `q.",
+        (struct deque *q), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "o.x")
+{
+  CHECK_TYPES(q, CT_DEQUE(true));
+  deque_empty_check(q);
+  long used = intval(q->used) - 1;
+  value *slot = deque_slot(q, used);
+  value x = *slot;
+  *slot = NULL;
+  q->used = makeint(used);
+  return x;
+}
+
+TYPEDOP(deque_front, ,
+        "`q -> `x. Returns the first element of deque `q.",
+        (struct deque *q), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "o.x")
+{
+  CHECK_TYPES(q, CT_DEQUE(false));
+  deque_empty_check(q);
+  return *deque_slot(q, 0);
+}
+
+TYPEDOP(deque_back, ,
+        "`q -> `x. Returns the last element of deque `q.",
+        (struct deque *q), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "o.x")
+{
+  CHECK_TYPES(q, CT_DEQUE(false));
+  deque_empty_check(q);
+  return *deque_slot(q, intval(q->used) - 1);
+}
+
+TYPEDOP(deque_ref, ,
+        "`q `n -> `x. Returns the `n'th element of deque `q.\n"
+        "Negative `n are counted from the back of `q.",
+        (struct deque *q, value n), OP_LEAF | OP_NOALLOC | OP_NOESCAPE,
+        "on.x")
+{
+  long idx;
+  CHECK_TYPES(q, CT_DEQUE(false),
+              n, CT_DEQUE_IDX(idx, q));
+  return *deque_slot(q, idx);
+}
+
+TYPEDOP(deque_set, "deque_set!",
+        "`q `n `x -> `x. Sets the `n'th element of deque `q to `x.\n"
+        "Negative `n are counted from the back of `q.",
+        (struct deque *q, value n, value x),
+        OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "onx.3")
+{
+  long idx;
+  CHECK_TYPES(q, CT_DEQUE(true),
+              n, CT_DEQUE_IDX(idx, q),
+              x, any);
+  *deque_slot(q, idx) = x;
+  return x;
+}
+
+TYPEDOP(deque_remove, "deque_remove!",
+        "`q `n -> `x. Removes and returns the `n'th element of deque `q,"
+        " moving the elements on the shorter side of it.\n"
+        "Negative `n are counted from the back of `q.",
+        (struct deque *q, value n), OP_LEAF | OP_NOALLOC | OP_NOESCAPE,
+        "on.x")
+{
+  long idx;
+  CHECK_TYPES(q, CT_DEQUE(true),
+              n, CT_DEQUE_IDX(idx, q));
+  long used = intval(q->used);
+  value x = *deque_slot(q, idx);
+  if (idx < used / 2)
+    {
+      for (long i = idx; i > 0; --i)
+        *deque_slot(q, i) = *deque_slot(q, i - 1);
+      *deque_slot(q, 0) = NULL;
+      long mask = vector_len(q->data) - 1;
+      q->head = makeint((intval(q->head) + 1) & mask);
+    }
+  else
+    {
+      for (long i = idx; i < used - 1; ++i)
+        *deque_slot(q, i) = *deque_slot(q, i + 1);
+      *deque_slot(q, used - 1) = NULL;
+    }
+  q->used = makeint(used - 1);
+  return x;
+}
+
+TYPEDOP(deque_empty, "deque_empty!",
+        "`q -> . Removes all elements from deque `q.",
+        (struct deque *q), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "o.")
+{
+  CHECK_TYPES(q, CT_DEQUE(true));
+  memset(q->data->data, 0, vector_len(q->data) * sizeof (value));
+  q->head = q->used = makeint(0);
+  undefined();
+}
+
+TYPEDOP(deque_to_list, ,
+        "`q -> `l. Returns a list of the elements of deque `q, from front"
+        " to back.",
+        (struct deque *q), OP_LEAF | OP_NOESCAPE, "o.l")
+{
+  CHECK_TYPES(q, CT_DEQUE(false));
+  return deque_list(q);
+}
+
+TYPEDOP(list_to_deque, ,
+        "`l -> `q. Returns a new deque with the elements of list `l.",
+        (struct list *l), OP_LEAF | OP_NOESCAPE, "l.o")
+{
+  CHECK_TYPES(l, CT_TYPES(null, pair));
+  long n = 0;
+  for (struct list *scan = l; TYPE(scan, pair); scan = scan->cdr)
+    ++n;
+  long size = DEQUE_MIN_SIZE;
+  while (size < n)
+    size *= 2;
+
+  struct deque *q;
+  struct vector *data = NULL;
+  GCPRO(l, data);
+  data = alloc_vector(size);
+  q = (struct deque *)alloc_private(PRIVATE_DEQUE, 3);
+  UNGCPRO();
+  n = 0;
+  for (; TYPE(l, pair); l = l->cdr)
+    data->data[n++] = l->car;
+  q->head = makeint(0);
+  q->used = makeint(n);
+  q->data = data;
+  return q;
+}
+
+/* dlist cells */
+
+enum {
+  DCELL_CONTENTS,
+  DCELL_NEXT,
+  DCELL_PREV,
+  DCELL_LEN
+};
+
+static bool is_dcell(value v)
+{
+  return TYPE(v, vector) && vector_len((struct vector *)v) == DCELL_LEN;
+}
+
+static enum runtime_error ct_dcell(value v, const char **errmsg, bool write)
+{
+  if (!is_dcell(v))
+    {
+      *errmsg = "expected dlist cell";
+      return error_bad_value;
+    }
+  if (write && readonlyp(v))
+    return error_value_read_only;
+  return error_none;
+}
+
+#define CT_DCELL(write) F(TSET(vector), ct_dcell, write)
+#define CT_DLIST(write) OR(null, CT_DCELL(write))
+
+static struct vector *dnext(struct vector *d)
+{
+  return d->data[DCELL_NEXT];
+}
+
+static struct vector *dprev(struct vector *d)
+{
+  return d->data[DCELL_PREV];
+}
+
+/* returns the number of cells in dlist d; raises an error if d is not a
+   well-formed circular list */
+static long dlist_length(struct vector *d)
+{
+  if (d == NULL)
+    return 0;
+  long n = 1;
+  /* slow trails at half speed to detect cycles that miss d */
+  struct vector *slow = d;
+  for (struct vector *scan = dnext(d); scan != d; scan = dnext(scan))
+    {
+      if (!is_dcell(scan) || scan == slow)
+        runtime_error_message(error_bad_value, "malformed dlist");
+      if (++n % 2 == 0)
+        slow = dnext(slow);
+    }
+  return n;
+}
+
+static void dunlink(struct vector *d)
+{
+  struct vector *next = dnext(d), *prev = dprev(d);
+  next->data[DCELL_PREV] = prev;
+  prev->data[DCELL_NEXT] = next;
+}
+
+TYPEDOP(dcell_cons, "dcell_cons!",
+        "`x `d1 -> `d2. Inserts `x in front of dlist `d1 and returns the"
+        " new cell `d2. Native version of `dcons!().",
+        (value x, struct vector *d), OP_LEAF | OP_NOESCAPE, "x[vu].v")
+{
+  CHECK_TYPES(x, any,
+              d, CT_DLIST(true));
+  if (d != NULL && (!is_dcell(dprev(d)) || readonlyp(dprev(d))))
+    RUNTIME_ERROR(error_bad_value, "malformed dlist");
+  GCPRO(x, d);
+  struct vector *new = alloc_vector(DCELL_LEN);
+  UNGCPRO();
+  new->data[DCELL_CONTENTS] = x;
+  if (d == NULL)
+    new->data[DCELL_NEXT] = new->data[DCELL_PREV] = new;
+  else
+    {
+      struct vector *prev = dprev(d);
+      new->data[DCELL_NEXT] = d;
+      new->data[DCELL_PREV] = prev;
+      prev->data[DCELL_NEXT] = new;
+      d->data[DCELL_PREV] = new;
+    }
+  return new;
+}
+
+TYPEDOP(dcell_remove, "dcell_remove!",
+        "`d1 `d2 -> `d3. Removes `d1 from dlist with head `d2. Returns the"
+        " new head `d3. Native version of `dremove!().",
+        (struct vector *del, struct vector *head),
+        OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "vv.[vu]")
+{
+  CHECK_TYPES(del,  CT_DCELL(true),
+              head, CT_DCELL(false));
+  struct vector *next = dnext(del);
+  if (del == head && next == head)
+    return NULL;
+  if (!is_dcell(next) || !is_dcell(dprev(del))
+      || readonlyp(next) || readonlyp(dprev(del)))
+    RUNTIME_ERROR(error_bad_value, "malformed dlist");
+  dunlink(del);
+  return del == head ? next : head;
+}
+
+TYPEDOP(dcell_merge, "dcell_merge!",
+        "`d1 `d2 -> `d3. Dlist `d1 is inserted in front of dlist `d2."
+        " Returns the dlist starting at `d1. Native version of"
+        " `dmerge!().",
+        (struct vector *d1, struct vector *d2),
+        OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "[vu][vu].[vu]")
+{
+  CHECK_TYPES(d1, CT_DLIST(true),
+              d2, CT_DLIST(true));
+  if (d1 == NULL)
+    return d2;
+  if (d2 == NULL)
+    return d1;
+  struct vector *last1 = dprev(d1), *last2 = dprev(d2);
+  if (!is_dcell(last1) || !is_dcell(last2)
+      || readonlyp(last1) || readonlyp(last2))
+    RUNTIME_ERROR(error_bad_value, "malformed dlist");
+  last1->data[DCELL_NEXT] = d2;
+  d2->data[DCELL_PREV] = last1;
+  last2->data[DCELL_NEXT] = d1;
+  d1->data[DCELL_PREV] = last2;
+  return d1;
+}
+
+TYPEDOP(dcell_next, ,
+        "`d1 -> `d2. Returns the cell after `d1. Native version of"
+        " `dnext().",
+        (struct vector *d), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "v.v")
+{
+  CHECK_TYPES(d, CT_DCELL(false));
+  return dnext(d);
+}
+
+TYPEDOP(dcell_snext, ,
+        "`d1 `d2 -> `d3. Returns the cell after `d1, or null if at the end"
+        " of dlist `d2. Native version of `dsnext().",
+        (struct vector *d1, struct vector *d2),
+        OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "vv.[vu]")
+{
+  CHECK_TYPES(d1, CT_DCELL(false),
+              d2, CT_DCELL(false));
+  struct vector *next = dnext(d1);
+  return next == d2 ? NULL : next;
+}
+
+TYPEDOP(dcell_prev, ,
+        "`d1 -> `d2. Returns the cell before `d1. Native version of"
+        " `dprev().",
+        (struct vector *d), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "v.v")
+{
+  CHECK_TYPES(d, CT_DCELL(false));
+  return dprev(d);
+}
+
+TYPEDOP(dcell_sprev, ,
+        "`d1 `d2 -> `d3. Returns the cell before `d1, or null if at the"
+        " start of dlist `d2. Native version of `dsprev().",
+        (struct vector *d1, struct vector *d2),
+        OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "vv.[vu]")
+{
+  CHECK_TYPES(d1, CT_DCELL(false),
+              d2, CT_DCELL(false));
+  struct vector *prev = dprev(d1);
+  return prev == d2 ? NULL : prev;
+}
+
+TYPEDOP(dcell_get, ,
+        "`d -> `x. Returns the contents of cell `d. Native version of"
+        " `dget().",
+        (struct vector *d), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "v.x")
+{
+  CHECK_TYPES(d, CT_DCELL(false));
+  return d->data[DCELL_CONTENTS];
+}
+
+TYPEDOP(dcell_set, "dcell_set!",
+        "`d `x -> `x. Sets the contents of cell `d to `x. Native version"
+        " of `dset!().",
+        (struct vector *d, value x), OP_LEAF | OP_NOALLOC | OP_NOESCAPE,
+        "vx.2")
+{
+  CHECK_TYPES(d, CT_DCELL(true),
+              x, any);
+  d->data[DCELL_CONTENTS] = x;
+  return x;
+}
+
+TYPEDOP(dcell_length, ,
+        "`d -> `n. Returns the number of elements in dlist `d. Native"
+        " version of `dlength().",
+        (struct vector *d), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "[vu].n")
+{
+  CHECK_TYPES(d, CT_DLIST(false));
+  return makeint(dlist_length(d));
+}
+
+TYPEDOP(dcell_list, ,
+        "`d -> `l. Returns a list of the contents of dlist `d. Native"
+        " version of `dlist_to_list().",
+        (struct vector *d), OP_LEAF | OP_NOESCAPE, "[vu].l")
+{
+  CHECK_TYPES(d, CT_DLIST(false));
+  long n = dlist_length(d);
+  struct list *l = NULL;
+  struct vector *scan = d;
+  GCPRO(l, scan);
+  while (n-- > 0)
+    {
+      scan = dprev(scan);
+      if (!is_dcell(scan))
+        runtime_error_message(error_bad_value, "malformed dlist");
+      l = alloc_list(scan->data[DCELL_CONTENTS], l);
+    }
+  UNGCPRO();
+  return l;
+}
+
+void deque_init(void)
+{
+  DEFINE(make_deque);
+  DEFINE(dequep);
+  DEFINE(deque_length);
+  DEFINE(deque_push_front);
+  DEFINE(deque_push_back);
+  DEFINE(deque_pop_front);
+  DEFINE(deque_pop_back);
+  DEFINE(deque_front);
+  DEFINE(deque_back);
+  DEFINE(deque_ref);
+  DEFINE(deque_set);
+  DEFINE(deque_remove);
+  DEFINE(deque_empty);
+  DEFINE(deque_to_list);
+  DEFINE(list_to_deque);
+
+  DEFINE(dcell_cons);
+  DEFINE(dcell_remove);
+  DEFINE(dcell_merge);
+  DEFINE(dcell_next);
+  DEFINE(dcell_snext);
+  DEFINE(dcell_prev);
+  DEFINE(dcell_sprev);
+  DEFINE(dcell_get);
+  DEFINE(dcell_set);
+  DEFINE(dcell_length);
+  DEFINE(dcell_list);
+}
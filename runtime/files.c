@@ -28,6 +28,7 @@
 #include <grp.h>
 #include <limits.h>
 #include <pwd.h>
+#include <signal.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -39,11 +40,18 @@
  #include <fstab.h>
 #endif
 
+#ifdef HAVE_EPOLL
+#  include <sys/epoll.h>
+#endif
+#include <sys/mman.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/statvfs.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 
+#include "../bcache.h"
 #include "../call.h"
 #include "../compile.h"
 #include "../context.h"
@@ -59,6 +67,7 @@
 #include "files.h"
 #include "io.h"
 #include "mudlle-float.h"
+#include "mudlle-string.h"
 #include "prims.h"
 
 #ifdef ARG_MAX
@@ -75,6 +84,27 @@ TYPEDOP(load, , "`s -> `b. Loads file `s. Returns true if successful",
 }
 
 
+UNSAFEOP(load_cache_directory, "load_cache_directory!",
+         "`s -> . Makes `load() keep the compiled code of the files it"
+         " loads in directory `s instead of next to each file (in the file"
+         " name with a \"c\" appended). If `s is null, restores the"
+         " default.",
+         (struct string *dir), OP_LEAF | OP_NOESCAPE | OP_NOALLOC
+         | OP_STR_READONLY, "[su].")
+{
+  CHECK_TYPES(dir, OR(null, string));
+  bcache_set_directory(dir ? dir->str : NULL);
+  undefined();
+}
+
+TYPEDOP(load_cache_hits, ,
+        "-> `n. Returns the number of files `load() has taken from its"
+        " cache of compiled code.",
+        (void), OP_LEAF | OP_NOESCAPE | OP_NOALLOC, ".n")
+{
+  return makeint(bcache_hits);
+}
+
 UNSAFEOP(mkdir, , "`s `n1 -> `n2. Make directory `s (mode `n1)."
          " Returns Unix errno.",
          (struct string *name, value mode),
@@ -536,6 +566,76 @@ PROC_GETINT(getuid, "real user ID", "`geteuid() and `getgid()")
 PROC_GETINT(geteuid, "effective user ID", "`getuid() and `getegid()")
 PROC_GETINT(getgid, "real group ID", "`getuid() and `getegid()")
 PROC_GETINT(getegid, "effective group ID", "`geteuid() and `getgid()")
+PROC_GETINT(getpid, "process ID", "`fork()")
+
+static void flush_output(void)
+{
+  pflush(mudout);
+  pflush(muderr);
+  fflush(NULL);
+}
+
+UNSAFEOP(fork, , "-> `n. Creates a child process, which continues with a"
+         " copy of the current mudlle state. Returns 0 in the child, the"
+         " child's process ID in the parent, or -errno on failure."
+         " Output is flushed first. See also `waitpid() and `child_exit().",
+         (void), OP_LEAF | OP_NOESCAPE, ".n")
+{
+  flush_output();
+  pid_t pid = fork();
+  return makeint(pid < 0 ? -errno : pid);
+}
+
+UNSAFEOP(waitpid, , "`n0 -> `x. Waits for child process `n0 (-1 for any"
+         " child) to exit. Returns (`pid . `n1), where `n1 is the exit"
+         " code of the child or -`signal if it was killed by a signal."
+         " Returns the Unix error number on failure.",
+         (value mpid), OP_LEAF | OP_NOESCAPE, "n.[kn]")
+{
+  pid_t pid;
+  CHECK_TYPES(mpid, CT_RANGE(pid, -1, INT_MAX));
+
+  int status;
+  pid_t r;
+  while ((r = waitpid(pid, &status, 0)) < 0)
+    if (errno != EINTR)
+      return makeint(errno);
+
+  int code = (WIFEXITED(status) ? WEXITSTATUS(status)
+              : WIFSIGNALED(status) ? -WTERMSIG(status)
+              : -1);
+  return alloc_list(makeint(r), makeint(code));
+}
+
+UNSAFEOP(kill, , "`n0 `n1 -> `n2. Sends signal `n1 (e.g., `SIGTERM) to"
+         " process `n0. Returns 0 or the Unix error number on failure.",
+         (value mpid, value msig), OP_LEAF | OP_NOESCAPE | OP_NOALLOC,
+         "nn.n")
+{
+  pid_t pid;
+  int sig;
+  CHECK_TYPES(mpid, CT_RANGE(pid, 1, INT_MAX),
+              msig, CT_RANGE(sig, 0, INT_MAX));
+  return makeint(kill(pid, sig) < 0 ? errno : 0);
+}
+
+UNSAFEOP(child_exit, , "`n -> . Flushes output and exits the process"
+         " immediately with exit code `n, without running any exit"
+         " handlers. Use this to terminate processes created by `fork().",
+         (value code), OP_LEAF | OP_NOESCAPE, "n.")
+{
+  int n;
+  CHECK_TYPES(code, CT_RANGE(n, 0, 255));
+  flush_output();
+  _exit(n);
+}
+
+TYPEDOP(processor_count, , "-> `n. Returns the number of online processors.",
+        (void), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, ".n")
+{
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return makeint(n < 1 ? 1 : n);
+}
 
 UNSAFEOP(print_file_part, ,
          "`oport `s `n0 `x -> `n1. Print `x bytes from file"
@@ -697,7 +797,7 @@ static value file_write(struct string *file, value data, bool do_append,
 
   if (!(TYPE(data, string)
         ? write_block(int_ptr(fd), data, string_len((struct string *)data))
-        : port_for_blocks(data, write_block, int_ptr(fd))))
+        : port_writev(data, fd)))
     goto got_error;
 
   close(fd);
@@ -733,6 +833,698 @@ UNSAFEOP(file_append, ,
   return file_write(file, data, true, THIS_OP);
 }
 
+UNSAFEOP(port_write_fd, ,
+         "`p `n0 -> `n1. Writes the contents of string oport `p to file"
+         " descriptor `n0, without first converting it to a string.\n"
+         "Returns a Unix error number for failure or 0 for success.\n"
+         "On failure, partial data may have been written.",
+         (value p, value mfd),
+         OP_LEAF | OP_NOESCAPE | OP_NOALLOC, "on.n")
+{
+  int fd;
+  CHECK_TYPES(p,   CT_STR_OPORT,
+              mfd, CT_RANGE(fd, 0, INT_MAX));
+  return makeint(port_writev(p, fd) ? 0 : errno);
+}
+
+/* Input ports read files incrementally, either through a buffer that
+   holds the unread data, or from a read-only mapping of the whole file. */
+struct iport {
+  struct mprivate p;
+  value fd;                     /* makeint(-1) if closed or mapped */
+  struct string *buf;           /* read buffer; NULL if mapped */
+  struct tagged_ptr map;        /* the mapping; or 1 if none */
+  value start, end;             /* unread data in buf or map */
+  value eof;                    /* true if fd has reached end-of-file */
+  value closed;
+};
+
+#ifdef LOCAL_MUDLLE_TYPES
+#undef LOCAL_MUDLLE_TYPES
+#define LOCAL_MUDLLE_TYPES                      \
+  struct evloop *: true,                        \
+  struct iport *:  true,
+#endif
+
+#define IPORT_BUFFER_SIZE 65536
+
+/* Input ports that have not been closed. There is no finalization, so
+   this keeps them reachable until iport_close() releases their file
+   descriptor or mapping. */
+static struct list *open_iports;
+
+static bool is_iport(value _ip)
+{
+  struct iport *ip = _ip;
+  return (TYPE(ip, private)
+          && ip->p.ptype == makeint(PRIVATE_IPORT));
+}
+
+static enum runtime_error ct_iport(value v, const char **errmsg, int unused)
+{
+  if (!is_iport(v))
+    {
+      *errmsg = "expected input port";
+      return error_bad_type;
+    }
+  if (istrue(((struct iport *)v)->closed))
+    {
+      *errmsg = "input port is closed";
+      return error_bad_value;
+    }
+  return error_none;
+}
+
+#define CT_IPORT F(TSET(private), ct_iport, 0)
+
+static size_t iport_capacity(struct iport *ip)
+{
+  return ip->buf->o.size - sizeof (struct obj);
+}
+
+static const char *iport_data(struct iport *ip)
+{
+  return ip->buf ? ip->buf->str : get_tagged_ptr(&ip->map);
+}
+
+static long iport_avail(struct iport *ip)
+{
+  return intval(ip->end) - intval(ip->start);
+}
+
+/* Reads more data into the buffer of ip, making room for at least want
+   unread characters. Returns false at end-of-file. Causes a runtime error
+   if the read fails or if the buffer cannot hold want characters. Can
+   cause GC. */
+static bool iport_fill(struct iport *ip, size_t want)
+{
+  if (ip->buf == NULL || istrue(ip->eof))
+    return false;
+
+  long start = intval(ip->start), end = intval(ip->end);
+  if (start > 0)
+    {
+      memmove(ip->buf->str, ip->buf->str + start, end - start);
+      end -= start;
+      ip->start = makeint(0);
+      ip->end = makeint(end);
+    }
+
+  size_t cap = iport_capacity(ip);
+  if (want > cap || end == cap)
+    {
+      if (want < 2 * cap)
+        want = 2 * cap;
+      if (want > MAX_STRING_SIZE)
+        want = MAX_STRING_SIZE;
+      if (want <= cap)
+        runtime_error_message(error_bad_value, "record too long");
+      GCPRO(ip);
+      struct string *nbuf = (struct string *)allocate_string(type_internal,
+                                                             want);
+      UNGCPRO();
+      memcpy(nbuf->str, ip->buf->str, end);
+      ip->buf = nbuf;
+      cap = want;
+    }
+
+  for (;;)
+    {
+      ssize_t n = read(intval(ip->fd), ip->buf->str + end, cap - end);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n < 0)
+        {
+          static char msg[64];
+          int err = errno;
+          snprintf(msg, sizeof msg, "read error: %s (errno %d)",
+                   strerror(err), err);
+          runtime_error_message(error_bad_value, msg);
+        }
+      if (n == 0)
+        {
+          ip->eof = makebool(true);
+          return false;
+        }
+      ip->end = makeint(end + n);
+      return true;
+    }
+}
+
+/* Returns the next n characters of ip (n <= available) as a string,
+   skipping a further skip characters. */
+static struct string *iport_take(struct iport *ip, long n, long skip)
+{
+  if (n > MAX_STRING_SIZE)
+    runtime_error_message(error_bad_value, "record too long");
+  GCPRO(ip);
+  struct string *s = alloc_empty_string(n);
+  UNGCPRO();
+  memcpy(s->str, iport_data(ip) + intval(ip->start), n);
+  ip->start = makeint(intval(ip->start) + n + skip);
+  return s;
+}
+
+UNSAFEOP(open_input_file, ,
+         "`s `b -> `p|`n. Opens file `s for reading, returning an input"
+         " port `p or a Unix errno value on error. If `b is true, the file"
+         " is mapped into memory instead of being read through a buffer."
+         " Input ports are not garbage collected until they have been"
+         " closed with `iport_close().\n"
+         "Cf. `iport_read_line(), `iport_read(), `iport_read_record(),"
+         " `open_iports().",
+         (struct string *name, value mmapped),
+         OP_LEAF | OP_NOESCAPE | OP_STR_READONLY | OP_NUL_STR, "sx.[on]")
+{
+  CHECK_TYPES(name,    string,
+              mmapped, any);
+
+  int fd = open(name->str, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return makeint(errno);
+
+  void *map = NULL;
+  off_t size = 0;
+  if (istrue(mmapped))
+    {
+      struct stat st;
+      if (fstat(fd, &st) < 0)
+        goto got_error;
+      size = st.st_size;
+      if (size > 0)
+        {
+          map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+          if (map == MAP_FAILED)
+            goto got_error;
+          madvise(map, size, MADV_SEQUENTIAL);
+        }
+      close(fd);
+      fd = -1;
+    }
+
+  struct iport *ip = (struct iport *)alloc_private(
+    PRIVATE_IPORT, grecord_fields(*ip) - grecord_fields(struct mprivate));
+  ip->fd = makeint(fd);
+  ip->start = makeint(0);
+  ip->end = makeint(size);
+  ip->eof = ip->closed = makebool(false);
+  if (map != NULL)
+    set_tagged_ptr(&ip->map, map);
+  else
+    ip->map.v = makeint(0);
+  GCPRO(ip);
+  if (fd >= 0)
+    {
+      struct string *buf = (struct string *)allocate_string(
+        type_internal, IPORT_BUFFER_SIZE);
+      ip->buf = buf;
+    }
+  open_iports = alloc_list(ip, open_iports);
+  UNGCPRO();
+  return ip;
+
+ got_error: ;
+  int r = errno;
+  close(fd);
+  return makeint(r);
+}
+
+TYPEDOP(is_iport, "iport?", "`x -> `b. Returns true if `x is an input port.",
+        (value x), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "x.n")
+{
+  return makebool(is_iport(x));
+}
+
+UNSAFEOP(iport_close, ,
+         "`p -> . Closes input port `p. Does nothing if `p is already"
+         " closed.",
+         (struct iport *ip), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "o.")
+{
+  if (!is_iport(ip))
+    bad_typeset_error(ip, TSET(private));
+  if (istrue(ip->closed))
+    undefined();
+
+  if (ip->buf)
+    close(intval(ip->fd));
+  else if (intval(ip->end) > 0)
+    munmap(get_tagged_ptr(&ip->map), intval(ip->end));
+  ip->buf = NULL;
+  ip->fd = makeint(-1);
+  ip->map.v = makeint(0);
+  ip->start = ip->end = makeint(0);
+  ip->closed = makebool(true);
+
+  for (struct list **l = &open_iports; *l != NULL;
+       l = (struct list **)&(*l)->cdr)
+    if ((*l)->car == ip)
+      {
+        *l = (*l)->cdr;
+        break;
+      }
+  undefined();
+}
+
+UNSAFEOP(open_iports, ,
+         "-> `l. Returns a list of the input ports that have not been"
+         " closed, in the order they were opened.",
+         (void), OP_LEAF | OP_NOESCAPE, ".l")
+{
+  struct list *result = NULL, *l = open_iports;
+  GCPRO(result, l);
+  for (; l != NULL; l = l->cdr)
+    result = alloc_list(l->car, result);
+  UNGCPRO();
+  return result;
+}
+
+/* Returns the next record of ip terminated by character sep, or false at
+   end-of-file. The last record need not be terminated. */
+static value iport_record(struct iport *ip, char sep)
+{
+  long searched = 0;
+  GCPRO(ip);
+  for (;;)
+    {
+      const char *data = iport_data(ip) + intval(ip->start);
+      long avail = iport_avail(ip);
+      const char *found = memchr(data + searched, sep, avail - searched);
+      if (found != NULL)
+        {
+          value result = iport_take(ip, found - data, 1);
+          UNGCPRO();
+          return result;
+        }
+      searched = avail;
+      if (!iport_fill(ip, avail + 1))
+        break;
+    }
+  UNGCPRO();
+  if (iport_avail(ip) == 0)
+    return makebool(false);
+  return iport_take(ip, iport_avail(ip), 0);
+}
+
+UNSAFEOP(iport_read_line, ,
+         "`p -> `s. Returns the next line of input port `p, without the"
+         " trailing newline, or false at end-of-file. Causes an error if"
+         " the line is longer than `MAX_STRING_SIZE.",
+         (struct iport *ip), OP_LEAF | OP_NOESCAPE, "o.[sz]")
+{
+  CHECK_TYPES(ip, CT_IPORT);
+  return iport_record(ip, '\n');
+}
+
+UNSAFEOP(iport_read_record, ,
+         "`p `n -> `s. Returns the characters of input port `p up to the"
+         " next character `n, which is consumed but not included, or false"
+         " at end-of-file. Causes an error if the record is longer than"
+         " `MAX_STRING_SIZE.",
+         (struct iport *ip, value msep), OP_LEAF | OP_NOESCAPE, "on.[sz]")
+{
+  long sep;
+  CHECK_TYPES(ip,   CT_IPORT,
+              msep, CT_RANGE(sep, 0, UCHAR_MAX));
+  return iport_record(ip, sep);
+}
+
+UNSAFEOP(iport_read, ,
+         "`p `n -> `s. Returns the next `n characters of input port `p,"
+         " or fewer at end-of-file; returns false if there are none.",
+         (struct iport *ip, value mn), OP_LEAF | OP_NOESCAPE, "on.[sz]")
+{
+  long n;
+  CHECK_TYPES(ip, CT_IPORT,
+              mn, CT_RANGE(n, 1, MAX_STRING_SIZE));
+  GCPRO(ip);
+  while (iport_avail(ip) < n && iport_fill(ip, n))
+    ;
+  UNGCPRO();
+  long avail = iport_avail(ip);
+  if (avail == 0)
+    return makebool(false);
+  return iport_take(ip, avail < n ? avail : n, 0);
+}
+
+static enum runtime_error ct_fd_oport(struct oport *p, const char **errmsg,
+                                      int unused)
+{
+  if (is_fd_port(p) && fd_port_fd(p) >= 0)
+    return error_none;
+  *errmsg = "expected open fd oport";
+  return error_bad_type;
+}
+
+#define CT_FD_OPORT F(TSET(oport), ct_fd_oport, 0)
+
+#ifdef HAVE_EPOLL
+struct evloop;
+static void evloop_forget_oport(struct evloop *el, struct oport *p);
+#endif
+
+UNSAFEOP(make_fd_oport, ,
+         "`n0 `n1 -> `p. Returns an output port for file descriptor `n0,"
+         " which is made non-blocking. Output is queued until sent by"
+         " `pflush(), `fd_oport_send() or `event_loop_run(); once `n1"
+         " characters are queued, further output is discarded and"
+         " `fd_oport_overflow?() becomes true.\n"
+         "Cf. `fd_oport_close().",
+         (value mfd, value mlimit), OP_LEAF | OP_NOESCAPE, "nn.o")
+{
+  int fd;
+  long limit;
+  CHECK_TYPES(mfd,    CT_RANGE(fd, 0, INT_MAX),
+              mlimit, CT_RANGE(limit, 0, MAX_TAGGED_INT));
+  int flags = fcntl(fd, F_GETFL);
+  if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+    RUNTIME_ERROR(error_bad_value, "invalid file descriptor");
+  return make_fd_oport(fd, limit);
+}
+
+UNSAFEOP(fd_oport_send, ,
+         "`p -> `n. Sends as much of the output queued in fd oport `p as"
+         " possible without blocking. Returns the number of characters"
+         " still queued, or -`errno on error.",
+         (struct oport *p), OP_LEAF | OP_NOESCAPE | OP_NOALLOC, "o.n")
+{
+  CHECK_TYPES(p, CT_FD_OPORT);
+  long queued = fd_port_send(p);
+  return makeint(queued < 0 ? -errno : queued);
+}
+
+UNSAFEOP(fd_oport_queued, ,
+         "`p -> `n. Returns the number of characters queued in fd oport `p;"
+         " use this to stop producing output for slow receivers.",
+         (struct oport *p), OP_LEAF | OP_NOESCAPE | OP_NOALLOC, "o.n")
+{
+  CHECK_TYPES(p, CT_FD_OPORT);
+  return makeint(fd_port_queued(p));
+}
+
+UNSAFEOP(fd_oport_overflowp, "fd_oport_overflow?",
+         "`p -> `b. Returns true if output to fd oport `p has been"
+         " discarded as its queue was full.",
+         (struct oport *p), OP_LEAF | OP_NOESCAPE | OP_NOALLOC, "o.n")
+{
+  CHECK_TYPES(p, CT_FD_OPORT);
+  return makebool(fd_port_overflow(p));
+}
+
+UNSAFEOP(fd_oport_close, ,
+         "`p -> . Closes fd oport `p and its file descriptor, discarding"
+         " any queued output. If `p is watched by an event loop, its"
+         " descriptor is no longer watched.",
+         (struct oport *p), OP_LEAF | OP_NOESCAPE | OP_NOALLOC, "o.")
+{
+  CHECK_TYPES(p, CT_FD_OPORT);
+#ifdef HAVE_EPOLL
+  struct evloop *el = fd_port_watcher(p);
+  if (el != NULL)
+    evloop_forget_oport(el, p);
+#endif
+  opclose(p);
+  undefined();
+}
+
+UNSAFEOP(make_socketpair, ,
+         "-> `x. Returns a pair of connected UNIX stream sockets"
+         " as cons(`n0, `n1), or a Unix errno value on error.",
+         (void), OP_LEAF | OP_NOESCAPE, ".[kn]")
+{
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0)
+    return makeint(errno);
+  return alloc_list(makeint(fds[0]), makeint(fds[1]));
+}
+
+UNSAFEOP(fd_read, ,
+         "`n0 `n1 -> `x. Reads at most `n1 characters from file descriptor"
+         " `n0. Returns them as a string, \"\" if the descriptor is"
+         " non-blocking and no data is available, null at end-of-file, or a"
+         " Unix errno value on error.",
+         (value mfd, value mmax), OP_LEAF | OP_NOESCAPE, "nn.[snu]")
+{
+  int fd;
+  long max;
+  CHECK_TYPES(mfd,  CT_RANGE(fd, 0, INT_MAX),
+              mmax, CT_RANGE(max, 1, MAX_STRING_SIZE));
+  char buf[4096], *dst = max <= sizeof buf ? buf : xmalloc(max);
+  ssize_t n;
+  while ((n = read(fd, dst, max)) < 0 && errno == EINTR)
+    ;
+  value result;
+  if (n > 0)
+    result = alloc_string_length(dst, n);
+  else if (n == 0)
+    result = NULL;
+  else if (errno == EAGAIN || errno == EWOULDBLOCK)
+    result = static_empty_string;
+  else
+    result = makeint(errno);
+  if (dst != buf)
+    free(dst);
+  return result;
+}
+
+UNSAFEOP(fd_close, ,
+         "`n0 -> `n1. Closes file descriptor `n0. Returns 0 or a Unix"
+         " errno value on error.",
+         (value mfd), OP_LEAF | OP_NOESCAPE | OP_NOALLOC, "n.n")
+{
+  int fd;
+  CHECK_TYPES(mfd, CT_RANGE(fd, 0, INT_MAX));
+  return makeint(close(fd) < 0 ? errno : 0);
+}
+
+#ifdef HAVE_EPOLL
+
+/* An event loop waits for file descriptors to become readable, calling
+   their read callbacks, and flushes fd oports as their descriptors
+   become writable. */
+struct evloop {
+  struct mprivate p;
+  value epfd;                   /* makeint(-1) if closed */
+  struct vector *watches;       /* indexed by fd; see enum below */
+};
+
+enum {
+  ew_callback,                  /* read callback or null */
+  ew_oport,                     /* fd oport or null */
+  ew_events,                    /* current epoll events */
+  ew_fields
+};
+
+static enum runtime_error ct_evloop(value v, const char **errmsg, int unused)
+{
+  struct evloop *el = v;
+  if (TYPE(el, private) && el->p.ptype == makeint(PRIVATE_EVLOOP)
+      && intval(el->epfd) >= 0)
+    return error_none;
+  *errmsg = "expected open event loop";
+  return error_bad_type;
+}
+
+#define CT_EVLOOP F(TSET(private), ct_evloop, 0)
+
+static bool evloop_ctl(struct evloop *el, int op, int fd, uint32_t events)
+{
+  struct epoll_event ev = { .events = events, .data.fd = fd };
+  return epoll_ctl(intval(el->epfd), op, fd, &ev) == 0;
+}
+
+/* Stops watching fd in el */
+static void evloop_unwatch(struct evloop *el, int fd)
+{
+  struct vector *w = el->watches->data[fd];
+  struct oport *p = w->data[ew_oport];
+  if (p != NULL && is_fd_port(p))
+    fd_port_set_watcher(p, NULL);
+  evloop_ctl(el, EPOLL_CTL_DEL, fd, 0);
+  el->watches->data[fd] = NULL;
+}
+
+/* Stops watching the descriptors whose output goes to fd oport p, which
+   is about to be closed */
+static void evloop_forget_oport(struct evloop *el, struct oport *p)
+{
+  fd_port_set_watcher(p, NULL);
+  if (intval(el->epfd) < 0)
+    return;
+  long nwatches = vector_len(el->watches);
+  for (long fd = 0; fd < nwatches; ++fd)
+    {
+      struct vector *w = el->watches->data[fd];
+      if (w != NULL && w->data[ew_oport] == p)
+        evloop_unwatch(el, fd);
+    }
+}
+
+UNSAFEOP(make_event_loop, ,
+         "-> `el. Returns a new event loop.\n"
+         "Cf. `event_loop_add!(), `event_loop_run().",
+         (void), OP_LEAF | OP_NOESCAPE, ".o")
+{
+  int epfd = epoll_create1(EPOLL_CLOEXEC);
+  if (epfd < 0)
+    runtime_error_message(error_bad_value, "failed to create event loop");
+  struct vector *watches = alloc_vector(16);
+  GCPRO(watches);
+  struct evloop *el = (struct evloop *)alloc_private(PRIVATE_EVLOOP, 2);
+  UNGCPRO();
+  el->epfd = makeint(epfd);
+  el->watches = watches;
+  return el;
+}
+
+UNSAFEOP(event_loop_add, "event_loop_add!",
+         "`el `n `f `p -> . Watches file descriptor `n in event loop `el."
+         " `f(`n) is called when `n is readable (or has reached"
+         " end-of-file), unless `f is null. Output queued in fd oport `p,"
+         " unless null, is sent when `n becomes writable; `p can only be"
+         " watched by one event loop at a time.",
+         (struct evloop *el, value mfd, value callback, struct oport *p),
+         OP_LEAF | OP_NOESCAPE, "onxx.")
+{
+  int fd;
+  CHECK_TYPES(el,       CT_EVLOOP,
+              mfd,      CT_RANGE(fd, 0, INT_MAX),
+              callback, OR(null, CT_CALLABLE(1)),
+              p,        OR(null, CT_FD_OPORT));
+
+  long nwatches = vector_len(el->watches);
+  if (fd < nwatches && el->watches->data[fd] != NULL)
+    RUNTIME_ERROR(error_bad_value, "file descriptor already watched");
+  if (p != NULL && fd_port_watcher(p) != NULL)
+    RUNTIME_ERROR(error_bad_value, "fd oport already watched");
+
+  struct vector *w;
+  GCPRO(el, callback, p);
+  if (fd >= nwatches)
+    {
+      long nlen = 2 * nwatches;
+      if (nlen <= fd)
+        nlen = fd + 1;
+      struct vector *nwatch = alloc_vector(nlen);
+      memcpy(nwatch->data, el->watches->data,
+             nwatches * sizeof nwatch->data[0]);
+      el->watches = nwatch;
+    }
+  w = alloc_vector(ew_fields);
+  UNGCPRO();
+  uint32_t events = callback ? EPOLLIN : 0;
+  w->data[ew_callback] = callback;
+  w->data[ew_oport] = p;
+  w->data[ew_events] = makeint(events);
+  if (!evloop_ctl(el, EPOLL_CTL_ADD, fd, events))
+    runtime_error_message(error_bad_value, "failed to watch file descriptor");
+  el->watches->data[fd] = w;
+  if (p != NULL)
+    fd_port_set_watcher(p, el);
+  undefined();
+}
+
+UNSAFEOP(event_loop_remove, "event_loop_remove!",
+         "`el `n -> . Stops watching file descriptor `n in event loop `el."
+         " Does nothing if `n is not watched.",
+         (struct evloop *el, value mfd), OP_LEAF | OP_NOESCAPE | OP_NOALLOC,
+         "on.")
+{
+  int fd;
+  CHECK_TYPES(el,  CT_EVLOOP,
+              mfd, CT_RANGE(fd, 0, INT_MAX));
+  if (fd < vector_len(el->watches) && el->watches->data[fd] != NULL)
+    evloop_unwatch(el, fd);
+  undefined();
+}
+
+UNSAFEOP(event_loop_close, ,
+         "`el -> . Closes event loop `el.",
+         (struct evloop *el), OP_LEAF | OP_NOESCAPE | OP_NOALLOC, "o.")
+{
+  CHECK_TYPES(el, CT_EVLOOP);
+  long nwatches = vector_len(el->watches);
+  for (long fd = 0; fd < nwatches; ++fd)
+    if (el->watches->data[fd] != NULL)
+      evloop_unwatch(el, fd);
+  close(intval(el->epfd));
+  el->epfd = makeint(-1);
+  el->watches = NULL;
+  undefined();
+}
+
+/* Sends queued output of the fd oport watched in w, if any, and updates
+   its interest in writability. */
+static void evloop_flush(struct evloop *el, int fd, struct vector *w)
+{
+  struct oport *p = w->data[ew_oport];
+  uint32_t events = intval(w->data[ew_events]);
+  uint32_t nevents = events & ~EPOLLOUT;
+  if (p != NULL && is_fd_port(p) && fd_port_send(p) > 0)
+    nevents |= EPOLLOUT;
+  if (nevents != events && evloop_ctl(el, EPOLL_CTL_MOD, fd, nevents))
+    w->data[ew_events] = makeint(nevents);
+}
+
+UNSAFEOP(event_loop_run, ,
+         "`el `n0 -> `n1. Sends any output queued in the fd oports of"
+         " event loop `el, then waits at most `n0 milliseconds (-1 for no"
+         " limit) for watched file descriptors to become ready. Calls the"
+         " read callbacks of readable ones and sends more output to"
+         " writable ones. Returns the number of ready descriptors, or 0"
+         " if interrupted by a signal. Causes an error if waiting fails"
+         " otherwise.",
+         (struct evloop *el, value mtimeout), OP_APPLY, "on.n")
+{
+  int timeout;
+  CHECK_TYPES(el,       CT_EVLOOP,
+              mtimeout, CT_RANGE(timeout, -1, INT_MAX));
+
+  long nwatches = vector_len(el->watches);
+  for (long fd = 0; fd < nwatches; ++fd)
+    {
+      struct vector *w = el->watches->data[fd];
+      if (w != NULL)
+        evloop_flush(el, fd, w);
+    }
+
+  struct epoll_event events[64];
+  int nevents = epoll_wait(intval(el->epfd), events, VLENGTH(events),
+                           timeout);
+  if (nevents < 0)
+    {
+      if (errno == EINTR)
+        return makeint(0);
+      static char msg[64];
+      int err = errno;
+      snprintf(msg, sizeof msg, "event loop wait failed: %s (errno %d)",
+               strerror(err), err);
+      runtime_error_message(error_bad_value, msg);
+    }
+
+  GCPRO(el);
+  for (int i = 0; i < nevents; ++i)
+    {
+      if (intval(el->epfd) < 0)
+        break;
+      int fd = events[i].data.fd;
+      if (fd >= vector_len(el->watches))
+        continue;
+      struct vector *w = el->watches->data[fd];
+      if (w == NULL)
+        continue;
+      if (events[i].events & EPOLLOUT)
+        evloop_flush(el, fd, w);
+      value callback = w->data[ew_callback];
+      if (callback != NULL
+          && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+        call1(callback, makeint(fd));
+    }
+  UNGCPRO();
+  return makeint(nevents);
+}
+
+#endif  /* HAVE_EPOLL */
+
 SECOP(passwd_file_entries, ,
       "-> `l. Returns a list of [ `pw_name `pw_uid"
       " `pw_gid `pw_gecos `pw_dir `pw_shell ] from the contents of"
@@ -883,10 +1675,38 @@ SECOP(mount_points, ,
 
 void files_init(void)
 {
+  staticpro(&open_iports);
+
   DEFINE(load);
+  DEFINE(load_cache_directory);
+  DEFINE(load_cache_hits);
   DEFINE(file_read);
   DEFINE(file_write);
   DEFINE(file_append);
+  DEFINE(port_write_fd);
+  DEFINE(open_input_file);
+  DEFINE(is_iport);
+  DEFINE(iport_close);
+  DEFINE(open_iports);
+  DEFINE(iport_read_line);
+  DEFINE(iport_read_record);
+  DEFINE(iport_read);
+
+  DEFINE(make_fd_oport);
+  DEFINE(fd_oport_send);
+  DEFINE(fd_oport_queued);
+  DEFINE(fd_oport_overflowp);
+  DEFINE(fd_oport_close);
+  DEFINE(make_socketpair);
+  DEFINE(fd_read);
+  DEFINE(fd_close);
+#ifdef HAVE_EPOLL
+  DEFINE(make_event_loop);
+  DEFINE(event_loop_add);
+  DEFINE(event_loop_remove);
+  DEFINE(event_loop_close);
+  DEFINE(event_loop_run);
+#endif
   DEFINE(print_file);
   DEFINE(print_file_part);
 
@@ -953,6 +1773,15 @@ void files_init(void)
   DEFINE(geteuid);
   DEFINE(getgid);
   DEFINE(getegid);
+  DEFINE(getpid);
+
+  DEFINE(fork);
+  DEFINE(waitpid);
+  DEFINE(kill);
+  DEF(SIGTERM);
+  DEF(SIGKILL);
+  DEFINE(child_exit);
+  DEFINE(processor_count);
 
   DEFINE(glob_files);
 #ifdef GLOB_MARK
@@ -0,0 +1,663 @@
+/*
+ * Copyright (c) 1993-2012 David Gay and Gustav Hllberg
+ * All rights reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose, without fee, and without written agreement is hereby granted,
+ * provided that the above copyright notice and the following two paragraphs
+ * appear in all copies of this software.
+ *
+ * IN NO EVENT SHALL DAVID GAY OR GUSTAV HALLBERG BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES ARISING OUT
+ * OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF DAVID GAY OR
+ * GUSTAV HALLBERG HAVE BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * DAVID GAY AND GUSTAV HALLBERG SPECIFICALLY DISCLAIM ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN
+ * "AS IS" BASIS, AND DAVID GAY AND GUSTAV HALLBERG HAVE NO OBLIGATION TO
+ * PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ */
+
+
+#include <string.h>
+
+#include "check-types.h"
+#include "hashmap.h"
+#include "pattern.h"
+#include "prims.h"
+
+#include "../alloc.h"
+#include "../call.h"
+#include "../charset.h"
+#include "../hash.h"
+#include "../table.h"
+
+/* Hash maps from arbitrary keys to values, compared either with equal?()
+   or with ==.
+
+   The slots vector holds HMAP_SLOT values per entry: the hash, the key,
+   and the value, with open addressing and linear probing. Empty slots have
+   a NULL hash. Hashes are stored as makeint((hash << 1) | addr), where
+   addr is set if the hash depends on an object address.
+
+   A garbage collection may move such keys, leaving their stored hashes
+   stale. The map stays consistent with its stored hashes, so lookups of
+   keys that did not move still succeed; stale hashes are only recomputed,
+   in place, when a lookup by address misses after a collection. */
+
+enum {
+  HMAP_HASH,
+  HMAP_KEY,
+  HMAP_VALUE,
+  HMAP_SLOT
+};
+
+#define HMAP_MIN_SIZE 8
+
+/* how deep and how wide structural hashing looks into keys */
+#define HASH_DEPTH 4
+#define HASH_WIDTH 8
+
+#define HASH_BITS (CHAR_BIT * sizeof (ulong))
+
+struct hmap {
+  struct mprivate p;
+  value eq;                     /* true for == keys, false for equal?() */
+  value used;                   /* makeint(number of entries) */
+  value addr_keys;              /* makeint(entries hashed by address) */
+  value gcgen;                  /* makeint(gc_count()) when last hashed */
+  struct vector *slots;
+};
+
+#ifdef LOCAL_MUDLLE_TYPES
+#undef LOCAL_MUDLLE_TYPES
+#define LOCAL_MUDLLE_TYPES struct hmap *: true,
+#endif
+
+static bool is_hmap(value _h)
+{
+  struct hmap *h = _h;
+  return (TYPE(h, private)
+          && h->p.ptype == makeint(PRIVATE_HMAP));
+}
+
+static enum runtime_error ct_hmap(value v, const char **errmsg, bool write)
+{
+  if (!is_hmap(v))
+    {
+      *errmsg = "expected hash map";
+      return error_bad_type;
+    }
+  if (write && readonlyp(v))
+    return error_value_read_only;
+  return error_none;
+}
+
+#define CT_HMAP(write) F(TSET(private), ct_hmap, write)
+
+static ulong gc_count(void)
+{
+  return gcstats.minor_count + gcstats.major_count;
+}
+
+static ulong mix_hash(uint64_t h)
+{
+  h ^= h >> 33;
+  h *= UINT64_C(0xff51afd7ed558ccd);
+  h ^= h >> 33;
+  return h;
+}
+
+struct table_hash {
+  ulong h;
+  bool ctable, *addr;
+  int depth;
+};
+
+static ulong hash_value(value v, bool eq, int depth, bool *addr);
+
+/* order-independent hash of a table entry; null entries are equivalent
+   to absent ones */
+static bool hash_table_entry(struct symbol *sym, void *_data)
+{
+  struct table_hash *data = _data;
+  if (sym->data == NULL)
+    return false;
+  struct string *name = sym->name;
+  ulong h = (data->ctable
+             ? symbol_nhash(name->str, string_len(name), HASH_BITS)
+             : symbol_7inhash(name->str, string_len(name), HASH_BITS));
+  data->h += mix_hash(h + hash_value(sym->data, false, data->depth - 1,
+                                     data->addr));
+  return false;
+}
+
+/* *addr is set if the hash depends on the address of some object */
+static ulong hash_value(value v, bool eq, int depth, bool *addr)
+{
+  if (!pointerp(v))
+    return mix_hash((ulong)v);
+
+  struct obj *obj = v;
+  if (eq)
+    goto by_address;
+
+  ulong h = obj->type;
+  switch (obj->type)
+    {
+    case type_string:
+      {
+        struct string *s = v;
+        return h ^ symbol_nhash(s->str, string_len(s), HASH_BITS);
+      }
+    case type_float:
+      {
+        /* equal?() uses ==, so 0.0 and -0.0 must hash alike */
+        double d = ((struct mudlle_float *)v)->d;
+        if (d == 0)
+          d = 0;
+        ulong bits;
+        CASSERT_EXPR(sizeof bits == sizeof d);
+        memcpy(&bits, &d, sizeof bits);
+        return mix_hash(h ^ bits);
+      }
+    case type_bigint:
+      {
+        struct bigint *bi = v;
+        check_bigint(bi);
+        size_t n = mpz_size(bi->mpz);
+        h ^= mpz_sgn(bi->mpz);
+        for (size_t i = 0; i < n; ++i)
+          h = mix_hash(h ^ mpz_getlimbn(bi->mpz, i));
+        return h;
+      }
+    case type_symbol:
+      {
+        /* symbol names compare case- and accent-insensitively */
+        struct string *name = ((struct symbol *)v)->name;
+        return h ^ symbol_7inhash(name->str, string_len(name), HASH_BITS);
+      }
+    case type_pair:
+      if (depth == 0)
+        return h;
+      for (int i = 0; i < HASH_WIDTH && TYPE(v, pair); ++i)
+        {
+          struct list *l = v;
+          h = mix_hash(h + hash_value(l->car, eq, depth - 1, addr));
+          v = l->cdr;
+        }
+      if (!TYPE(v, pair))
+        h = mix_hash(h + hash_value(v, eq, depth - 1, addr));
+      return h;
+    case type_vector:
+      {
+        struct vector *vec = v;
+        ulong len = vector_len(vec);
+        h = mix_hash(h ^ len);
+        if (depth == 0)
+          return h;
+        for (ulong i = 0; i < len && i < HASH_WIDTH; ++i)
+          h = mix_hash(h + hash_value(vec->data[i], eq, depth - 1, addr));
+        return h;
+      }
+    case type_table:
+      {
+        struct table *table = v;
+        h ^= is_ctable(table);
+        if (depth == 0)
+          return h;
+        struct table_hash data = {
+          .ctable = is_ctable(table), .addr = addr, .depth = depth
+        };
+        table_exists(table, hash_table_entry, &data);
+        return mix_hash(h ^ data.h);
+      }
+    default:
+      break;
+    }
+
+ by_address:
+  *addr = true;
+  return mix_hash((ulong)v);
+}
+
+static value make_hash(value key, bool eq)
+{
+  bool addr = false;
+  ulong h = hash_value(key, eq, HASH_DEPTH, &addr);
+  return makeint(((h >> 2) << 1) | addr);
+}
+
+static bool hash_is_addr(value hash)
+{
+  return intval(hash) & 1;
+}
+
+static ulong hash_pos(value hash, ulong mask)
+{
+  return ((ulong)intval(hash) >> 1) & mask;
+}
+
+static bool keys_equal(value a, value b, bool eq)
+{
+  if (a == b)
+    return true;
+  if (eq || !pointerp(a) || !pointerp(b))
+    return false;
+  return mudlle_equal(a, b);
+}
+
+static ulong hmap_capacity(struct hmap *h)
+{
+  return vector_len(h->slots) / HMAP_SLOT;
+}
+
+/* store (hash, key, val) in the first free slot in slots; does not check
+   for an existing entry */
+static void place_entry(struct vector *slots, value hash, value key,
+                        value val)
+{
+  ulong mask = vector_len(slots) / HMAP_SLOT - 1;
+  ulong pos = hash_pos(hash, mask);
+  while (slots->data[pos * HMAP_SLOT + HMAP_HASH])
+    pos = (pos + 1) & mask;
+  value *slot = &slots->data[pos * HMAP_SLOT];
+  slot[HMAP_HASH] = hash;
+  slot[HMAP_KEY] = key;
+  slot[HMAP_VALUE] = val;
+}
+
+/* move the entries in old into h->slots, recomputing address-based
+   hashes */
+static void reinsert_entries(struct hmap *h, struct vector *old)
+{
+  bool eq = istrue(h->eq);
+  long addr_keys = 0;
+  ulong nslots = vector_len(old) / HMAP_SLOT;
+  for (ulong i = 0; i < nslots; ++i)
+    {
+      value *slot = &old->data[i * HMAP_SLOT];
+      value hash = slot[HMAP_HASH];
+      if (hash == NULL)
+        continue;
+      if (hash_is_addr(hash))
+        {
+          hash = make_hash(slot[HMAP_KEY], eq);
+          addr_keys += hash_is_addr(hash);
+        }
+      place_entry(h->slots, hash, slot[HMAP_KEY], slot[HMAP_VALUE]);
+    }
+  h->addr_keys = makeint(addr_keys);
+  h->gcgen = makeint(gc_count());
+}
+
+/* clear the entry at index hole; backward-shift deletion moves later
+   entries of the same probe sequence into the hole */
+static void delete_entry(struct hmap *h, ulong hole)
+{
+  value *data = h->slots->data;
+  ulong mask = hmap_capacity(h) - 1;
+  for (ulong pos = (hole + 1) & mask; ; pos = (pos + 1) & mask)
+    {
+      value *next = &data[pos * HMAP_SLOT];
+      if (next[HMAP_HASH] == NULL)
+        break;
+      ulong home = hash_pos(next[HMAP_HASH], mask);
+      /* can next move to hole, i.e., is home cyclically outside
+         (hole, pos]? */
+      if (((pos - home) & mask) >= ((pos - hole) & mask))
+        {
+          memcpy(&data[hole * HMAP_SLOT], next,
+                 HMAP_SLOT * sizeof *next);
+          hole = pos;
+        }
+    }
+  memset(&data[hole * HMAP_SLOT], 0, HMAP_SLOT * sizeof *data);
+}
+
+/* Recompute, in place, the hashes of keys that a garbage collection
+   moved since h was last refreshed. Only entries whose hash changed are
+   moved. Does not allocate. */
+static void refresh_hmap(struct hmap *h)
+{
+  h->gcgen = makeint(gc_count());
+
+  bool eq = istrue(h->eq);
+  value *data = h->slots->data;
+  ulong size = hmap_capacity(h);
+  for (ulong pos = 0; pos < size; )
+    {
+      value *slot = &data[pos * HMAP_SLOT];
+      value hash = slot[HMAP_HASH];
+      value nhash;
+      if (hash == NULL || !hash_is_addr(hash)
+          || (nhash = make_hash(slot[HMAP_KEY], eq)) == hash)
+        {
+          ++pos;
+          continue;
+        }
+      /* Entries before pos are all up to date, and delete_entry() only
+         moves entries into pos or later (modulo wrap-around from entries
+         already seen), so look at pos again afterwards. */
+      value key = slot[HMAP_KEY], val = slot[HMAP_VALUE];
+      delete_entry(h, pos);
+      place_entry(h->slots, nhash, key, val);
+    }
+}
+
+static value *probe_entry(struct hmap *h, value key, value hash, bool eq)
+{
+  ulong mask = hmap_capacity(h) - 1;
+  for (ulong pos = hash_pos(hash, mask); ; pos = (pos + 1) & mask)
+    {
+      value *slot = &h->slots->data[pos * HMAP_SLOT];
+      if (slot[HMAP_HASH] == NULL)
+        return NULL;
+      if (slot[HMAP_HASH] == hash && keys_equal(slot[HMAP_KEY], key, eq))
+        return slot;
+    }
+}
+
+/* return the slot for key, or NULL; hash is set to key's hash */
+static value *find_entry(struct hmap *h, value key, value *hash)
+{
+  bool eq = istrue(h->eq);
+  *hash = make_hash(key, eq);
+  value *slot = probe_entry(h, key, *hash, eq);
+  /* Equal keys have equal hashes, so only a key hashed by address can
+     have been stored under a hash that is now stale. */
+  if (slot == NULL
+      && hash_is_addr(*hash)
+      && h->addr_keys != makeint(0)
+      && intval(h->gcgen) != gc_count())
+    {
+      refresh_hmap(h);
+      slot = probe_entry(h, key, *hash, eq);
+    }
+  return slot;
+}
+
+static struct hmap *alloc_hmap(bool eq)
+{
+  struct hmap *h = (struct hmap *)alloc_private(PRIVATE_HMAP, 5);
+  GCPRO(h);
+  struct vector *slots = alloc_vector(HMAP_MIN_SIZE * HMAP_SLOT);
+  UNGCPRO();
+  h->eq = makebool(eq);
+  h->used = h->addr_keys = makeint(0);
+  h->gcgen = makeint(gc_count());
+  h->slots = slots;
+  return h;
+}
+
+static void grow_hmap(struct hmap *h)
+{
+  ulong size = hmap_capacity(h);
+  if (2 * size * HMAP_SLOT > MAX_VECTOR_SIZE)
+    runtime_error_message(error_bad_value, "hash map is full");
+
+  GCPRO(h);
+  struct vector *slots = alloc_vector(2 * size * HMAP_SLOT);
+  UNGCPRO();
+
+  /* keys may have moved; reinsert_entries() rehashes them */
+  struct vector *old = h->slots;
+  h->slots = slots;
+  reinsert_entries(h, old);
+}
+
+static void hmap_set(struct hmap *h, value key, value val)
+{
+  value hash;
+  value *slot = find_entry(h, key, &hash);
+  if (slot)
+    {
+      slot[HMAP_VALUE] = val;
+      return;
+    }
+
+  bool resize = (ulong)intval(h->used) + 1 > hmap_capacity(h) / 4 * 3;
+  bool copy = !istrue(h->eq) && TYPE(key, string) && !readonlyp(key);
+  if (resize || copy)
+    {
+      GCPRO(h, key, val);
+      /* string keys are copied, as changing them would break the map */
+      if (copy)
+        key = make_readonly(mudlle_string_copy(key));
+      if (resize)
+        grow_hmap(h);
+      UNGCPRO();
+      /* key may have moved */
+      hash = make_hash(key, istrue(h->eq));
+    }
+
+  place_entry(h->slots, hash, key, val);
+  h->used = makeint(intval(h->used) + 1);
+  if (hash_is_addr(hash))
+    h->addr_keys = makeint(intval(h->addr_keys) + 1);
+}
+
+static bool hmap_remove(struct hmap *h, value key)
+{
+  value hash;
+  value *slot = find_entry(h, key, &hash);
+  if (slot == NULL)
+    return false;
+
+  if (hash_is_addr(hash))
+    h->addr_keys = makeint(intval(h->addr_keys) - 1);
+  h->used = makeint(intval(h->used) - 1);
+  delete_entry(h, (slot - h->slots->data) / HMAP_SLOT);
+  return true;
+}
+
+/* returns a vector of the keys and values of h, alternating */
+static struct vector *hmap_entries(struct hmap *h)
+{
+  GCPRO(h);
+  struct vector *v = alloc_vector(2 * intval(h->used));
+  UNGCPRO();
+  ulong n = 0;
+  ulong size = hmap_capacity(h);
+  for (ulong i = 0; i < size; ++i)
+    {
+      value *slot = &h->slots->data[i * HMAP_SLOT];
+      if (slot[HMAP_HASH] == NULL)
+        continue;
+      v->data[n++] = slot[HMAP_KEY];
+      v->data[n++] = slot[HMAP_VALUE];
+    }
+  assert(n == vector_len(v));
+  return v;
+}
+
+TYPEDOP(make_hash_map, ,
+        "-> `h. Returns a new, empty hash map whose keys are compared"
+        " with `equal?(). Keys may be of any type; string keys are"
+        " copied, but other keys must not be modified while in the map."
+        " Cf. `make_eq_hash_map().",
+        (void), OP_LEAF | OP_NOESCAPE, ".o")
+{
+  return alloc_hmap(false);
+}
+
+TYPEDOP(make_eq_hash_map, ,
+        "-> `h. Returns a new, empty hash map whose keys are compared"
+        " with ==. Cf. `make_hash_map().",
+        (void), OP_LEAF | OP_NOESCAPE, ".o")
+{
+  return alloc_hmap(true);
+}
+
+TYPEDOP(hash_mapp, "hash_map?", "`x -> `b. True if `x is a hash map.",
+        (value x), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "x.n")
+{
+  return makebool(is_hmap(x));
+}
+
+TYPEDOP(hash_map_entries, ,
+        "`h -> `n. Returns the number of entries in hash map `h.",
+        (struct hmap *h), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "o.n")
+{
+  CHECK_TYPES(h, CT_HMAP(false));
+  return h->used;
+}
+
+TYPEDOP(hash_map_get, ,
+        "`h `k `x0 -> `x1. Returns the value for key `k in hash map `h,"
+        " or `x0 if there is none. Cf. `hash_map_ref().",
+        (struct hmap *h, value key, value x),
+        OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "oxx.x")
+{
+  CHECK_TYPES(h,   CT_HMAP(false),
+              key, any,
+              x,   any);
+  value hash;
+  value *slot = find_entry(h, key, &hash);
+  return slot ? slot[HMAP_VALUE] : x;
+}
+
+TYPEDOP(hash_map_ref, ,
+        "`h `k -> `x. Returns the value for key `k in hash map `h, or"
+        " null if there is none. Cf. `hash_map_get().",
+        (struct hmap *h, value key),
+        OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "ox.x")
+{
+  CHECK_TYPES(h,   CT_HMAP(false),
+              key, any);
+  value hash;
+  value *slot = find_entry(h, key, &hash);
+  return slot ? slot[HMAP_VALUE] : NULL;
+}
+
+TYPEDOP(hash_map_hasp, "hash_map_has?",
+        "`h `k -> `b. True if hash map `h has an entry for key `k.",
+        (struct hmap *h, value key),
+        OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "ox.n")
+{
+  CHECK_TYPES(h,   CT_HMAP(false),
+              key, any);
+  value hash;
+  return makebool(find_entry(h, key, &hash) != NULL);
+}
+
+TYPEDOP(hash_map_set, "hash_map_set!",
+        "`h `k `x -> `x. Sets the value for key `k in hash map `h to `x.",
+        (struct hmap *h, value key, value x),
+        OP_LEAF | OP_NOESCAPE, "oxx.3")
+{
+  CHECK_TYPES(h,   CT_HMAP(true),
+              key, any,
+              x,   any);
+  GCPRO(x);
+  hmap_set(h, key, x);
+  UNGCPRO();
+  return x;
+}
+
+TYPEDOP(hash_map_remove, "hash_map_remove!",
+        "`h `k -> `b. Removes the entry for key `k from hash map `h."
+        " Returns true if there was one.",
+        (struct hmap *h, value key),
+        OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "ox.n")
+{
+  CHECK_TYPES(h,   CT_HMAP(true),
+              key, any);
+  return makebool(hmap_remove(h, key));
+}
+
+TYPEDOP(hash_map_empty, "hash_map_empty!",
+        "`h -> `h. Removes all entries from hash map `h.",
+        (struct hmap *h), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "o.1")
+{
+  CHECK_TYPES(h, CT_HMAP(true));
+  struct vector *slots = h->slots;
+  memset(slots->data, 0, vector_len(slots) * sizeof slots->data[0]);
+  h->used = h->addr_keys = makeint(0);
+  return h;
+}
+
+TYPEDOP(hash_map_keys, ,
+        "`h -> `l. Returns a list of the keys in hash map `h, in no"
+        " particular order.",
+        (struct hmap *h), OP_LEAF | OP_NOESCAPE, "o.l")
+{
+  CHECK_TYPES(h, CT_HMAP(false));
+  struct vector *v = hmap_entries(h);
+  struct list *l = NULL;
+  GCPRO(v, l);
+  for (long i = vector_len(v); i > 0; i -= 2)
+    l = alloc_list(v->data[i - 2], l);
+  UNGCPRO();
+  return l;
+}
+
+TYPEDOP(hash_map_list, ,
+        "`h -> `l. Returns a list of (`key . `value) for the entries in"
+        " hash map `h, in no particular order.",
+        (struct hmap *h), OP_LEAF | OP_NOESCAPE, "o.l")
+{
+  CHECK_TYPES(h, CT_HMAP(false));
+  struct vector *v = hmap_entries(h);
+  struct list *l = NULL;
+  GCPRO(v, l);
+  for (long i = vector_len(v); i > 0; i -= 2)
+    {
+      struct list *kv = alloc_list(v->data[i - 2], v->data[i - 1]);
+      l = alloc_list(kv, l);
+    }
+  UNGCPRO();
+  return l;
+}
+
+TYPEDOP(hash_map_foreach, ,
+        "`c `h -> . Calls `c(`key, `value) for each entry in hash map `h."
+        " It is safe to modify `h from `c().",
+        (value f, struct hmap *h), 0, "fo.")
+{
+  CHECK_TYPES(f, CT_CALLABLE(2),
+              h, CT_HMAP(false));
+  struct vector *v = NULL;
+  GCPRO(f, v);
+  v = hmap_entries(h);
+  for (long i = 0, len = vector_len(v); i < len; i += 2)
+    call2(f, v->data[i], v->data[i + 1]);
+  UNGCPRO();
+  undefined();
+}
+
+TYPEDOP(hash_map_reduce, ,
+        "`c `x0 `h -> `x1. Reduces hash map `h with `x = `c(`key, `value,"
+        " `x) for each entry, starting with `x0.",
+        (value f, value x, struct hmap *h), 0, "fxo.x")
+{
+  CHECK_TYPES(f, CT_CALLABLE(3),
+              x, any,
+              h, CT_HMAP(false));
+  struct vector *v = NULL;
+  GCPRO(f, x, v);
+  v = hmap_entries(h);
+  for (long i = 0, len = vector_len(v); i < len; i += 2)
+    x = call3(f, v->data[i], v->data[i + 1], x);
+  UNGCPRO();
+  return x;
+}
+
+void hashmap_init(void)
+{
+  DEFINE(make_hash_map);
+  DEFINE(make_eq_hash_map);
+  DEFINE(hash_mapp);
+  DEFINE(hash_map_entries);
+  DEFINE(hash_map_get);
+  DEFINE(hash_map_ref);
+  DEFINE(hash_map_hasp);
+  DEFINE(hash_map_set);
+  DEFINE(hash_map_remove);
+  DEFINE(hash_map_empty);
+  DEFINE(hash_map_keys);
+  DEFINE(hash_map_list);
+  DEFINE(hash_map_foreach);
+  DEFINE(hash_map_reduce);
+}
@@ -35,6 +35,7 @@
 #include "../call.h"
 #include "../charset.h"
 #include "../context.h"
+#include "../hash.h"
 #include "../interpret.h"
 #include "../mparser.h"
 #include "../ports.h"
@@ -155,6 +156,19 @@ TYPEDOP(ctime, , "-> `n. Returns the number of milliseconds of CPU"
   return makeint((long)t);
 }
 
+TYPEDOP(wtime, , "-> `n. Returns the number of milliseconds of elapsed"
+        " (monotonic) wall-clock time. Only use the difference between two"
+        " calls.\n"
+        "Cf. `ctime().",
+	(void),
+	OP_LEAF | OP_NOALLOC | OP_NOESCAPE, ".n")
+{
+  struct timespec ts;
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+    return makeint(-1);
+  return makeint((long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
 
 TYPEDOP(time, ,
 	"-> `n. Returns the number of seconds since the 1st of January"
@@ -446,8 +460,10 @@ UNSAFEOP(with_output_file, ,
 
 static struct {
   struct strbuf sb;
+  struct strbuf prog;           /* used by compile_format() */
   struct oport *oport;
-} format_data = { .sb = SBNULL };
+  struct vector *cache;         /* see lookup_format() */
+} format_data = { .sb = SBNULL, .prog = SBNULL };
 
 static bool is_single(value v)
 {
@@ -497,108 +513,157 @@ static const char *get_int(const char *s, long *dst, const char *err)
   return s;
 }
 
-static void pformat(struct oport *p, struct string *str,
-		    struct vector *args, int i, int nargs)
+/* A format string is compiled into a string of directives, each holding
+   the literal text that precedes a conversion and the parsed conversion
+   itself. The last directive has no conversion (conv is 0). */
+struct format_directive {
+  ulong lit_start, lit_len;     /* literal text in the format string */
+  ulong width;
+  long prec;                    /* -1 if none */
+  char conv;
+  bool zero, minus, plus, hash, space;
+  bool width_arg, prec_arg;     /* '*' width or precision */
+};
+
+#define FORMAT_CONVERSIONS "%npPCcbdoxsSwWaefg"
+
+/* Parses the directive of format string str that starts at *spos into
+   d, and advances *spos past it. */
+static void parse_directive(struct string *str, ulong *spos,
+                            struct format_directive *d)
 {
-  ulong slen, spos;
+  ulong slen = string_len(str);
+  *d = (struct format_directive){ .lit_start = *spos, .prec = -1 };
+  const char *percent = memchr(str->str + *spos, '%', slen - *spos);
+  if (percent == NULL)
+    {
+      d->lit_len = slen - *spos;
+      *spos = slen;
+      return;
+    }
+  d->lit_len = percent - (str->str + *spos);
 
-  GCPRO(args, str, p);
+  const char *s = percent + 1, *strend = str->str + slen;
 
-  slen = string_len(str);
-  spos = 0;
-  while (spos < slen)
+  /* look for flags */
+  for (;; ++s)
     {
-      size_t ppos;
-      {
-        const char *percent = memchr(str->str + spos, '%', slen - spos);
-        if (percent == NULL)
-          {
-            pswrite_substring(p, str, spos, slen - spos);
-            break;
-          }
-        ppos = percent - str->str;
-      }
+      if (s >= strend)
+        bad_format_value("invalid trailing format conversion");
+      switch (*s)
+        {
+        case '0': d->zero  = true; continue;
+        case '+': d->plus  = true; continue;
+        case '-': d->minus = true; continue;
+        case '#': d->hash  = true; continue;
+        case ' ': d->space = true; continue;
+        }
+      break;
+    }
 
-      pswrite_substring(p, str, spos, ppos - spos);
+  if (*s == '*')
+    {
+      d->width_arg = true;
+      ++s;
+    }
+  else
+    {
+      long l;
+      s = get_int(s, &l, "field width out of range");
+      d->width = l;
+    }
 
-      int conv;
+  if (s >= strend)
+    bad_format_value("invalid trailing format conversion");
 
-      bool zero = false, minus = false, plus = false;
-      bool hash = false, space = false;
+  if (*s == '.')
+    {
+      if (++s >= strend)
+        bad_format_value("invalid trailing format conversion");
+      if (*s == '*')
+        {
+          d->prec_arg = true;
+          ++s;
+        }
+      else
+        s = get_int(s, &d->prec, "precision out of range");
 
-      long prec = -1;
-      ulong width = 0;
+      if (s >= strend)
+        bad_format_value("invalid trailing format conversion");
+    }
 
-      {
-        const char *s = str->str + ppos + 1, *strend = str->str + slen;
+  if (*s == 0 || strchr(FORMAT_CONVERSIONS, *s) == NULL)
+    bad_format_value("unknown conversion");
+  d->conv = *s;
+  *spos = s - str->str + 1;
+}
 
-        /* look for flags */
-        for (;; ++s)
-          {
-            if (s >= strend)
-              bad_format_value("invalid trailing format conversion");
-            switch (*s)
-              {
-              case '0': zero  = true; continue;
-              case '+': plus  = true; continue;
-              case '-': minus = true; continue;
-              case '#': hash  = true; continue;
-              case ' ': space = true; continue;
-              }
-            break;
-          }
+static struct string *compile_format(struct string *str)
+{
+  struct strbuf *prog = &format_data.prog;
+  sb_empty(prog);
 
-        if (s >= strend)
-          bad_format_value("invalid trailing format conversion");
+  ulong spos = 0;
+  struct format_directive d;
+  do
+    {
+      parse_directive(str, &spos, &d);
+      sb_addmem(prog, &d, sizeof d);
+    }
+  while (d.conv != 0);
 
-        if (*s == '*')
-          {
-            if (i >= nargs)
-              missing_format_param();
-            long w = GETINT(args->data[i]); i++;
-            if (w < 0)
-              {
-                minus = true;
-                width = -w;
-              }
-            else
-              width = w;
-            ++s;
-          }
-        else
-          {
-            long l;
-            s = get_int(s, &l, "field width out of range");
-            width = l;
-          }
+  return alloc_string_length(sb_str(prog), sb_len(prog));
+}
 
-        if (s >= strend)
-          bad_format_value("invalid trailing format conversion");
+/* Outputs format string str with the arguments in args from index i to
+   nargs - 1. If prog is NULL, str is parsed as it is output; otherwise,
+   prog must be the result of compile_format(str). */
+static void run_format(struct oport *p, struct string *str,
+                       struct string *prog, struct vector *args, int i,
+                       int nargs)
+{
+  GCPRO(args, str, prog, p);
 
-        if (*s == '.')
-          {
-            if (++s >= strend)
-              bad_format_value("invalid trailing format conversion");
-            if (*s == '*')
-              {
-                if (i >= nargs)
-                  missing_format_param();
-                long w = GETINT(args->data[i]); i++;
-                if (w < 0)
-                  prec = -1;
-                else
-                  prec = w;
-                ++s;
-              }
-            else
-              s = get_int(s, &prec, "precision out of range");
+  ulong spos = 0;
+  for (size_t n = 0; ; ++n)
+    {
+      struct format_directive dir;
+      if (prog != NULL)
+        memcpy(&dir, prog->str + n * sizeof dir, sizeof dir);
+      else
+        parse_directive(str, &spos, &dir);
+
+      pswrite_substring(p, str, dir.lit_start, dir.lit_len);
+      if (dir.conv == 0)
+        break;
+
+      int conv = dir.conv;
+      bool zero = dir.zero, minus = dir.minus, plus = dir.plus;
+      bool hash = dir.hash, space = dir.space;
+      ulong width = dir.width;
+      long prec = dir.prec;
+
+      if (dir.width_arg)
+        {
+          if (i >= nargs)
+            missing_format_param();
+          long w = GETINT(args->data[i]); i++;
+          if (w < 0)
+            {
+              minus = true;
+              width = -w;
+            }
+          else
+            width = w;
+        }
 
-            if (s >= strend)
-              bad_format_value("invalid trailing format conversion");
-          }
-        spos = s - str->str + 1;
-        conv = *s;
-      }
+      if (dir.prec_arg)
+        {
+          if (i >= nargs)
+            missing_format_param();
+          long w = GETINT(args->data[i]); i++;
+          prec = w < 0 ? -1 : w;
+        }
 
       enum prt_level print_level;
 
@@ -611,7 +676,7 @@ static void pformat(struct oport *p, struct string *str,
       switch (conv)
         {
         default:
-          bad_format_value("unknown conversion");
+          abort();
         case '%': pputc('%', p); break;
         case 'n': pputc('\n', p); break;
         case 'p':
@@ -899,9 +964,118 @@ static void pformat(struct oport *p, struct string *str,
 }
 
 
-static struct string *sformat(struct string *fmt, struct vector *argv, int idx)
+struct cformat {
+  struct mprivate p;
+  struct string *fmt, *prog;
+};
+
+static bool is_cformat(value _cf)
+{
+  struct cformat *cf = _cf;
+  return (TYPE(cf, private)
+          && cf->p.ptype == makeint(PRIVATE_CFORMAT));
+}
+
+static void check_format(value fmt)
+{
+  if (!TYPE(fmt, string) && !is_cformat(fmt))
+    bad_typeset_error(fmt, TSET(string) | TSET(private));
+}
+
+static enum runtime_error ct_format(value v, const char **errmsg, int unused)
+{
+  if (TYPE(v, string) || is_cformat(v))
+    return error_none;
+  *errmsg = "expected string or compiled format";
+  return error_bad_type;
+}
+
+#define CT_FORMAT F(TSET(string) | TSET(private), ct_format, 0)
+
+/* Compiled read-only format strings are cached in format_data.cache,
+   indexed by the string's address. As the cache holds on to the format
+   strings, a match on the address means they are the same string; if it
+   has been moved by the garbage collector, we will simply miss. */
+#define FORMAT_CACHE_BITS 8
+
+static struct string *lookup_format(struct string *fmt)
+{
+  ulong slot = 2 * fold_hash((ulong)fmt, FORMAT_CACHE_BITS);
+  if (format_data.cache->data[slot] == fmt)
+    return format_data.cache->data[slot + 1];
+
+  struct string *prog;
+  GCPRO(fmt);
+  prog = compile_format(fmt);
+  UNGCPRO();
+  format_data.cache->data[slot] = fmt;
+  format_data.cache->data[slot + 1] = prog;
+  return prog;
+}
+
+static void pformat(struct oport *p, value fmt, struct vector *args, int i,
+                    int nargs)
+{
+  struct string *str, *prog;
+  if (is_cformat(fmt))
+    {
+      struct cformat *cf = fmt;
+      str = cf->fmt;
+      prog = cf->prog;
+    }
+  else
+    {
+      str = fmt;
+      if (readonlyp(str))
+        {
+          GCPRO(p, args, str);
+          prog = lookup_format(str);
+          UNGCPRO();
+        }
+      else
+        {
+          /* mutable strings cannot be cached, so do not bother
+             compiling them */
+          prog = NULL;
+        }
+    }
+  run_format(p, str, prog, args, i, nargs);
+}
+
+TYPEDOP(make_format, ,
+        "`s -> `f. Returns a compiled version of format string `s, which"
+        " can be passed instead of `s to `format(), `vformat(), `pformat(),"
+        " and the other formatting functions, without having to parse `s"
+        " each time. Read-only format strings, like string constants, are"
+        " compiled and cached automatically.\n"
+        "See `format() for syntax.",
+        (struct string *fmt), OP_LEAF | OP_NOESCAPE | OP_STR_READONLY, "s.o")
+{
+  CHECK_TYPES(fmt, string);
+  struct string *prog = NULL;
+  GCPRO(fmt, prog);
+  if (!readonlyp(fmt))
+    fmt = make_readonly(mudlle_string_copy(fmt));
+  prog = make_readonly(compile_format(fmt));
+  struct cformat *cf = (struct cformat *)alloc_private(PRIVATE_CFORMAT, 2);
+  UNGCPRO();
+  cf->fmt = fmt;
+  cf->prog = prog;
+  return make_readonly(cf);
+}
+
+TYPEDOP(is_cformat, "format?",
+        "`x -> `b. Returns true if `x is a compiled format string, as"
+        " returned by `make_format().",
+        (value x), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "x.n")
+{
+  return makebool(is_cformat(x));
+}
+
+
+static struct string *sformat(value fmt, struct vector *argv, int idx)
 {
-  TYPEIS(fmt, string);
+  check_format(fmt);
   TYPEIS(argv, vector);
 
   int nargs = vector_len(argv);
@@ -930,10 +1104,10 @@ VAROP(dformat, ,
       "`s `x1 `x2 ... -> . Displays formatted string `s to the standard"
       " oport with parameters `x1, ... See `format() for syntax. Equivalent"
       " to `display(`format(`s, `x1, ...)).",
-      OP_LEAF | OP_NOESCAPE | OP_STR_READONLY, "sx*.")
+      OP_LEAF | OP_NOESCAPE | OP_STR_READONLY, "[so]x*.")
 {
   if (nargs < 1) runtime_error(error_wrong_parameters);
-  TYPEIS(args->data[0], string);
+  check_format(args->data[0]);
   pformat(mudout, args->data[0], args, 1, nargs);
   pflush(mudout);
   undefined();
@@ -942,10 +1116,10 @@ VAROP(dformat, ,
 TYPEDOP(dvformat, , "`s `v -> . Displays formatted string `s to the standard"
         " oport with parameters in `v."
         " See `format() for syntax. Equivalent to `display(`vformat(`s, `v)).",
-        (struct string *fmt, struct vector *argv),
-        OP_LEAF | OP_NOESCAPE | OP_STR_READONLY | OP_TRACE, "sv.")
+        (value fmt, struct vector *argv),
+        OP_LEAF | OP_NOESCAPE | OP_STR_READONLY | OP_TRACE, "[so]v.")
 {
-  TYPEIS(fmt, string);
+  check_format(fmt);
   TYPEIS(argv, vector);
   pformat(mudout, fmt, argv, 0, vector_len(argv));
   pflush(mudout);
@@ -956,11 +1130,11 @@ VAROP(pformat, ,
       "`oport `s `x1 `x2 ... -> . Outputs formatted string `s to `oport,"
       " with parameters `x1, ... See `format() for syntax. Does nothing if"
       " `oport is not an output port.",
-      OP_LEAF | OP_NOESCAPE | OP_STR_READONLY, "xsx*.")
+      OP_LEAF | OP_NOESCAPE | OP_STR_READONLY, "x[so]x*.")
 {
   if (nargs < 2) runtime_error(error_wrong_parameters);
 
-  TYPEIS(args->data[1], string);
+  check_format(args->data[1]);
 
   GCPRO(args);
   struct oport *p = get_oport(args->data[0]);
@@ -974,12 +1148,12 @@ VAROP(pformat, ,
 TYPEDOP(pvformat, , "`oport `s `v -> . Output formatted string `s0 with"
         " parameters in `v to `oport. See `format() for syntax. Does nothing"
         " if `oport is not an output port.",
-        (struct oport *p, struct string *fmt, struct vector *argv),
-        OP_LEAF | OP_NOESCAPE | OP_STR_READONLY | OP_TRACE, "xsv.")
+        (struct oport *p, value fmt, struct vector *argv),
+        OP_LEAF | OP_NOESCAPE | OP_STR_READONLY | OP_TRACE, "x[so]v.")
 {
   GCPRO(fmt, argv);                     /* CT_OPT_OPORT may cause GC */
   CHECK_TYPES(p,    CT_OPT_OPORT,
-              fmt,  string,
+              fmt,  CT_FORMAT,
               argv, vector);
   UNGCPRO();
   if (p != NULL)
@@ -989,8 +1163,8 @@ TYPEDOP(pvformat, , "`oport `s `v -> . Output formatted string `s0 with"
 
 TYPEDOP(vformat, , "`s0 `v -> `s1. Formats string `s0 with"
         " parameters in `v. See `format() for syntax.",
-        (struct string *fmt, struct vector *argv),
-        OP_LEAF | OP_NOESCAPE | OP_STR_READONLY | OP_TRACE, "sv.s")
+        (value fmt, struct vector *argv),
+        OP_LEAF | OP_NOESCAPE | OP_STR_READONLY | OP_TRACE, "[so]v.s")
 {
   return sformat(fmt, argv, 0);
 }
@@ -1007,7 +1181,7 @@ VAROP(sformat, ,
       "If `s0 is a string, `sformat() will place a null character at"
       " `s0[`n] if and only if `n is less than `slength(`s0).\n"
       "See `format() for syntax.",
-      OP_LEAF | OP_NOESCAPE, "[su]sx*.n")
+      OP_LEAF | OP_NOESCAPE, "[su][so]x*.n")
 {
   if (nargs < 2)
     runtime_error(error_wrong_parameters);
@@ -1022,8 +1196,8 @@ VAROP(sformat, ,
 	runtime_error(error_value_read_only);
     }
 
-  struct string *fmt = args->data[1];
-  TYPEIS(fmt, string);
+  value fmt = args->data[1];
+  check_format(fmt);
 
   if (s == fmt)
     runtime_error(error_bad_value);
@@ -1151,7 +1325,7 @@ VAROP(format, ,
       "  `a   \tThe next parameter (a float, integer, or bigint) in"
       " \"[-]0xh.hhhhp<+->d\" style." EXTRA_CONVERSIONS,
       OP_LEAF | OP_NOESCAPE | OP_STR_READONLY | OP_CONST,
-      "sx*.s")
+      "[so]x*.s")
 {
   if (nargs < 1) runtime_error(error_wrong_parameters);
   return sformat(args->data[0], args, 1);
@@ -1366,6 +1540,7 @@ void io_init(void)
   DEFINE(examine);
   DEFINE(newline);
   DEFINE(ctime);
+  DEFINE(wtime);
   DEFINE(time);
   DEFINE(time_afterp);
   DEFINE(time_diff);
@@ -1394,6 +1569,8 @@ void io_init(void)
   DEFINE(format);
   DEFINE(sformat);
   DEFINE(vformat);
+  DEFINE(make_format);
+  DEFINE(is_cformat);
 
   DEFINE(add_call_trace_oport);
   DEFINE(remove_call_trace_oport);
@@ -1401,4 +1578,6 @@ void io_init(void)
 
   format_data.oport = make_strbuf_oport(&format_data.sb);
   staticpro(&format_data.oport);
+  format_data.cache = alloc_vector(2 << FORMAT_CACHE_BITS);
+  staticpro(&format_data.cache);
 }
@@ -32,9 +32,13 @@
 #include "../call.h"
 #include "../charset.h"
 #include "../hash.h"
+#include "../ports.h"
 #include "../print.h"
+#include "../strbuf.h"
+#include "../utils.h"
 
 #include "check-types.h"
+#include "io.h"
 #include "mudlle-string.h"
 #include "prims.h"
 
@@ -116,18 +120,6 @@ TYPEDOP(string_length, , "`s -> `n. Return length of string",
   return makeint(string_len(str));
 }
 
-#define DEF_MEM_TRANS(name, op)                         \
-static void name(char *dst, const char *src, size_t l)  \
-{                                                       \
-  for (; l; --l, ++src, ++dst)                          \
-    *dst = op(*src);                                    \
-}                                                       \
-static void name(char *dst, const char *src, size_t l)
-
-DEF_MEM_TRANS(mem8lwr, TO_8LOWER);
-DEF_MEM_TRANS(mem8upr, TO_8UPPER);
-DEF_MEM_TRANS(mem7prt, TO_7PRINT);
-
 static value string_translate(struct string *src,
                               void (*f)(char *, const char *, size_t),
                               const struct prim_op *op)
@@ -574,49 +566,66 @@ TYPEDOP(string_index_offset, ,
   return string_index(haystack, needle, ofs);
 }
 
+/* Searches are either exact, with a NULL fold table, or compare
+   characters after translating them through fold */
+#define FOLD(fold, c) ((fold) ? (fold)[(unsigned char)(c)] : (unsigned char)(c))
+
 /* find distance from the last character to its previous occurrence
    or length of string if none */
-static size_t steplen(const char *s, size_t l)
+static size_t steplen(const char *s, size_t l, const unsigned char *fold)
 {
-  char c = s[l - 1];
+  unsigned char c = FOLD(fold, s[l - 1]);
   for (size_t step = 1; step < l; ++step)
-    if (s[l - 1 - step] == c)
+    if (FOLD(fold, s[l - 1 - step]) == c)
       return step;
   return l;
 }
 
-static size_t step8ilen(const char *s, size_t l)
-{
-  char c = TO_7LOWER(s[l - 1]);
-  for (size_t step = 1; step < l; ++step)
-    if (TO_7LOWER(s[l - 1 - step]) == c)
-      return step;
-  return l;
-}
+/* Needles at least this long, in haystacks at least this long, are
+   searched for using Boyer-Moore-Horspool; otherwise we scan for the
+   needle's last character, which is vectorised */
+#define BMH_MIN_NEEDLE    8
+#define BMH_MIN_HAYSTACK  256
 
-static int string_search(struct string *s1, struct string *s2,
-                         long ofs,
-                         int (*cmpfn)(const void *, const void *, size_t),
-                         void *(*chrfn)(const void *, int, size_t),
-                         size_t (*stepfn)(const char *, size_t))
+static long bmh_search(const char *t1, size_t l1, const char *t2, size_t l2,
+                       int (*cmpfn)(const void *, const void *, size_t),
+                       const unsigned char *fold)
 {
-  ulong l1 = string_len(s1);
-  ulong l2 = string_len(s2);
+  /* shifts are capped to fit the table; shorter shifts are still safe */
+  uint8_t skip[256];
+  memset(skip, l2 < UINT8_MAX ? l2 : UINT8_MAX, sizeof skip);
+  for (size_t i = 0; i < l2 - 1; ++i)
+    {
+      size_t d = l2 - 1 - i;
+      skip[FOLD(fold, t2[i])] = d < UINT8_MAX ? d : UINT8_MAX;
+    }
 
-  if (ofs < 0)
-    ofs += l1;
-  if (ofs < 0 || ofs > l1)
-    runtime_error(error_bad_value);
-  l1 -= ofs;
+  unsigned char lastc2 = FOLD(fold, t2[l2 - 1]);
+  for (size_t pos = 0; pos <= l1 - l2; )
+    {
+      unsigned char c = FOLD(fold, t1[pos + l2 - 1]);
+      if (c == lastc2 && cmpfn(t1 + pos, t2, l2 - 1) == 0)
+        return pos;
+      pos += skip[c];
+    }
+  return -1;
+}
 
+/* returns the index of t2[0..l2-1] in t1[0..l1-1], or -1 if not found */
+static long mem_search(const char *t1, size_t l1, const char *t2, size_t l2,
+                       const unsigned char *fold)
+{
   /* Immediate termination conditions */
   if (l2 == 0) return 0;
   if (l2 > l1) return -1;
 
-  const char *t1 = s1->str + ofs;
-  const char *t2 = s2->str;
+  int (*cmpfn)(const void *, const void *, size_t)
+    = fold ? mem7icmp : memcmp;
+  if (l2 >= BMH_MIN_NEEDLE && l1 >= BMH_MIN_HAYSTACK)
+    return bmh_search(t1, l1, t2, l2, cmpfn, fold);
 
-  size_t c2_step = stepfn(t2, l2);
+  void *(*chrfn)(const void *, int, size_t) = fold ? mem7ichr : memchr;
+  size_t c2_step = steplen(t2, l2, fold);
   char lastc2 = t2[l2 - 1];
   size_t i = l2 - 1; /* No point in starting earlier */
   for (;;)
@@ -628,7 +637,7 @@ static int string_search(struct string *s1, struct string *s2,
 
       const char *check_start = next_c2 - (l2 - 1);
       if (cmpfn(check_start, t2, l2 - 1) == 0)
-        return check_start - t1 + ofs;
+        return check_start - t1;
 
       i += c2_step;
       if (i >= l1)
@@ -636,21 +645,33 @@ static int string_search(struct string *s1, struct string *s2,
     }
 }
 
+static int string_search(struct string *s1, struct string *s2,
+                         long ofs, const unsigned char *fold)
+{
+  ulong l1 = string_len(s1);
+
+  if (ofs < 0)
+    ofs += l1;
+  if (ofs < 0 || ofs > l1)
+    runtime_error(error_bad_value);
+
+  long pos = mem_search(s1->str + ofs, l1 - ofs, s2->str, string_len(s2),
+                        fold);
+  return pos < 0 ? -1 : pos + ofs;
+}
+
 int mudlle_string_isearch(struct string *haystack, struct string *needle)
 {
-  return string_search(haystack, needle, 0, mem7icmp, mem7ichr, step8ilen);
+  return string_search(haystack, needle, 0, latin1_to_ascii_icmp);
 }
 
 static value string_msearch(struct string *s1, struct string *s2,
-                            long ofs,
-                            int (*cmpfn)(const void *, const void *, size_t),
-                            void *(*chrfn)(const void *, int, size_t),
-                            size_t (*stepfn)(const char *, size_t))
+                            long ofs, const unsigned char *fold)
 {
-  return makeint(string_search(s1, s2, ofs, cmpfn, chrfn, stepfn));
+  return makeint(string_search(s1, s2, ofs, fold));
 }
 
-#define DEF_STRING_SEARCH(infix, cmpfn, chrfn, stepfn, doc)             \
+#define DEF_STRING_SEARCH(infix, fold, doc)                             \
 TYPEDOP(string_ ## infix ## search, ,                                   \
         "`s1 `s2 -> `n. Searches in string `s1 for string `s2" doc "."  \
         " Returns the first index in `s1 where `s2 was found,"          \
@@ -661,11 +682,11 @@ TYPEDOP(string_ ## infix ## search, ,                                   \
 {                                                                       \
   CHECK_TYPES(s1, string,                                               \
               s2, string);                                              \
-  return string_msearch(s1, s2, 0, cmpfn, chrfn, stepfn);               \
+  return string_msearch(s1, s2, 0, fold);                                \
 }
 
-DEF_STRING_SEARCH(,  memcmp,   memchr,   steplen, "")
-DEF_STRING_SEARCH(i, mem7icmp, mem7ichr, step8ilen,
+DEF_STRING_SEARCH(,  NULL, "")
+DEF_STRING_SEARCH(i, latin1_to_ascii_icmp,
                   " (case- and accentuation-insensitive)")
 
 TYPEDOP(string_isearch_offset, ,
@@ -681,7 +702,7 @@ TYPEDOP(string_isearch_offset, ,
   CHECK_TYPES(s1, string,
               mofs, CT_INT(ofs),
               s2, string);
-  return string_msearch(s1, s2, ofs, mem7icmp, mem7ichr, step8ilen);
+  return string_msearch(s1, s2, ofs, latin1_to_ascii_icmp);
 }
 
 TYPEDOP(substring, , "`s1 `n1 `n2 -> `s2. Extract substring of `s starting"
@@ -798,51 +819,563 @@ TYPEDOP(string_append, , "`s1 `s2 -> `s. Concatenate `s1 and `s2."
   return string_append(s1, s2, THIS_OP);
 }
 
-TYPEDOP(split_words, , "`s -> `l. Split string `s into a list of"
-        " space-separated words.\n"
-        "Single- or double-quoted sequences of words are kept together.",
-        (struct string *s),
-        OP_LEAF | OP_NOESCAPE | OP_STR_READONLY, "s.l")
+/* String builders: a mutable buffer with amortized constant-time appends,
+   to avoid the quadratic cost of building strings with repeated +.
+   String slices: a readonly view of part of a readonly string, to avoid
+   copying substrings. Parts of mutable strings are copied instead. */
+
+struct sbuilder {
+  struct mprivate p;
+  struct string *buf;           /* capacity is string_len(buf) */
+  value used;                   /* makeint(length of contents) */
+};
+
+struct sslice {
+  struct mprivate p;
+  struct string *parent;
+  value start, length;          /* makeint(...), within parent */
+};
+
+#ifdef LOCAL_MUDLLE_TYPES
+#undef LOCAL_MUDLLE_TYPES
+#define LOCAL_MUDLLE_TYPES                      \
+  struct kmatcher *: true,                      \
+  struct witer *:    true,                      \
+  struct sbuilder *: true,                      \
+  struct sslice *:   true,
+#endif
+
+#define SBUILDER_MIN_SIZE 32
+
+/* Slices of fewer characters than this are copied instead, as the copy
+   fits in the smallest string allocation */
+#define SSLICE_MIN_SIZE sizeof (value)
+
+static bool is_sbuilder(value _sb)
 {
-  CHECK_TYPES(s, string);
+  struct sbuilder *sb = _sb;
+  return (TYPE(sb, private)
+          && sb->p.ptype == makeint(PRIVATE_SBUILDER));
+}
+
+static bool is_sslice(value _sl)
+{
+  struct sslice *sl = _sl;
+  return (TYPE(sl, private)
+          && sl->p.ptype == makeint(PRIVATE_SSLICE));
+}
+
+static enum runtime_error ct_sbuilder(value v, const char **errmsg,
+                                      bool write)
+{
+  if (!is_sbuilder(v))
+    {
+      *errmsg = "expected string builder";
+      return error_bad_type;
+    }
+  if (write && readonlyp(v))
+    return error_value_read_only;
+  return error_none;
+}
+
+#define CT_SBUILDER(write) F(TSET(private), ct_sbuilder, write)
+
+bool text_parts(value v, struct string **str, long *start, long *len)
+{
+  if (TYPE(v, string))
+    {
+      *str = v;
+      *start = 0;
+      *len = string_len(*str);
+      return true;
+    }
+  if (is_sbuilder(v))
+    {
+      struct sbuilder *sb = v;
+      *str = sb->buf;
+      *start = 0;
+      *len = intval(sb->used);
+      return true;
+    }
+  if (is_sslice(v))
+    {
+      struct sslice *sl = v;
+      *str = sl->parent;
+      *start = intval(sl->start);
+      *len = intval(sl->length);
+      return true;
+    }
+  return false;
+}
+
+/* Returns: the characters of text v; sets *len to their number */
+static const char *text_data(value v, long *len)
+{
+  if (is_sbuilder(v))
+    {
+      struct sbuilder *sb = v;
+      *len = intval(sb->used);
+      return sb->buf->str;
+    }
+  if (is_sslice(v))
+    {
+      struct sslice *sl = v;
+      *len = intval(sl->length);
+      return sl->parent->str + intval(sl->start);
+    }
+  struct string *s = v;
+  assert(TYPE(s, string));
+  *len = string_len(s);
+  return s->str;
+}
+
+enum runtime_error ct_text(value v, const char **errmsg, int unused)
+{
+  if (TYPE(v, string) || is_sbuilder(v) || is_sslice(v))
+    return error_none;
+  *errmsg = "expected string, string builder or string slice";
+  return error_bad_type;
+}
+
+static inline long sbuilder_length(struct sbuilder *sb)
+{
+  return intval(sb->used);
+}
+
+/* Returns: true if n more characters fit in a string builder that currently
+   holds used characters */
+static bool sbuilder_fits(long used, long n)
+{
+  return n <= MAX_STRING_SIZE - used;
+}
+
+/* Makes room for n more characters in sb, which must fit.
+   Returns: the (possibly moved) sb */
+static struct sbuilder *sbuilder_reserve(struct sbuilder *sb, long n)
+{
+  long used = sbuilder_length(sb);
+  long size = string_len(sb->buf);
+  if (n <= size - used)
+    return sb;
+
+  size = size > MAX_STRING_SIZE / 2 ? MAX_STRING_SIZE : 2 * size;
+  if (size < used + n)
+    size = used + n;
+  if (size < SBUILDER_MIN_SIZE)
+    size = SBUILDER_MIN_SIZE;
+
+  GCPRO(sb);
+  struct string *buf = alloc_empty_string(size);
+  UNGCPRO();
+  memcpy(buf->str, sb->buf->str, used);
+  sb->buf = buf;
+  return sb;
+}
+
+/* Appends length characters of text x, starting at first, to sb */
+static value sbuilder_add(struct sbuilder *sb, value x, long first,
+                          long length)
+{
+  GCPRO(x);
+  sb = sbuilder_reserve(sb, length);
+  UNGCPRO();
+  long len;
+  const char *str = text_data(x, &len);
+  long used = sbuilder_length(sb);
+  memmove(sb->buf->str + used, str + first, length);
+  sb->used = makeint(used + length);
+  return sb;
+}
+
+TYPEDOP(make_string_builder, ,
+        "`n -> `sb. Returns a new empty string builder, with room for"
+        " `n characters before it needs to grow. Appending to a string"
+        " builder takes amortized constant time per character.\n"
+        "Cf. `sb_add!(), `sb_string().",
+        (value msize), OP_LEAF | OP_NOESCAPE, "n.x")
+{
+  long size;
+  CHECK_TYPES(msize, CT_RANGE(size, 0, MAX_STRING_SIZE));
+  if (size < SBUILDER_MIN_SIZE)
+    size = SBUILDER_MIN_SIZE;
+  struct string *buf = alloc_empty_string(size);
+  GCPRO(buf);
+  struct sbuilder *sb = (struct sbuilder *)alloc_private(
+    PRIVATE_SBUILDER, 2);
+  UNGCPRO();
+  sb->buf = buf;
+  sb->used = makeint(0);
+  return sb;
+}
+
+TYPEDOP(is_sbuilder, "string_builder?",
+        "`x -> `b. Returns true if `x is a string builder, as created by"
+        " `make_string_builder().",
+        (value x), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "x.n")
+{
+  return makebool(is_sbuilder(x));
+}
+
+TYPEDOP(sb_length, , "`sb -> `n. Returns the number of characters in"
+        " string builder `sb.",
+        (value sb), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "x.n")
+{
+  CHECK_TYPES(sb, CT_SBUILDER(false));
+  return makeint(sbuilder_length(sb));
+}
+
+TYPEDOP(sb_add, "sb_add!", "`sb `x -> `sb. Appends `x, a string, string"
+        " builder or string slice, to string builder `sb.",
+        (value sb, value x),
+        OP_LEAF | OP_NOESCAPE | OP_STR_READONLY, "xx.1")
+{
+  CHECK_TYPES(sb, CT_SBUILDER(true),
+              x,  CT_TEXT);
+  long length;
+  text_data(x, &length);
+  if (!sbuilder_fits(sbuilder_length(sb), length))
+    RUNTIME_ERROR(error_bad_value, "string builder too long");
+  return sbuilder_add(sb, x, 0, length);
+}
+
+TYPEDOP(sb_add_substring, "sb_add_substring!",
+        "`sb `s `n0 `n1 -> `sb. Appends the `n1 characters of string `s"
+        " starting at index `n0 to string builder `sb.",
+        (value sb, struct string *s, value mstart, value mlength),
+        OP_LEAF | OP_NOESCAPE | OP_STR_READONLY, "xsnn.1")
+{
+  long first, length;
+  CHECK_TYPES(sb,      CT_SBUILDER(true),
+              s,       string,
+              mstart,  CT_STR_IDX(first, s, true),
+              mlength, CT_RANGE(length, 0, LONG_MAX));
+  if (first + length > string_len(s))
+    RUNTIME_ERROR(error_bad_index, NULL);
+  if (!sbuilder_fits(sbuilder_length(sb), length))
+    RUNTIME_ERROR(error_bad_value, "string builder too long");
+  return sbuilder_add(sb, s, first, length);
+}
+
+TYPEDOP(sb_addc, "sb_addc!", "`sb `n -> `sb. Appends character `n to string"
+        " builder `sb.",
+        (value sb, value mc), OP_LEAF | OP_NOESCAPE, "xn.1")
+{
+  unsigned char c;
+  CHECK_TYPES(sb, CT_SBUILDER(true),
+              mc, CT_RANGE(c, SCHAR_MIN, UCHAR_MAX));
+  long used = sbuilder_length(sb);
+  if (!sbuilder_fits(used, 1))
+    RUNTIME_ERROR(error_bad_value, "string builder too long");
+  struct sbuilder *b = sbuilder_reserve(sb, 1);
+  b->buf->str[used] = c;
+  b->used = makeint(used + 1);
+  return b;
+}
+
+TYPEDOP(sb_clear, "sb_clear!", "`sb -> `sb. Empties string builder `sb,"
+        " keeping its allocated space.",
+        (value sb), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "x.1")
+{
+  CHECK_TYPES(sb, CT_SBUILDER(true));
+  ((struct sbuilder *)sb)->used = makeint(0);
+  return sb;
+}
+
+TYPEDOP(sb_string, , "`x -> `s. Returns the contents of `x, a string,"
+        " string builder or string slice, as a string. Strings are"
+        " returned as is; otherwise a new string is allocated.",
+        (value x), OP_LEAF | OP_NOESCAPE | OP_STR_READONLY, "x.s")
+{
+  CHECK_TYPES(x, CT_TEXT);
+  if (TYPE(x, string))
+    return x;
+  long length;
+  text_data(x, &length);
+  GCPRO(x);
+  struct string *s = alloc_empty_string(length);
+  UNGCPRO();
+  memcpy(s->str, text_data(x, &length), length);
+  return s;
+}
+
+TYPEDOP(sb_print, , "`oport `x -> . Prints `x, a string, string builder or"
+        " string slice, to output port `oport. Does nothing if `oport is"
+        " not an output port.",
+        (struct oport *p, value x), OP_LEAF | OP_NOESCAPE, "xx.")
+{
+  GCPRO(x);                     /* CT_OPT_OPORT may cause GC */
+  CHECK_TYPES(p, CT_OPT_OPORT,
+              x, CT_TEXT);
+  UNGCPRO();
+
+  if (p != NULL)
+    {
+      struct string *s;
+      long start, length;
+      text_parts(x, &s, &start, &length);
+      pswrite_substring(p, s, start, length);
+    }
+  undefined();
+}
+
+TYPEDOP(sb_cmp, , "`x0 `x1 -> `n. Compares `x0 and `x1, each of which is a"
+        " string, string builder or string slice, as `string_cmp() does.",
+        (value a, value b), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "xx.n")
+{
+  CHECK_TYPES(a, CT_TEXT,
+              b, CT_TEXT);
+  long l1, l2;
+  const char *t1 = text_data(a, &l1);
+  const char *t2 = text_data(b, &l2);
+  long r = memcmp(t1, t2, l1 < l2 ? l1 : l2);
+  if (r == 0)
+    r = l1 - l2;
+  return makeint(r < 0 ? -1 : r > 0);
+}
+
+TYPEDOP(sb_search, , "`x0 `n0 `s -> `n1. Searches in `x0, a string, string"
+        " builder or string slice, starting at index `n0, for string `s."
+        " Returns the first index in `x0 where `s was found, or -1 if not"
+        " found.",
+        (value x, value mofs, struct string *s),
+        OP_LEAF | OP_NOALLOC | OP_NOESCAPE | OP_STR_READONLY, "xns.n")
+{
+  long ofs;
+  CHECK_TYPES(x,    CT_TEXT,
+              mofs, CT_INT(ofs),
+              s,    string);
+  long l;
+  const char *t = text_data(x, &l);
+  if (ofs < 0)
+    ofs += l;
+  if (ofs < 0 || ofs > l)
+    RUNTIME_ERROR(error_bad_index, NULL);
+  long pos = mem_search(t + ofs, l - ofs, s->str, string_len(s), NULL);
+  return makeint(pos < 0 ? -1 : pos + ofs);
+}
 
+/* Returns: a slice of length characters of s starting at start, or a
+   copy of them if s is mutable or they are few */
+static value make_slice(struct string *s, long start, long length)
+{
+  if (length < SSLICE_MIN_SIZE || !readonlyp(s))
+    {
+      GCPRO(s);
+      struct string *copy = alloc_empty_string(length);
+      UNGCPRO();
+      memcpy(copy->str, s->str + start, length);
+      return copy;
+    }
+
+  GCPRO(s);
+  struct sslice *sl = (struct sslice *)alloc_private(PRIVATE_SSLICE, 3);
+  UNGCPRO();
+  sl->parent = s;
+  sl->start = makeint(start);
+  sl->length = makeint(length);
+  return make_readonly(sl);
+}
+
+TYPEDOP(string_slice, ,
+        "`x0 `n0 `n1 -> `x1. Returns a view of the `n1 characters of `x0,"
+        " a string or string slice, starting at index `n0, without"
+        " copying them. Short views, and views of mutable strings, are"
+        " returned as new strings instead.\n"
+        "Cf. `substring(), `sb_string().",
+        (value x, value mstart, value mlength),
+        OP_LEAF | OP_NOESCAPE | OP_STR_READONLY, "xnn.x")
+{
+  long first, size;
+  CHECK_TYPES(x,       CT_TEXT,
+              mstart,  CT_INT(first),
+              mlength, CT_RANGE(size, 0, LONG_MAX));
+  if (is_sbuilder(x))
+    RUNTIME_ERROR(error_bad_type, "cannot slice string builders");
+
+  struct string *s;
+  long start, length;
+  text_parts(x, &s, &start, &length);
+  if (first < 0)
+    first += length;
+  if (first < 0 || first > length || size > length - first)
+    RUNTIME_ERROR(error_bad_index, NULL);
+  return make_slice(s, start + first, size);
+}
+
+TYPEDOP(is_sslice, "string_slice?",
+        "`x -> `b. Returns true if `x is a string slice, as created by"
+        " `string_slice().",
+        (value x), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "x.n")
+{
+  return makebool(is_sslice(x));
+}
+
+TYPEDOP(text_length, , "`x -> `n. Returns the number of characters in `x,"
+        " a string, string builder or string slice.",
+        (value x), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "x.n")
+{
+  CHECK_TYPES(x, CT_TEXT);
+  long length;
+  text_data(x, &length);
+  return makeint(length);
+}
+
+TYPEDOP(text_ref, , "`x `n0 -> `n1. Returns the character at index `n0 of"
+        " `x, a string, string builder or string slice.",
+        (value x, value midx), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "xn.n")
+{
+  long idx;
+  CHECK_TYPES(x,    CT_TEXT,
+              midx, CT_INT(idx));
+  long length;
+  const char *str = text_data(x, &length);
+  if (idx < 0)
+    idx += length;
+  if (idx < 0 || idx >= length)
+    RUNTIME_ERROR(error_bad_index, NULL);
+  return makeint((unsigned char)str[idx]);
+}
+
+TYPEDOP(text_atoi, , "`x -> `n|`x. Converts `x, a string, string builder"
+        " or string slice, into an integer as `atoi() does.\n"
+        "Returns `x if the conversion failed.",
+        (value x), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "x.x")
+{
+  CHECK_TYPES(x, CT_TEXT);
+  long length, n;
+  const char *str = text_data(x, &length);
+  if (!mudlle_strtolong(str, length, &n, 0, false))
+    return x;
+  return makeint(n);
+}
+
+/* Finds the next space-separated word of str[0 .. slen - 1] at or after
+   index *idx. Single- or double-quoted sequences of words are kept
+   together. Returns: true if found, setting *idx and *end to its start
+   and end. */
+static bool find_word(const char *str, long slen, long *idx, long *end)
+{
+  long i = *idx;
+  while (i < slen && str[i] == ' ')
+    ++i;
+  *idx = i;
+
+  if (i == slen)
+    return false;
+
+  const char *endp;
+  if ((str[i] == '\'' || str[i] == '"') /* quoted words */
+      && (endp = memchr(str + i + 1, str[i], slen - i - 1)))
+    *end = endp - str + 1;
+  else
+    {
+      const char *space = memchr(str + i + 1, ' ', slen - i - 1);
+      *end = space ? space - str : slen;
+    }
+  return true;
+}
+
+/* Returns: a list of at most maxwords words of s */
+static struct list *split_words(struct string *s, long maxwords)
+{
   long slen = string_len(s);
   struct list *l = NULL, *last = NULL;
   GCPRO(l, last, s);
 
-  int idx = 0;
-
-  for (;;)
+  long idx = 0, end;
+  for (; maxwords > 0 && find_word(s->str, slen, &idx, &end); --maxwords)
     {
-      while (idx < slen && s->str[idx] == ' ')
-        ++idx;
+      long len = end - idx;
+      struct string *wrd = alloc_empty_string(len);
+      memcpy(wrd->str, s->str + idx, len);
 
-      if (idx == slen)
-        break;
+      idx = end;
 
-      const char *endp;
-      int end;
-      if ((s->str[idx] == '\'' || s->str[idx] == '"') /* quoted words */
-          && (endp = memchr(s->str + idx + 1, s->str[idx], slen - idx - 1)))
-        end = endp - s->str + 1;
+      value v = alloc_list(wrd, NULL);
+      if (!l)
+        l = last = v;
       else
         {
-          end = idx + 1;
-          while (end < slen && s->str[end] != ' ')
-            ++end;
+          last->cdr = v;
+          last = v;
         }
+    }
 
-      int len = end - idx;
-      struct string *wrd = alloc_empty_string(len);
-      memcpy(wrd->str, s->str + idx, len);
+  UNGCPRO();
 
+  return l;
+}
+
+TYPEDOP(split_words, , "`s -> `l. Split string `s into a list of"
+        " space-separated words.\n"
+        "Single- or double-quoted sequences of words are kept together.",
+        (struct string *s),
+        OP_LEAF | OP_NOESCAPE | OP_STR_READONLY, "s.l")
+{
+  CHECK_TYPES(s, string);
+  return split_words(s, LONG_MAX);
+}
+
+TYPEDOP(split_words_n, ,
+        "`s `n -> `l. Returns a list of the first `n words of string `s,"
+        " split as `split_words() does.",
+        (struct string *s, value mn),
+        OP_LEAF | OP_NOESCAPE | OP_STR_READONLY, "sn.l")
+{
+  long n;
+  CHECK_TYPES(s,  string,
+              mn, CT_RANGE(n, 0, LONG_MAX));
+  return split_words(s, n);
+}
+
+TYPEDOP(count_words, ,
+        "`x -> `n. Returns the number of words in `x, a string or string"
+        " slice, as split by `split_words().",
+        (value x),
+        OP_LEAF | OP_NOALLOC | OP_NOESCAPE | OP_STR_READONLY, "x.n")
+{
+  CHECK_TYPES(x, CT_TEXT);
+  long slen;
+  const char *str = text_data(x, &slen);
+  long n = 0;
+  for (long idx = 0, end; find_word(str, slen, &idx, &end); idx = end)
+    ++n;
+  return makeint(n);
+}
+
+TYPEDOP(split_words_slices, ,
+        "`x -> `l. Splits `x, a string or string slice, into a list of"
+        " space-separated words as `split_words() does, but returns"
+        " slices of `x instead of copies for all but short words. If `x"
+        " is a mutable string, the words are slices of a readonly copy"
+        " of `x.\n"
+        "Cf. `string_slice().",
+        (value x),
+        OP_LEAF | OP_NOESCAPE | OP_STR_READONLY, "x.l")
+{
+  CHECK_TYPES(x, CT_TEXT);
+  if (is_sbuilder(x))
+    RUNTIME_ERROR(error_bad_type, "cannot slice string builders");
+
+  struct string *s;
+  long base, slen;
+  text_parts(x, &s, &base, &slen);
+  /* the words of a mutable string share one readonly copy */
+  if (!readonlyp(s))
+    s = make_readonly(mudlle_string_copy(s));
+  struct list *l = NULL, *last = NULL;
+  GCPRO(l, last, s);
+
+  for (long idx = 0, end; find_word(s->str + base, slen, &idx, &end); )
+    {
+      value wrd = make_slice(s, base + idx, end - idx);
       idx = end;
 
+      value v = alloc_list(wrd, NULL);
       if (!l)
-        l = last = alloc_list(wrd, NULL);
+        l = last = v;
       else
         {
-          value v = alloc_list(wrd, NULL);
           last->cdr = v;
           last = v;
         }
@@ -853,6 +1386,120 @@ TYPEDOP(split_words, , "`s -> `l. Split string `s into a list of"
   return l;
 }
 
+/* Word iterators step through the words of a text without allocating. */
+struct witer {
+  struct mprivate p;
+  value text;                   /* string or string slice */
+  value start, end;             /* current word; both 0 before the first
+                                   word, and the text length after the
+                                   last */
+};
+
+static bool is_witer(value _wi)
+{
+  struct witer *wi = _wi;
+  return (TYPE(wi, private)
+          && wi->p.ptype == makeint(PRIVATE_WITER));
+}
+
+static enum runtime_error ct_witer(value v, const char **errmsg, int unused)
+{
+  if (is_witer(v))
+    return error_none;
+  *errmsg = "expected word iterator";
+  return error_bad_type;
+}
+
+#define CT_WITER F(TSET(private), ct_witer, 0)
+
+TYPEDOP(make_word_iterator, ,
+        "`x -> `wi. Returns an iterator over the words of `x, a string or"
+        " string slice, as split by `split_words(). Mutable strings are"
+        " copied first. Use `word_iterator_next!() to step to each word"
+        " in turn.",
+        (value x), OP_LEAF | OP_NOESCAPE | OP_STR_READONLY, "x.o")
+{
+  CHECK_TYPES(x, CT_TEXT);
+  if (is_sbuilder(x))
+    RUNTIME_ERROR(error_bad_type, "cannot iterate over string builders");
+  if (TYPE(x, string) && !readonlyp(x))
+    x = make_readonly(mudlle_string_copy(x));
+  GCPRO(x);
+  struct witer *wi = (struct witer *)alloc_private(PRIVATE_WITER, 3);
+  UNGCPRO();
+  wi->text = x;
+  wi->start = wi->end = makeint(0);
+  return wi;
+}
+
+TYPEDOP(word_iterator_next, "word_iterator_next!",
+        "`wi -> `b. Steps word iterator `wi to its next word. Returns false"
+        " if there are no more words. The word can then be found with"
+        " `word_iterator_word(), or as indices with `word_iterator_start()"
+        " and `word_iterator_end().",
+        (struct witer *wi), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "o.n")
+{
+  CHECK_TYPES(wi, CT_WITER);
+  long slen;
+  const char *str = text_data(wi->text, &slen);
+  long idx = intval(wi->end), end;
+  if (!find_word(str, slen, &idx, &end))
+    {
+      wi->start = wi->end = makeint(slen);
+      return makebool(false);
+    }
+  wi->start = makeint(idx);
+  wi->end = makeint(end);
+  return makebool(true);
+}
+
+TYPEDOP(word_iterator_start, ,
+        "`wi -> `n. Returns the index of the start of the current word of"
+        " word iterator `wi.",
+        (struct witer *wi), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "o.n")
+{
+  CHECK_TYPES(wi, CT_WITER);
+  return wi->start;
+}
+
+TYPEDOP(word_iterator_end, ,
+        "`wi -> `n. Returns the index after the end of the current word of"
+        " word iterator `wi.",
+        (struct witer *wi), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "o.n")
+{
+  CHECK_TYPES(wi, CT_WITER);
+  return wi->end;
+}
+
+TYPEDOP(word_iterator_word, ,
+        "`wi -> `x. Returns the current word of word iterator `wi, as a"
+        " string slice or, for short words, a string.",
+        (struct witer *wi), OP_LEAF | OP_NOESCAPE, "o.x")
+{
+  CHECK_TYPES(wi, CT_WITER);
+  struct string *s;
+  long base, slen;
+  text_parts(wi->text, &s, &base, &slen);
+  long start = intval(wi->start);
+  return make_slice(s, base + start, intval(wi->end) - start);
+}
+
+TYPEDOP(word_iterator_rest, ,
+        "`wi -> `x. Returns the text of word iterator `wi after its"
+        " current word, without leading spaces, as a string slice or, if"
+        " short, a string.",
+        (struct witer *wi), OP_LEAF | OP_NOESCAPE, "o.x")
+{
+  CHECK_TYPES(wi, CT_WITER);
+  struct string *s;
+  long base, slen;
+  text_parts(wi->text, &s, &base, &slen);
+  long idx = intval(wi->end);
+  while (idx < slen && s->str[base + idx] == ' ')
+    ++idx;
+  return make_slice(s, base + idx, slen - idx);
+}
+
 TYPEDOP(atoi, , "`s -> `n|`s. Converts the string `s into an integer.\n"
         "Returns `s if the conversion failed.\n"
         "Handles binary, octal, decimal, and hexadecimal notation.\n"
@@ -903,12 +1550,27 @@ TYPEDOP(itoa, , "`n -> `s. Converts integer into string", (value mn),
   long n;
   CHECK_TYPES(mn, CT_INT(n));
 
-  /* conservative limit: 3 bits per decimal digit, round up, one sign
-     character, one zero character */
-  char buf[(TAGGED_INT_BITS - 1 + 2) / 3 + 1 + 1];
-  int c = sprintf(buf, "%ld", n);
-  assert(c < sizeof buf);
-  return make_readonly(alloc_string(buf));
+  struct intstr buf;
+  return make_readonly(alloc_string(longtostr(&buf, 10, n)));
+}
+
+TYPEDOP(string_sha256, , "`s0 -> `s1. Returns the SHA-256 digest of `s0"
+        " as a string of 64 lower-case hexadecimal digits.",
+        (struct string *s),
+        OP_LEAF | OP_NOESCAPE | OP_STR_READONLY | OP_CONST, "s.s")
+{
+  CHECK_TYPES(s, string);
+
+  unsigned char digest[SHA256_SIZE];
+  sha256(s->str, string_len(s), digest);
+
+  struct string *result = alloc_empty_string(2 * SHA256_SIZE);
+  for (int i = 0; i < SHA256_SIZE; ++i)
+    {
+      result->str[2 * i]     = "0123456789abcdef"[digest[i] >> 4];
+      result->str[2 * i + 1] = "0123456789abcdef"[digest[i] & 15];
+    }
+  return make_readonly(result);
 }
 
 TYPEDOP(isalpha, "calpha?", "`n -> `b. TRUE if `n is a letter (allowed in"
@@ -1257,6 +1919,362 @@ TYPEDOP(regexp_exec, ,
 
 #endif /* USE_PCRE */
 
+/* Keyword matchers: Aho-Corasick automata matching many strings in one
+   pass over the input. The automaton is stored in a string:
+     struct kmatch_header
+     uint32_t root[256]                  transitions from the root
+     struct kmatch_state states[nstates] state 0 is the root
+     struct kmatch_edge edges[nedges]    sorted by character for each state
+     uint32_t plen[npatterns]            length of each keyword
+     uint32_t pnext[npatterns]           1 + next keyword with the same
+                                           characters, or 0 */
+
+struct kmatcher {
+  struct mprivate p;
+  struct string *automaton;
+};
+
+struct kmatch_header {
+  uint32_t nstates, nedges, npatterns, icase;
+};
+
+struct kmatch_state {
+  uint32_t edges, nedges;       /* first edge and number of edges */
+  uint32_t fail;                /* longest proper suffix state */
+  uint32_t out;                 /* 1 + keyword ending here, or 0 */
+  uint32_t dict;                /* next suffix state with output, or 0 */
+};
+
+struct kmatch_edge {
+  uint32_t c, next;
+};
+
+struct kmatch {
+  const struct kmatch_header *h;
+  const uint32_t *root;
+  const struct kmatch_state *states;
+  const struct kmatch_edge *edges;
+  const uint32_t *plen, *pnext;
+};
+
+static bool is_kmatcher(value _km)
+{
+  struct kmatcher *km = _km;
+  return (TYPE(km, private)
+          && km->p.ptype == makeint(PRIVATE_KMATCHER));
+}
+
+static enum runtime_error ct_kmatcher(value v, const char **errmsg,
+                                      int unused)
+{
+  if (is_kmatcher(v))
+    return error_none;
+  *errmsg = "expected keyword matcher";
+  return error_bad_type;
+}
+
+#define CT_KMATCHER F(TSET(private), ct_kmatcher, 0)
+
+static struct kmatch get_kmatch(struct kmatcher *km)
+{
+  const char *data = km->automaton->str;
+  struct kmatch m;
+  m.h = (const struct kmatch_header *)data;
+  m.root = (const uint32_t *)(m.h + 1);
+  m.states = (const struct kmatch_state *)(m.root + 256);
+  m.edges = (const struct kmatch_edge *)(m.states + m.h->nstates);
+  m.plen = (const uint32_t *)(m.edges + m.h->nedges);
+  m.pnext = m.plen + m.h->npatterns;
+  return m;
+}
+
+static uint32_t kmatch_next(const struct kmatch *m, uint32_t state,
+                            unsigned char c)
+{
+  for (;;)
+    {
+      if (state == 0)
+        return m->root[c];
+      const struct kmatch_state *st = &m->states[state];
+      const struct kmatch_edge *e = m->edges + st->edges;
+      for (uint32_t lo = 0, hi = st->nedges; lo < hi; )
+        {
+          uint32_t mid = (lo + hi) / 2;
+          if (e[mid].c == c)
+            return e[mid].next;
+          if (e[mid].c < c)
+            lo = mid + 1;
+          else
+            hi = mid;
+        }
+      state = st->fail;
+    }
+}
+
+/* trie node used while building an automaton */
+struct kbuild_node {
+  uint32_t child, sibling;      /* first child, next sibling; 0 if none */
+  uint32_t fail, out, dict, nchildren;
+  unsigned char c;
+};
+
+static int cmp_kmatch_edge(const void *_a, const void *_b)
+{
+  const struct kmatch_edge *a = _a, *b = _b;
+  return (int)a->c - (int)b->c;
+}
+
+TYPEDOP(make_keyword_matcher, ,
+        "`v `b -> `km. Returns a keyword matcher for the non-empty strings in"
+        " vector `v, which finds all of them in a single pass over a string."
+        " If `b is true, matching ignores case and accentuation as"
+        " `string_isearch() does.\n"
+        "Cf. `keyword_match(), `keyword_match_first().",
+        (struct vector *v, value icase), OP_LEAF | OP_NOESCAPE, "vx.x")
+{
+  CHECK_TYPES(v,     vector,
+              icase, any);
+  bool fold = istrue(icase);
+  long npatterns = vector_len(v);
+  for (long i = 0; i < npatterns; ++i)
+    {
+      struct string *pat = v->data[i];
+      if (!TYPE(pat, string))
+        RUNTIME_ERROR(error_bad_type, "keywords must be strings");
+      if (string_len(pat) == 0)
+        RUNTIME_ERROR(error_bad_value, "keywords must not be empty");
+    }
+
+  /* build the trie */
+  struct strbuf nodesb = SBNULL, plensb = SBNULL, pnextsb = SBNULL;
+  sb_addmem(&nodesb, &(struct kbuild_node){ 0 }, sizeof (struct kbuild_node));
+  uint32_t root[256] = { 0 };
+  for (long i = 0; i < npatterns; ++i)
+    {
+      struct string *pat = v->data[i];
+      long len = string_len(pat);
+      uint32_t state = 0;
+      for (long j = 0; j < len; ++j)
+        {
+          unsigned char c = fold ? TO_7LOWER(pat->str[j]) : pat->str[j];
+          struct kbuild_node *nodes = (struct kbuild_node *)sb_mutable_str(
+            &nodesb);
+          uint32_t next;
+          if (state == 0)
+            next = root[c];
+          else
+            for (next = nodes[state].child;
+                 next && nodes[next].c != c;
+                 next = nodes[next].sibling)
+              ;
+          if (next == 0)
+            {
+              next = sb_len(&nodesb) / sizeof *nodes;
+              struct kbuild_node n = { .c = c };
+              if (state == 0)
+                root[c] = next;
+              else
+                {
+                  n.sibling = nodes[state].child;
+                  nodes[state].child = next;
+                }
+              ++nodes[state].nchildren;
+              sb_addmem(&nodesb, &n, sizeof n);
+            }
+          state = next;
+        }
+
+      struct kbuild_node *nodes = (struct kbuild_node *)sb_mutable_str(
+        &nodesb);
+      uint32_t pnext = nodes[state].out;
+      nodes[state].out = i + 1;
+      uint32_t plen = len;
+      sb_addmem(&plensb, &plen, sizeof plen);
+      sb_addmem(&pnextsb, &pnext, sizeof pnext);
+    }
+
+  struct kbuild_node *nodes = (struct kbuild_node *)sb_mutable_str(&nodesb);
+  uint32_t nstates = sb_len(&nodesb) / sizeof *nodes;
+  uint32_t nedges = nstates - 1 - nodes[0].nchildren;
+
+  /* compute failure and dictionary links breadth-first */
+  uint32_t *queue = xmalloc(nstates * sizeof *queue);
+  uint32_t qhead = 0, qtail = 0;
+  for (int c = 0; c < 256; ++c)
+    if (root[c])
+      queue[qtail++] = root[c];
+  while (qhead < qtail)
+    {
+      uint32_t u = queue[qhead++];
+      for (uint32_t w = nodes[u].child; w; w = nodes[w].sibling)
+        {
+          queue[qtail++] = w;
+          uint32_t f = nodes[u].fail, target;
+          for (;;)
+            {
+              if (f == 0)
+                {
+                  target = root[nodes[w].c];
+                  break;
+                }
+              for (target = nodes[f].child;
+                   target && nodes[target].c != nodes[w].c;
+                   target = nodes[target].sibling)
+                ;
+              if (target)
+                break;
+              f = nodes[f].fail;
+            }
+          nodes[w].fail = target;
+          nodes[w].dict = nodes[target].out ? target : nodes[target].dict;
+        }
+    }
+  free(queue);
+
+  size_t size = (sizeof (struct kmatch_header)
+                 + 256 * sizeof (uint32_t)
+                 + nstates * sizeof (struct kmatch_state)
+                 + nedges * sizeof (struct kmatch_edge)
+                 + 2 * npatterns * sizeof (uint32_t));
+  if (size > MAX_STRING_SIZE)
+    {
+      sb_free(&nodesb);
+      sb_free(&plensb);
+      sb_free(&pnextsb);
+      RUNTIME_ERROR(error_bad_value, "too many keywords");
+    }
+
+  struct string *automaton = alloc_empty_string(size);
+  struct kmatch_header *h = (struct kmatch_header *)automaton->str;
+  *h = (struct kmatch_header){
+    .nstates = nstates, .nedges = nedges, .npatterns = npatterns,
+    .icase = fold
+  };
+  memcpy(h + 1, root, sizeof root);
+  struct kmatch_state *states = (struct kmatch_state *)(
+    (uint32_t *)(h + 1) + 256);
+  struct kmatch_edge *edges = (struct kmatch_edge *)(states + nstates);
+  uint32_t edge = 0;
+  for (uint32_t i = 0; i < nstates; ++i)
+    {
+      states[i] = (struct kmatch_state){
+        .edges = edge, .fail = nodes[i].fail, .out = nodes[i].out,
+        .dict = nodes[i].dict
+      };
+      if (i == 0)
+        continue;
+      for (uint32_t w = nodes[i].child; w; w = nodes[w].sibling)
+        edges[edge++] = (struct kmatch_edge){ .c = nodes[w].c, .next = w };
+      states[i].nedges = edge - states[i].edges;
+      qsort(edges + states[i].edges, states[i].nedges, sizeof *edges,
+            cmp_kmatch_edge);
+    }
+  assert(edge == nedges);
+  uint32_t *plen = (uint32_t *)(edges + nedges);
+  memcpy(plen, sb_str(&plensb), npatterns * sizeof *plen);
+  memcpy(plen + npatterns, sb_str(&pnextsb), npatterns * sizeof *plen);
+  sb_free(&nodesb);
+  sb_free(&plensb);
+  sb_free(&pnextsb);
+
+  GCPRO(automaton);
+  struct kmatcher *km = (struct kmatcher *)alloc_private(PRIVATE_KMATCHER, 1);
+  UNGCPRO();
+  km->automaton = make_readonly(automaton);
+  return make_readonly(km);
+}
+
+TYPEDOP(is_kmatcher, "keyword_matcher?",
+        "`x -> `b. Returns true if `x is a keyword matcher, as created by"
+        " `make_keyword_matcher().",
+        (value x), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "x.n")
+{
+  return makebool(is_kmatcher(x));
+}
+
+/* Scans s, starting at index ofs, with keyword matcher km. If all, adds
+   each match as a (keyword, start) pair of longs to matches; otherwise,
+   stops after adding the first one. Matches are ordered by their end
+   position, longest first. */
+static void kmatch_scan(struct kmatcher *km, struct string *s, long ofs,
+                        bool all, struct strbuf *matches)
+{
+  struct kmatch m = get_kmatch(km);
+  bool fold = m.h->icase;
+  long len = string_len(s);
+  uint32_t state = 0;
+  for (long i = ofs; i < len; ++i)
+    {
+      unsigned char c = fold ? TO_7LOWER(s->str[i]) : s->str[i];
+      state = kmatch_next(&m, state, c);
+      for (uint32_t t = m.states[state].out ? state : m.states[state].dict;
+           t;
+           t = m.states[t].dict)
+        for (uint32_t p = m.states[t].out; p; p = m.pnext[p - 1])
+          {
+            long match[2] = { p - 1, i + 1 - m.plen[p - 1] };
+            sb_addmem(matches, match, sizeof match);
+            if (!all)
+              return;
+          }
+    }
+}
+
+TYPEDOP(keyword_match, ,
+        "`km `s `n -> `l. Returns all occurrences in `s, from index `n"
+        " onwards, of the keywords of keyword matcher `km, as a list of"
+        " cons(`i, `start), where `i is the keyword's index in the vector"
+        " passed to `make_keyword_matcher(). The list is ordered by the"
+        " end of each occurrence, longest first.",
+        (value km, struct string *s, value mofs),
+        OP_LEAF | OP_NOESCAPE | OP_STR_READONLY, "xsn.l")
+{
+  long ofs;
+  CHECK_TYPES(km,   CT_KMATCHER,
+              s,    string,
+              mofs, CT_STR_IDX(ofs, s, true));
+
+  static struct strbuf matches = SBNULL;
+  sb_empty(&matches);
+  kmatch_scan(km, s, ofs, true, &matches);
+
+  const long *match = (const long *)sb_str(&matches);
+  struct list *l = NULL;
+  GCPRO(l);
+  for (long i = sb_len(&matches) / (2 * sizeof *match); i-- > 0; )
+    {
+      struct list *p = alloc_list(makeint(match[2 * i]),
+                                  makeint(match[2 * i + 1]));
+      l = alloc_list(p, l);
+    }
+  UNGCPRO();
+  return l;
+}
+
+TYPEDOP(keyword_match_first, ,
+        "`km `s `n -> `x. Returns the first occurrence in `s, from index `n"
+        " onwards, of the keywords of keyword matcher `km, as"
+        " cons(`i, `start), or false if there is none. The first"
+        " occurrence is the one that ends first; of those, the longest.\n"
+        "Cf. `keyword_match().",
+        (value km, struct string *s, value mofs),
+        OP_LEAF | OP_NOESCAPE | OP_STR_READONLY, "xsn.[kz]")
+{
+  long ofs;
+  CHECK_TYPES(km,   CT_KMATCHER,
+              s,    string,
+              mofs, CT_STR_IDX(ofs, s, true));
+
+  static struct strbuf matches = SBNULL;
+  sb_empty(&matches);
+  kmatch_scan(km, s, ofs, false, &matches);
+  if (sb_len(&matches) == 0)
+    return makebool(false);
+
+  const long *match = (const long *)sb_str(&matches);
+  return alloc_list(makeint(match[0]), makeint(match[1]));
+}
+
 #ifdef HAVE_CRYPT
 TYPEDOP(crypt, , "`s1 `s2 -> `s3. Encrypt `s1 using `s2 as salt",
 	(struct string *s, struct string *salt),
@@ -1324,9 +2342,37 @@ void string_init(void)
   DEFINE(sdelete);
   DEFINE(substring);
   DEFINE(concat_strings);
+
+  DEFINE(make_string_builder);
+  DEFINE(is_sbuilder);
+  DEFINE(sb_length);
+  DEFINE(sb_add);
+  DEFINE(sb_add_substring);
+  DEFINE(sb_addc);
+  DEFINE(sb_clear);
+  DEFINE(sb_string);
+  DEFINE(sb_print);
+  DEFINE(sb_cmp);
+  DEFINE(sb_search);
+
+  DEFINE(string_slice);
+  DEFINE(is_sslice);
+  DEFINE(text_length);
+  DEFINE(text_ref);
+  DEFINE(text_atoi);
+  DEFINE(split_words_slices);
   DEFINE(string_append);
   DEFINE(split_words);
+  DEFINE(split_words_n);
+  DEFINE(count_words);
+  DEFINE(make_word_iterator);
+  DEFINE(word_iterator_next);
+  DEFINE(word_iterator_start);
+  DEFINE(word_iterator_end);
+  DEFINE(word_iterator_word);
+  DEFINE(word_iterator_rest);
   DEFINE(itoa);
+  DEFINE(string_sha256);
   DEFINE(atoi);
   DEFINE(atoi_base);
   DEFINE(string_upcase);
@@ -1356,6 +2402,11 @@ void string_init(void)
 
   DEFINE(is_regexp);
 
+  DEFINE(make_keyword_matcher);
+  DEFINE(is_kmatcher);
+  DEFINE(keyword_match);
+  DEFINE(keyword_match_first);
+
 #ifdef USE_PCRE
 
   DEFINE(make_regexp);
@@ -52,4 +52,12 @@ enum runtime_error ct_string_index(long idx, const char **errmsg,
 #define CT_STR_IDX(dst, str, beyond) \
   CT_INT_P((dst, str, beyond), __CT_STR_IDX_E)
 
+/* Text values are strings, string builders or string slices */
+bool text_parts(value v, struct string **str, long *start, long *len);
+/* Returns: true if v is a text value; then sets *str to the string holding
+     its characters, which are *len characters starting at index *start */
+
+enum runtime_error ct_text(value v, const char **errmsg, int unused);
+#define CT_TEXT F(TSET(string) | TSET(private), ct_text, 0)
+
 #endif /* RUNTIME_MUDLLE_STRING_H */
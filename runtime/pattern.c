@@ -200,6 +200,23 @@ static bool recurse(value lhs, value rhs, struct seen_values *seen)
     }
 }
 
+bool mudlle_equal(value lhs, value rhs)
+{
+  struct seen_values seen = { .size = 0 };
+  bool result = recurse(lhs, rhs, &seen);
+
+  /* restore modified data */
+  for (int i = 0; i < seen.used; ++i)
+    {
+      seen.seen[i].lhs->size = seen.seen[i].lhs_size;
+      seen.seen[i].lhs->flags &= ~OBJ_FLAG_0;
+      seen.seen[i].rhs->flags &= ~OBJ_FLAG_1;
+    }
+  free(seen.seen);
+
+  return result;
+}
+
 TYPEDOP(equalp, "equal?",
         "`x0 `x1 -> `b. Return true if `x0 is equal to `x1.\n"
         "Pairs, vectors, symbols, and tables are compared"
@@ -221,19 +238,7 @@ TYPEDOP(equalp, "equal?",
         OP_LEAF | OP_NOALLOC | OP_NOESCAPE | OP_STR_READONLY | OP_CONST,
         "xx.n")
 {
-  struct seen_values seen = { .size = 0 };
-  bool result = recurse(lhs, rhs, &seen);
-
-  /* restore modified data */
-  for (int i = 0; i < seen.used; ++i)
-    {
-      seen.seen[i].lhs->size = seen.seen[i].lhs_size;
-      seen.seen[i].lhs->flags &= ~OBJ_FLAG_0;
-      seen.seen[i].rhs->flags &= ~OBJ_FLAG_1;
-    }
-  free(seen.seen);
-
-  return makebool(result);
+  return makebool(mudlle_equal(lhs, rhs));
 }
 
 void pattern_init(void)
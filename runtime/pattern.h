@@ -22,6 +22,11 @@
 #ifndef RUNTIME_PATTERN_H
 #define RUNTIME_PATTERN_H
 
+#include "../types.h"
+
 void pattern_init(void);
 
+/* equal?(lhs, rhs); does not allocate */
+bool mudlle_equal(value lhs, value rhs);
+
 #endif /* RUNTIME_PATTERN_H */
@@ -0,0 +1,351 @@
+/*
+ * Copyright (c) 1993-2012 David Gay and Gustav Hllberg
+ * All rights reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose, without fee, and without written agreement is hereby granted,
+ * provided that the above copyright notice and the following two paragraphs
+ * appear in all copies of this software.
+ *
+ * IN NO EVENT SHALL DAVID GAY OR GUSTAV HALLBERG BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES ARISING OUT
+ * OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF DAVID GAY OR
+ * GUSTAV HALLBERG HAVE BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * DAVID GAY AND GUSTAV HALLBERG SPECIFICALLY DISCLAIM ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN
+ * "AS IS" BASIS, AND DAVID GAY AND GUSTAV HALLBERG HAVE NO OBLIGATION TO
+ * PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ */
+
+
+#include <string.h>
+
+#include "check-types.h"
+#include "pqueue.h"
+#include "prims.h"
+
+#include "../alloc.h"
+
+/* Priority queues with integer priorities, stored as 4-ary heaps.
+
+   Each queued value is held by an entry that remembers its position in
+   the heap, so an entry can be removed or given a new priority in
+   logarithmic time. Entries with equal priority come out in the order
+   they were added. */
+
+#define PQ_ARITY    4
+#define PQ_MIN_SIZE 16
+
+struct pqueue {
+  struct mprivate p;
+  value used;                   /* makeint(number of entries) */
+  value seq;                    /* makeint(next sequence number) */
+  struct vector *heap;
+};
+
+struct pqentry {
+  struct mprivate p;
+  struct pqueue *queue;         /* NULL unless queued */
+  value priority;
+  value seq;                    /* breaks ties in priority */
+  value value;
+  value pos;                    /* makeint(index in queue->heap) */
+};
+
+#ifdef LOCAL_MUDLLE_TYPES
+#undef LOCAL_MUDLLE_TYPES
+#define LOCAL_MUDLLE_TYPES struct pqueue *: true, struct pqentry *: true,
+#endif
+
+static bool is_pqueue(value _q)
+{
+  struct pqueue *q = _q;
+  return (TYPE(q, private)
+          && q->p.ptype == makeint(PRIVATE_PQUEUE));
+}
+
+static bool is_pqentry(value _e)
+{
+  struct pqentry *e = _e;
+  return (TYPE(e, private)
+          && e->p.ptype == makeint(PRIVATE_PQENTRY));
+}
+
+static enum runtime_error ct_pqueue(value v, const char **errmsg, bool write)
+{
+  if (!is_pqueue(v))
+    {
+      *errmsg = "expected priority queue";
+      return error_bad_type;
+    }
+  if (write && readonlyp(v))
+    return error_value_read_only;
+  return error_none;
+}
+
+static enum runtime_error ct_pqentry(value v, const char **errmsg,
+                                     bool write)
+{
+  if (!is_pqentry(v))
+    {
+      *errmsg = "expected priority queue entry";
+      return error_bad_type;
+    }
+  struct pqentry *e = v;
+  if (write && (readonlyp(e) || (e->queue && readonlyp(e->queue))))
+    return error_value_read_only;
+  return error_none;
+}
+
+#define CT_PQUEUE(write) F(TSET(private), ct_pqueue, write)
+#define CT_PQENTRY(write) F(TSET(private), ct_pqentry, write)
+
+static bool entry_less(struct pqentry *a, struct pqentry *b)
+{
+  long pa = intval(a->priority), pb = intval(b->priority);
+  if (pa != pb)
+    return pa < pb;
+  return intval(a->seq) < intval(b->seq);
+}
+
+static void heap_set(struct vector *heap, long i, struct pqentry *e)
+{
+  heap->data[i] = e;
+  e->pos = makeint(i);
+}
+
+static void sift_up(struct vector *heap, long i)
+{
+  struct pqentry *e = heap->data[i];
+  while (i > 0)
+    {
+      long parent = (i - 1) / PQ_ARITY;
+      struct pqentry *pe = heap->data[parent];
+      if (!entry_less(e, pe))
+        break;
+      heap_set(heap, i, pe);
+      i = parent;
+    }
+  heap_set(heap, i, e);
+}
+
+static void sift_down(struct vector *heap, long used, long i)
+{
+  struct pqentry *e = heap->data[i];
+  for (;;)
+    {
+      long first = i * PQ_ARITY + 1;
+      if (first >= used)
+        break;
+      long last = first + PQ_ARITY < used ? first + PQ_ARITY : used;
+      long min = first;
+      for (long c = first + 1; c < last; ++c)
+        if (entry_less(heap->data[c], heap->data[min]))
+          min = c;
+      struct pqentry *me = heap->data[min];
+      if (!entry_less(me, e))
+        break;
+      heap_set(heap, i, me);
+      i = min;
+    }
+  heap_set(heap, i, e);
+}
+
+/* restore the heap property after entry i changed priority */
+static void reposition(struct pqueue *q, long i)
+{
+  if (i > 0 && entry_less(q->heap->data[i],
+                          q->heap->data[(i - 1) / PQ_ARITY]))
+    sift_up(q->heap, i);
+  else
+    sift_down(q->heap, intval(q->used), i);
+}
+
+static void pq_remove(struct pqentry *e)
+{
+  struct pqueue *q = e->queue;
+  struct vector *heap = q->heap;
+  long i = intval(e->pos), last = intval(q->used) - 1;
+  e->queue = NULL;
+  q->used = makeint(last);
+  struct pqentry *le = heap->data[last];
+  heap->data[last] = NULL;
+  if (i == last)
+    return;
+  heap_set(heap, i, le);
+  reposition(q, i);
+}
+
+TYPEDOP(make_priority_queue, ,
+        "-> `q. Returns a new, empty priority queue.",
+        (void), OP_LEAF | OP_NOESCAPE, ".o")
+{
+  struct pqueue *q = (struct pqueue *)alloc_private(PRIVATE_PQUEUE, 3);
+  q->used = q->seq = makeint(0);
+  GCPRO(q);
+  struct vector *heap = alloc_vector(PQ_MIN_SIZE);
+  UNGCPRO();
+  q->heap = heap;
+  return q;
+}
+
+TYPEDOP(priority_queuep, "priority_queue?",
+        "`x -> `b. True if `x is a priority queue.",
+        (value x), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "x.n")
+{
+  return makebool(is_pqueue(x));
+}
+
+TYPEDOP(priority_queue_entryp, "priority_queue_entry?",
+        "`x -> `b. True if `x is a priority queue entry.",
+        (value x), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "x.n")
+{
+  return makebool(is_pqentry(x));
+}
+
+TYPEDOP(priority_queue_entries, ,
+        "`q -> `n. Returns the number of entries in priority queue `q.",
+        (struct pqueue *q), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "o.n")
+{
+  CHECK_TYPES(q, CT_PQUEUE(false));
+  return q->used;
+}
+
+TYPEDOP(priority_queue_add, "priority_queue_add!",
+        "`q `n `x -> `e. Adds `x to priority queue `q with priority `n."
+        " Returns the new entry `e, which can be passed to"
+        " `priority_queue_remove!() and `priority_queue_set_priority!().",
+        (struct pqueue *q, value n, value x), OP_LEAF | OP_NOESCAPE,
+        "onx.o")
+{
+  CHECK_TYPES(q, CT_PQUEUE(true),
+              n, integer,
+              x, any);
+  struct pqentry *e;
+  GCPRO(q, x);
+  long used = intval(q->used);
+  if (used == vector_len(q->heap))
+    {
+      struct vector *heap = alloc_vector(2 * used);
+      memcpy(heap->data, q->heap->data, used * sizeof (value));
+      q->heap = heap;
+    }
+  e = (struct pqentry *)alloc_private(PRIVATE_PQENTRY, 5);
+  UNGCPRO();
+  e->queue = q;
+  e->priority = n;
+  e->seq = q->seq;
+  e->value = x;
+  q->seq = makeint(intval(q->seq) + 1);
+  q->used = makeint(used + 1);
+  q->heap->data[used] = e;
+  sift_up(q->heap, used);
+  return e;
+}
+
+TYPEDOP(priority_queue_first, ,
+        "`q -> `e. Returns the entry with the lowest priority in priority"
+        " queue `q, or false if `q is empty.",
+        (struct pqueue *q), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "o.[oz]")
+{
+  CHECK_TYPES(q, CT_PQUEUE(false));
+  if (q->used == makeint(0))
+    return makebool(false);
+  return q->heap->data[0];
+}
+
+TYPEDOP(priority_queue_pop, "priority_queue_pop!",
+        "`q -> `e. Removes and returns the entry with the lowest priority"
+        " in priority queue `q, or false if `q is empty.",
+        (struct pqueue *q), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "o.[oz]")
+{
+  CHECK_TYPES(q, CT_PQUEUE(true));
+  if (q->used == makeint(0))
+    return makebool(false);
+  struct pqentry *e = q->heap->data[0];
+  pq_remove(e);
+  return e;
+}
+
+TYPEDOP(priority_queue_remove, "priority_queue_remove!",
+        "`e -> `b. Removes priority queue entry `e from its queue. Returns"
+        " true if it was queued.",
+        (struct pqentry *e), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "o.n")
+{
+  CHECK_TYPES(e, CT_PQENTRY(true));
+  if (e->queue == NULL)
+    return makebool(false);
+  pq_remove(e);
+  return makebool(true);
+}
+
+TYPEDOP(priority_queue_set_priority, "priority_queue_set_priority!",
+        "`e `n -> `e. Sets the priority of priority queue entry `e to `n.",
+        (struct pqentry *e, value n), OP_LEAF | OP_NOALLOC | OP_NOESCAPE,
+        "on.1")
+{
+  CHECK_TYPES(e, CT_PQENTRY(true),
+              n, integer);
+  e->priority = n;
+  if (e->queue)
+    reposition(e->queue, intval(e->pos));
+  return e;
+}
+
+TYPEDOP(priority_queue_entry_value, ,
+        "`e -> `x. Returns the value of priority queue entry `e.",
+        (struct pqentry *e), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "o.x")
+{
+  CHECK_TYPES(e, CT_PQENTRY(false));
+  return e->value;
+}
+
+TYPEDOP(priority_queue_entry_priority, ,
+        "`e -> `n. Returns the priority of priority queue entry `e.",
+        (struct pqentry *e), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "o.n")
+{
+  CHECK_TYPES(e, CT_PQENTRY(false));
+  return e->priority;
+}
+
+TYPEDOP(priority_queue_entry_queuedp, "priority_queue_entry_queued?",
+        "`e -> `b. True if priority queue entry `e is still in its queue.",
+        (struct pqentry *e), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "o.n")
+{
+  CHECK_TYPES(e, CT_PQENTRY(false));
+  return makebool(e->queue != NULL);
+}
+
+TYPEDOP(priority_queue_empty, "priority_queue_empty!",
+        "`q -> . Removes all entries from priority queue `q.",
+        (struct pqueue *q), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "o.")
+{
+  CHECK_TYPES(q, CT_PQUEUE(true));
+  for (long i = 0, used = intval(q->used); i < used; ++i)
+    {
+      struct pqentry *e = q->heap->data[i];
+      e->queue = NULL;
+      q->heap->data[i] = NULL;
+    }
+  q->used = makeint(0);
+  undefined();
+}
+
+void pqueue_init(void)
+{
+  DEFINE(make_priority_queue);
+  DEFINE(priority_queuep);
+  DEFINE(priority_queue_entryp);
+  DEFINE(priority_queue_entries);
+  DEFINE(priority_queue_add);
+  DEFINE(priority_queue_first);
+  DEFINE(priority_queue_pop);
+  DEFINE(priority_queue_remove);
+  DEFINE(priority_queue_set_priority);
+  DEFINE(priority_queue_entry_value);
+  DEFINE(priority_queue_entry_priority);
+  DEFINE(priority_queue_entry_queuedp);
+  DEFINE(priority_queue_empty);
+}
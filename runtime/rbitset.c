@@ -0,0 +1,888 @@
+/*
+ * Copyright (c) 1993-2012 David Gay and Gustav Hllberg
+ * All rights reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose, without fee, and without written agreement is hereby granted,
+ * provided that the above copyright notice and the following two paragraphs
+ * appear in all copies of this software.
+ *
+ * IN NO EVENT SHALL DAVID GAY OR GUSTAV HALLBERG BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES ARISING OUT
+ * OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF DAVID GAY OR
+ * GUSTAV HALLBERG HAVE BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * DAVID GAY AND GUSTAV HALLBERG SPECIFICALLY DISCLAIM ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN
+ * "AS IS" BASIS, AND DAVID GAY AND GUSTAV HALLBERG HAVE NO OBLIGATION TO
+ * PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ */
+
+
+#include <stdint.h>
+#include <string.h>
+
+#include "bitset.h"
+#include "check-types.h"
+#include "prims.h"
+#include "rbitset.h"
+
+#include "../alloc.h"
+
+/* Compressed ("roaring") bitsets of integers 0 to RB_MAX, for sets too
+   sparse to store as plain bitsets.
+
+   Members are grouped into chunks of 65536 by their high bits. Each
+   non-empty chunk has a container holding the low 16 bits of its
+   members: a sorted uint16_t array while it has at most ARRAY_MAX
+   members, and a 65536-bit plain bitset once it has more, so the format
+   of a container follows from its cardinality. Arrays may have spare
+   capacity at the end.
+
+   The chunk keys and cardinalities are sorted uint16_t and uint32_t
+   arrays in strings, in step with the vector of containers. */
+
+#define CHUNK_BITS   16
+#define CHUNK_SIZE   (1L << CHUNK_BITS)
+#define LOW_MASK     (CHUNK_SIZE - 1)
+#define ARRAY_MAX    4096
+#define BITMAP_BYTES (CHUNK_SIZE / CHAR_BIT)
+#define MIN_CHUNKS   4
+#define MIN_ARRAY    4
+#define RB_MAX       ((long)(MAX_TAGGED_INT < UINT32_MAX                 \
+                             ? MAX_TAGGED_INT : UINT32_MAX))
+
+struct rbitset {
+  struct mprivate p;
+  value count;                  /* makeint(number of members) */
+  value nchunks;                /* makeint(number of chunks in use) */
+  struct string *keys;          /* uint16_t[]: high bits of each chunk */
+  struct string *cards;         /* uint32_t[]: members of each chunk */
+  struct vector *chunks;        /* container of each chunk */
+};
+
+#ifdef LOCAL_MUDLLE_TYPES
+#undef LOCAL_MUDLLE_TYPES
+#define LOCAL_MUDLLE_TYPES struct rbitset *: true,
+#endif
+
+static bool is_rbitset(value _r)
+{
+  struct rbitset *r = _r;
+  return (TYPE(r, private)
+          && r->p.ptype == makeint(PRIVATE_RBITSET));
+}
+
+static enum runtime_error ct_rbitset(value v, const char **errmsg,
+                                     bool write)
+{
+  if (!is_rbitset(v))
+    {
+      *errmsg = "expected compressed bitset";
+      return error_bad_type;
+    }
+  if (write && readonlyp(v))
+    return error_value_read_only;
+  return error_none;
+}
+
+#define CT_RBITSET(write) F(TSET(private), ct_rbitset, write)
+#define CT_MEMBER(dst) CT_RANGE(dst, 0, RB_MAX)
+
+static uint16_t *rb_keys(struct rbitset *r)
+{
+  return (uint16_t *)r->keys->str;
+}
+
+static uint32_t *rb_cards(struct rbitset *r)
+{
+  return (uint32_t *)r->cards->str;
+}
+
+static struct string *rb_chunk(struct rbitset *r, long i)
+{
+  return r->chunks->data[i];
+}
+
+static uint16_t *chunk_array(struct rbitset *r, long i)
+{
+  return (uint16_t *)rb_chunk(r, i)->str;
+}
+
+static bool is_bitmap(uint32_t card)
+{
+  return card > ARRAY_MAX;
+}
+
+static bool bitmap_has(const char *bits, uint16_t low)
+{
+  return bits[low / CHAR_BIT] & P(low % CHAR_BIT);
+}
+
+static size_t container_bytes(uint32_t card)
+{
+  return is_bitmap(card) ? BITMAP_BYTES : card * sizeof (uint16_t);
+}
+
+static struct rbitset *alloc_rbitset(long size)
+{
+  struct rbitset *r = NULL;
+  struct string *keys = NULL, *cards = NULL;
+  GCPRO(r, keys, cards);
+  keys = alloc_empty_string(size * sizeof (uint16_t));
+  cards = alloc_empty_string(size * sizeof (uint32_t));
+  struct vector *chunks = alloc_vector(size);
+  r = (struct rbitset *)alloc_private(PRIVATE_RBITSET, 5);
+  UNGCPRO();
+  r->count = r->nchunks = makeint(0);
+  r->keys = keys;
+  r->cards = cards;
+  r->chunks = chunks;
+  return r;
+}
+
+/* returns the first index in a[0 .. n - 1] whose entry is >= x */
+static long lower_bound16(const uint16_t *a, long n, uint16_t x)
+{
+  long lo = 0, hi = n;
+  while (lo < hi)
+    {
+      long mid = (lo + hi) / 2;
+      if (a[mid] < x)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+  return lo;
+}
+
+/* sets *pos to the index of the chunk with 'key', or where to insert it */
+static bool find_chunk(struct rbitset *r, uint16_t key, long *pos)
+{
+  long n = intval(r->nchunks);
+  *pos = lower_bound16(rb_keys(r), n, key);
+  return *pos < n && rb_keys(r)[*pos] == key;
+}
+
+static bool chunk_has(struct rbitset *r, long i, uint16_t low)
+{
+  uint32_t card = rb_cards(r)[i];
+  if (is_bitmap(card))
+    return bitmap_has(rb_chunk(r, i)->str, low);
+  long j = lower_bound16(chunk_array(r, i), card, low);
+  return j < card && chunk_array(r, i)[j] == low;
+}
+
+/* inserts an empty chunk for 'key' at 'pos'; may move r */
+static void insert_chunk(struct rbitset *r, long pos, uint16_t key)
+{
+  struct string *keys = NULL, *cards = NULL, *c = NULL;
+  GCPRO(r, keys, cards, c);
+  long n = intval(r->nchunks);
+  if (n == vector_len(r->chunks))
+    {
+      keys = alloc_empty_string(2 * n * sizeof (uint16_t));
+      cards = alloc_empty_string(2 * n * sizeof (uint32_t));
+      struct vector *chunks = alloc_vector(2 * n);
+      memcpy(keys->str, r->keys->str, n * sizeof (uint16_t));
+      memcpy(cards->str, r->cards->str, n * sizeof (uint32_t));
+      memcpy(chunks->data, r->chunks->data, n * sizeof (value));
+      r->keys = keys;
+      r->cards = cards;
+      r->chunks = chunks;
+    }
+  c = alloc_empty_string(MIN_ARRAY * sizeof (uint16_t));
+  UNGCPRO();
+  memmove(rb_keys(r) + pos + 1, rb_keys(r) + pos,
+          (n - pos) * sizeof (uint16_t));
+  memmove(rb_cards(r) + pos + 1, rb_cards(r) + pos,
+          (n - pos) * sizeof (uint32_t));
+  memmove(r->chunks->data + pos + 1, r->chunks->data + pos,
+          (n - pos) * sizeof (value));
+  rb_keys(r)[pos] = key;
+  rb_cards(r)[pos] = 0;
+  r->chunks->data[pos] = c;
+  r->nchunks = makeint(n + 1);
+}
+
+static void remove_chunk(struct rbitset *r, long pos)
+{
+  long n = intval(r->nchunks) - 1;
+  memmove(rb_keys(r) + pos, rb_keys(r) + pos + 1,
+          (n - pos) * sizeof (uint16_t));
+  memmove(rb_cards(r) + pos, rb_cards(r) + pos + 1,
+          (n - pos) * sizeof (uint32_t));
+  memmove(r->chunks->data + pos, r->chunks->data + pos + 1,
+          (n - pos) * sizeof (value));
+  r->chunks->data[n] = NULL;
+  r->nchunks = makeint(n);
+}
+
+/* writes the members of a bitmap container to 'dst' */
+static void bitmap_to_array(uint16_t *dst, const char *bits)
+{
+  for (long i = bits_next(bits, BITMAP_BYTES, 0);
+       i >= 0;
+       i = bits_next(bits, BITMAP_BYTES, i + 1))
+    *dst++ = i;
+}
+
+static void array_to_bitmap(char *bits, const uint16_t *a, uint32_t card)
+{
+  memset(bits, 0, BITMAP_BYTES);
+  for (uint32_t i = 0; i < card; ++i)
+    bits[a[i] / CHAR_BIT] |= P(a[i] % CHAR_BIT);
+}
+
+/* adds 'low' to chunk i, which does not have it; may move r */
+static void chunk_add(struct rbitset *r, long i, uint16_t low)
+{
+  uint32_t card = rb_cards(r)[i];
+  if (is_bitmap(card))
+    {
+      rb_chunk(r, i)->str[low / CHAR_BIT] |= P(low % CHAR_BIT);
+      ++rb_cards(r)[i];
+      return;
+    }
+
+  long cap = string_len(rb_chunk(r, i)) / sizeof (uint16_t);
+  if (card == ARRAY_MAX || card == cap)
+    {
+      long size;
+      if (card == ARRAY_MAX)
+        size = BITMAP_BYTES;
+      else if (cap < MIN_ARRAY)
+        size = MIN_ARRAY * sizeof (uint16_t);
+      else
+        size = (2 * cap < ARRAY_MAX ? 2 * cap : ARRAY_MAX) * sizeof (uint16_t);
+      GCPRO(r);
+      struct string *c = alloc_empty_string(size);
+      UNGCPRO();
+      if (card == ARRAY_MAX)
+        array_to_bitmap(c->str, chunk_array(r, i), card);
+      else
+        memcpy(c->str, rb_chunk(r, i)->str, card * sizeof (uint16_t));
+      r->chunks->data[i] = c;
+      if (card == ARRAY_MAX)
+        {
+          c->str[low / CHAR_BIT] |= P(low % CHAR_BIT);
+          ++rb_cards(r)[i];
+          return;
+        }
+    }
+
+  uint16_t *a = chunk_array(r, i);
+  long j = lower_bound16(a, card, low);
+  memmove(a + j + 1, a + j, (card - j) * sizeof (uint16_t));
+  a[j] = low;
+  ++rb_cards(r)[i];
+}
+
+/* removes 'low' from chunk i, which has it; may move r */
+static void chunk_remove(struct rbitset *r, long i, uint16_t low)
+{
+  uint32_t card = --rb_cards(r)[i];
+  if (card == 0)
+    {
+      remove_chunk(r, i);
+      return;
+    }
+  if (!is_bitmap(card + 1))
+    {
+      uint16_t *a = chunk_array(r, i);
+      long j = lower_bound16(a, card + 1, low);
+      memmove(a + j, a + j + 1, (card - j) * sizeof (uint16_t));
+      return;
+    }
+
+  rb_chunk(r, i)->str[low / CHAR_BIT] &= ~P(low % CHAR_BIT);
+  if (is_bitmap(card))
+    return;
+  GCPRO(r);
+  struct string *c = alloc_empty_string(ARRAY_MAX * sizeof (uint16_t));
+  UNGCPRO();
+  bitmap_to_array((uint16_t *)c->str, rb_chunk(r, i)->str);
+  r->chunks->data[i] = c;
+}
+
+/* appends a chunk whose container is at the start of 'scratch' to 'r',
+   which must have room for it */
+static void append_chunk(struct rbitset *r, uint16_t key, uint32_t card,
+                         struct string *scratch)
+{
+  size_t size = container_bytes(card);
+  GCPRO(r, scratch);
+  struct string *c = alloc_empty_string(size);
+  UNGCPRO();
+  memcpy(c->str, scratch->str, size);
+  long n = intval(r->nchunks);
+  rb_keys(r)[n] = key;
+  rb_cards(r)[n] = card;
+  r->chunks->data[n] = c;
+  r->nchunks = makeint(n + 1);
+  r->count = makeint(intval(r->count) + card);
+}
+
+/* Scratch space for one container, followed by as much again for
+   converting between formats */
+#define SCRATCH_BYTES (2 * BITMAP_BYTES)
+
+/* turns the bitmap in 'out' into an array if it is small enough;
+   returns its cardinality */
+static uint32_t finish_bitmap(char *out)
+{
+  uint32_t card = bits_count(out, BITMAP_BYTES);
+  if (!is_bitmap(card))
+    {
+      bitmap_to_array((uint16_t *)(out + BITMAP_BYTES), out);
+      memcpy(out, out + BITMAP_BYTES, card * sizeof (uint16_t));
+    }
+  return card;
+}
+
+enum rb_op { RB_UNION, RB_INTERSECTION, RB_DIFFERENCE };
+
+/* merges two array containers into 'out', which is big enough for the
+   result; returns its cardinality */
+static uint32_t merge_arrays(const uint16_t *a, uint32_t na,
+                             const uint16_t *b, uint32_t nb,
+                             enum rb_op op, uint16_t *out)
+{
+  uint32_t i = 0, j = 0, n = 0;
+  while (i < na && j < nb)
+    if (a[i] < b[j])
+      {
+        if (op != RB_INTERSECTION)
+          out[n++] = a[i];
+        ++i;
+      }
+    else if (a[i] > b[j])
+      {
+        if (op == RB_UNION)
+          out[n++] = b[j];
+        ++j;
+      }
+    else
+      {
+        if (op != RB_DIFFERENCE)
+          out[n++] = a[i];
+        ++i;
+        ++j;
+      }
+  if (op != RB_INTERSECTION)
+    for (; i < na; ++i)
+      out[n++] = a[i];
+  if (op == RB_UNION)
+    for (; j < nb; ++j)
+      out[n++] = b[j];
+  return n;
+}
+
+/* keeps the members of array 'a' that are (or, if 'keep' is false, are
+   not) in bitmap 'bits' */
+static uint32_t filter_array(const uint16_t *a, uint32_t na,
+                             const char *bits, bool keep, uint16_t *out)
+{
+  uint32_t n = 0;
+  for (uint32_t i = 0; i < na; ++i)
+    if (bitmap_has(bits, a[i]) == keep)
+      out[n++] = a[i];
+  return n;
+}
+
+/* computes a op b into 'out' (SCRATCH_BYTES large); returns the
+   cardinality of the result */
+static uint32_t combine_chunks(const char *a, uint32_t na,
+                               const char *b, uint32_t nb,
+                               enum rb_op op, char *out)
+{
+  bool abits = is_bitmap(na), bbits = is_bitmap(nb);
+  const uint16_t *aa = (const uint16_t *)a, *ba = (const uint16_t *)b;
+  uint16_t *oa = (uint16_t *)out;
+
+  switch (op)
+    {
+    case RB_UNION:
+      if (!abits && !bbits && na + nb <= ARRAY_MAX)
+        return merge_arrays(aa, na, ba, nb, op, oa);
+      if (!abits && bbits)
+        {
+          const char *t = a; a = b; b = t;
+          uint32_t tn = na; na = nb; nb = tn;
+          abits = true;
+          bbits = false;
+        }
+      if (abits)
+        memcpy(out, a, BITMAP_BYTES);
+      else
+        array_to_bitmap(out, (const uint16_t *)a, na);
+      if (bbits)
+        bits_or(out, b, out, BITMAP_BYTES);
+      else
+        for (uint32_t i = 0; i < nb; ++i)
+          {
+            uint16_t low = ((const uint16_t *)b)[i];
+            out[low / CHAR_BIT] |= P(low % CHAR_BIT);
+          }
+      return finish_bitmap(out);
+    case RB_INTERSECTION:
+      if (!abits && !bbits)
+        return merge_arrays(aa, na, ba, nb, op, oa);
+      if (!abits)
+        return filter_array(aa, na, b, true, oa);
+      if (!bbits)
+        return filter_array(ba, nb, a, true, oa);
+      bits_and(a, b, out, BITMAP_BYTES);
+      return finish_bitmap(out);
+    case RB_DIFFERENCE:
+      if (!abits && !bbits)
+        return merge_arrays(aa, na, ba, nb, op, oa);
+      if (!abits)
+        return filter_array(aa, na, b, false, oa);
+      if (bbits)
+        bits_andnot(a, b, out, BITMAP_BYTES);
+      else
+        {
+          memcpy(out, a, BITMAP_BYTES);
+          for (uint32_t i = 0; i < nb; ++i)
+            out[ba[i] / CHAR_BIT] &= ~P(ba[i] % CHAR_BIT);
+        }
+      return finish_bitmap(out);
+    }
+  abort();
+}
+
+static struct rbitset *rbitset_binop(struct rbitset *a, struct rbitset *b,
+                                     enum rb_op op)
+{
+  struct rbitset *r = NULL;
+  struct string *scratch = NULL;
+  GCPRO(a, b, r, scratch);
+  long na = intval(a->nchunks), nb = intval(b->nchunks);
+  long size = op == RB_UNION ? na + nb : na;
+  r = alloc_rbitset(size < MIN_CHUNKS ? MIN_CHUNKS : size);
+  scratch = alloc_empty_string(SCRATCH_BYTES);
+
+  /* walk both sets in key order */
+  for (long i = 0, j = 0; i < na || j < nb; )
+    {
+      long ka = i < na ? rb_keys(a)[i] : CHUNK_SIZE;
+      long kb = j < nb ? rb_keys(b)[j] : CHUNK_SIZE;
+      uint32_t card;
+      if (ka != kb)
+        {
+          struct rbitset *from = ka < kb ? a : b;
+          long k = ka < kb ? i++ : j++;
+          if (op == RB_INTERSECTION || (op == RB_DIFFERENCE && from == b))
+            continue;
+          card = rb_cards(from)[k];
+          memcpy(scratch->str, rb_chunk(from, k)->str,
+                 container_bytes(card));
+        }
+      else
+        {
+          card = combine_chunks(rb_chunk(a, i)->str, rb_cards(a)[i],
+                                rb_chunk(b, j)->str, rb_cards(b)[j],
+                                op, scratch->str);
+          ++i;
+          ++j;
+          if (card == 0)
+            continue;
+        }
+      append_chunk(r, ka < kb ? ka : kb, card, scratch);
+    }
+  UNGCPRO();
+  return r;
+}
+
+static bool rbitset_equal(struct rbitset *a, struct rbitset *b)
+{
+  long n = intval(a->nchunks);
+  if (a->count != b->count || n != intval(b->nchunks)
+      || memcmp(rb_keys(a), rb_keys(b), n * sizeof (uint16_t))
+      || memcmp(rb_cards(a), rb_cards(b), n * sizeof (uint32_t)))
+    return false;
+  for (long i = 0; i < n; ++i)
+    {
+      uint32_t card = rb_cards(a)[i];
+      if (is_bitmap(card)
+          ? !bits_equal(rb_chunk(a, i)->str, rb_chunk(b, i)->str,
+                        BITMAP_BYTES)
+          : memcmp(rb_chunk(a, i)->str, rb_chunk(b, i)->str,
+                   card * sizeof (uint16_t)))
+        return false;
+    }
+  return true;
+}
+
+/* true if a is a subset of b, or, if 'any' is set, if a and b
+   intersect */
+static bool rbitset_compare(struct rbitset *a, struct rbitset *b, bool any)
+{
+  if (!any && intval(a->count) > intval(b->count))
+    return false;
+  for (long i = 0, n = intval(a->nchunks); i < n; ++i)
+    {
+      long j;
+      if (!find_chunk(b, rb_keys(a)[i], &j))
+        {
+          if (any)
+            continue;
+          return false;
+        }
+      uint32_t na = rb_cards(a)[i], nb = rb_cards(b)[j];
+      if (is_bitmap(na) && is_bitmap(nb))
+        {
+          const char *abits = rb_chunk(a, i)->str;
+          const char *bbits = rb_chunk(b, j)->str;
+          if (any ? bits_intersect(abits, bbits, BITMAP_BYTES)
+              : !bits_subset(abits, bbits, BITMAP_BYTES))
+            return any;
+          continue;
+        }
+      if (!any && na > nb)
+        return false;
+      /* look up the members of whichever container is an array */
+      struct rbitset *from = is_bitmap(na) ? b : a;
+      struct rbitset *in = is_bitmap(na) ? a : b;
+      long k = is_bitmap(na) ? j : i, l = is_bitmap(na) ? i : j;
+      const uint16_t *members = chunk_array(from, k);
+      for (uint32_t m = 0, card = rb_cards(from)[k]; m < card; ++m)
+        if (chunk_has(in, l, members[m]) == any)
+          return any;
+    }
+  return !any;
+}
+
+static long chunk_next(struct rbitset *r, long i, uint16_t low)
+{
+  long base = (long)rb_keys(r)[i] << CHUNK_BITS;
+  uint32_t card = rb_cards(r)[i];
+  if (is_bitmap(card))
+    {
+      long n = bits_next(rb_chunk(r, i)->str, BITMAP_BYTES, low);
+      return n < 0 ? -1 : base + n;
+    }
+  const uint16_t *a = chunk_array(r, i);
+  long j = lower_bound16(a, card, low);
+  return j < card ? base + a[j] : -1;
+}
+
+/* returns the largest member of r, or -1 if it is empty */
+static long rbitset_max(struct rbitset *r)
+{
+  long n = intval(r->nchunks);
+  if (n == 0)
+    return -1;
+  long base = (long)rb_keys(r)[n - 1] << CHUNK_BITS;
+  uint32_t card = rb_cards(r)[n - 1];
+  if (!is_bitmap(card))
+    return base + chunk_array(r, n - 1)[card - 1];
+  const unsigned char *bits = (const unsigned char *)rb_chunk(r, n - 1)->str;
+  long i = BITMAP_BYTES - 1;
+  while (bits[i] == 0)
+    --i;
+  return base + i * CHAR_BIT + 31 - __builtin_clz(bits[i]);
+}
+
+TYPEDOP(make_rbitset, ,
+        "-> `r. Returns a new, empty compressed bitset.",
+        (void), OP_LEAF | OP_NOESCAPE, ".o")
+{
+  return alloc_rbitset(MIN_CHUNKS);
+}
+
+TYPEDOP(rbitsetp, "rbitset?",
+        "`x -> `b. True if `x is a compressed bitset.",
+        (value x), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "x.n")
+{
+  return makebool(is_rbitset(x));
+}
+
+TYPEDOP(rbitset_addb, "rbitset_add!",
+        "`r `n -> `b. Adds `n to compressed bitset `r. Returns true if"
+        " `n was not already a member.",
+        (struct rbitset *r, value n), OP_LEAF | OP_NOESCAPE, "on.n")
+{
+  long x;
+  CHECK_TYPES(r, CT_RBITSET(true),
+              n, CT_MEMBER(x));
+  long pos;
+  if (find_chunk(r, x >> CHUNK_BITS, &pos))
+    {
+      if (chunk_has(r, pos, x & LOW_MASK))
+        return makebool(false);
+    }
+  else
+    {
+      GCPRO(r);
+      insert_chunk(r, pos, x >> CHUNK_BITS);
+      UNGCPRO();
+    }
+  GCPRO(r);
+  chunk_add(r, pos, x & LOW_MASK);
+  UNGCPRO();
+  r->count = makeint(intval(r->count) + 1);
+  return makebool(true);
+}
+
+TYPEDOP(rbitset_removeb, "rbitset_remove!",
+        "`r `n -> `b. Removes `n from compressed bitset `r. Returns true"
+        " if `n was a member.",
+        (struct rbitset *r, value n), OP_LEAF | OP_NOESCAPE, "on.n")
+{
+  long x;
+  CHECK_TYPES(r, CT_RBITSET(true),
+              n, CT_MEMBER(x));
+  long pos;
+  if (!find_chunk(r, x >> CHUNK_BITS, &pos)
+      || !chunk_has(r, pos, x & LOW_MASK))
+    return makebool(false);
+  GCPRO(r);
+  chunk_remove(r, pos, x & LOW_MASK);
+  UNGCPRO();
+  r->count = makeint(intval(r->count) - 1);
+  return makebool(true);
+}
+
+TYPEDOP(rbitset_hasp, "rbitset_has?",
+        "`r `n -> `b. True if `n is a member of compressed bitset `r.",
+        (struct rbitset *r, value n),
+        OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "on.n")
+{
+  long x;
+  CHECK_TYPES(r, CT_RBITSET(false),
+              n, CT_MEMBER(x));
+  long pos;
+  return makebool(find_chunk(r, x >> CHUNK_BITS, &pos)
+                  && chunk_has(r, pos, x & LOW_MASK));
+}
+
+TYPEDOP(rbitset_count, ,
+        "`r -> `n. Returns the number of members of compressed bitset `r.",
+        (struct rbitset *r), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "o.n")
+{
+  CHECK_TYPES(r, CT_RBITSET(false));
+  return r->count;
+}
+
+TYPEDOP(rbitset_emptyp, "rbitset_empty?",
+        "`r -> `b. True if compressed bitset `r has no members.",
+        (struct rbitset *r), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "o.n")
+{
+  CHECK_TYPES(r, CT_RBITSET(false));
+  return makebool(r->count == makeint(0));
+}
+
+TYPEDOP(rbitset_clearb, "rbitset_clear!",
+        "`r -> `r. Removes all members of compressed bitset `r.",
+        (struct rbitset *r), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "o.1")
+{
+  CHECK_TYPES(r, CT_RBITSET(true));
+  for (long i = 0, n = intval(r->nchunks); i < n; ++i)
+    r->chunks->data[i] = NULL;
+  r->nchunks = r->count = makeint(0);
+  return r;
+}
+
+TYPEDOP(rbitset_next, ,
+        "`r `n -> `n. Returns the smallest member of compressed bitset"
+        " `r that is at least `n, or -1 if there is none.",
+        (struct rbitset *r, value n),
+        OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "on.n")
+{
+  long from;
+  CHECK_TYPES(r, CT_RBITSET(false),
+              n, CT_RANGE(from, 0, MAX_TAGGED_INT));
+  if (from > RB_MAX)
+    return makeint(-1);
+  long pos;
+  if (find_chunk(r, from >> CHUNK_BITS, &pos))
+    {
+      long x = chunk_next(r, pos, from & LOW_MASK);
+      if (x >= 0)
+        return makeint(x);
+      ++pos;
+    }
+  return makeint(pos < intval(r->nchunks) ? chunk_next(r, pos, 0) : -1);
+}
+
+TYPEDOP(rbitset_list, ,
+        "`r -> `l. Returns the members of compressed bitset `r as a list,"
+        " in increasing order.",
+        (struct rbitset *r), OP_LEAF | OP_NOESCAPE, "o.l")
+{
+  CHECK_TYPES(r, CT_RBITSET(false));
+  struct list *l = NULL;
+  GCPRO(r, l);
+  for (long i = intval(r->nchunks); i-- > 0; )
+    {
+      long base = (long)rb_keys(r)[i] << CHUNK_BITS;
+      uint32_t card = rb_cards(r)[i];
+      if (is_bitmap(card))
+        {
+          for (long low = CHUNK_SIZE; low-- > 0; )
+            if (bitmap_has(rb_chunk(r, i)->str, low))
+              l = alloc_list(makeint(base + low), l);
+        }
+      else
+        for (long j = card; j-- > 0; )
+          l = alloc_list(makeint(base + chunk_array(r, i)[j]), l);
+    }
+  UNGCPRO();
+  return l;
+}
+
+TYPEDOP(rbitset_union, ,
+        "`r1 `r2 -> `r3. Returns a new compressed bitset `r3 ="
+        " `r1 U `r2.",
+        (struct rbitset *r1, struct rbitset *r2), OP_LEAF | OP_NOESCAPE,
+        "oo.o")
+{
+  CHECK_TYPES(r1, CT_RBITSET(false),
+              r2, CT_RBITSET(false));
+  return rbitset_binop(r1, r2, RB_UNION);
+}
+
+TYPEDOP(rbitset_intersection, ,
+        "`r1 `r2 -> `r3. Returns a new compressed bitset `r3 ="
+        " `r1 /\\ `r2.",
+        (struct rbitset *r1, struct rbitset *r2), OP_LEAF | OP_NOESCAPE,
+        "oo.o")
+{
+  CHECK_TYPES(r1, CT_RBITSET(false),
+              r2, CT_RBITSET(false));
+  return rbitset_binop(r1, r2, RB_INTERSECTION);
+}
+
+TYPEDOP(rbitset_difference, ,
+        "`r1 `r2 -> `r3. Returns a new compressed bitset `r3 ="
+        " `r1 - `r2.",
+        (struct rbitset *r1, struct rbitset *r2), OP_LEAF | OP_NOESCAPE,
+        "oo.o")
+{
+  CHECK_TYPES(r1, CT_RBITSET(false),
+              r2, CT_RBITSET(false));
+  return rbitset_binop(r1, r2, RB_DIFFERENCE);
+}
+
+TYPEDOP(rbitset_eqp, "rbitset_eq?",
+        "`r1 `r2 -> `b. True if compressed bitsets `r1 and `r2 have the"
+        " same members.",
+        (struct rbitset *r1, struct rbitset *r2),
+        OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "oo.n")
+{
+  CHECK_TYPES(r1, CT_RBITSET(false),
+              r2, CT_RBITSET(false));
+  return makebool(rbitset_equal(r1, r2));
+}
+
+TYPEDOP(rbitset_inp, "rbitset_in?",
+        "`r1 `r2 -> `b. True if compressed bitset `r1 is a subset of"
+        " `r2.",
+        (struct rbitset *r1, struct rbitset *r2),
+        OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "oo.n")
+{
+  CHECK_TYPES(r1, CT_RBITSET(false),
+              r2, CT_RBITSET(false));
+  return makebool(rbitset_compare(r1, r2, false));
+}
+
+TYPEDOP(rbitset_intersectsp, "rbitset_intersects?",
+        "`r1 `r2 -> `b. True if compressed bitsets `r1 and `r2 have a"
+        " member in common.",
+        (struct rbitset *r1, struct rbitset *r2),
+        OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "oo.n")
+{
+  CHECK_TYPES(r1, CT_RBITSET(false),
+              r2, CT_RBITSET(false));
+  return makebool(rbitset_compare(r1, r2, true));
+}
+
+TYPEDOP(bitset_to_rbitset, ,
+        "`bitset -> `r. Returns a new compressed bitset with the bits"
+        " set in `bitset.",
+        (struct string *b), OP_LEAF | OP_NOESCAPE, "s.o")
+{
+  CHECK_TYPES(b, string);
+  long bytes = string_len(b);
+  long n = (bytes + BITMAP_BYTES - 1) / BITMAP_BYTES;
+  struct rbitset *r = NULL;
+  struct string *scratch = NULL;
+  GCPRO(b, r, scratch);
+  r = alloc_rbitset(n < MIN_CHUNKS ? MIN_CHUNKS : n);
+  scratch = alloc_empty_string(SCRATCH_BYTES);
+  for (long i = 0; i < n; ++i)
+    {
+      long start = i * BITMAP_BYTES;
+      long size = bytes - start < BITMAP_BYTES ? bytes - start : BITMAP_BYTES;
+      memcpy(scratch->str, b->str + start, size);
+      memset(scratch->str + size, 0, BITMAP_BYTES - size);
+      uint32_t card = finish_bitmap(scratch->str);
+      if (card > 0)
+        append_chunk(r, i, card, scratch);
+    }
+  UNGCPRO();
+  return r;
+}
+
+TYPEDOP(rbitset_to_bitset, ,
+        "`r `n -> `bitset. Returns a new bitset of at least `n bits with"
+        " the members of compressed bitset `r set. All members of `r"
+        " must be less than `n.",
+        (struct rbitset *r, value n), OP_LEAF | OP_NOESCAPE, "on.s")
+{
+  long nbits;
+  CHECK_TYPES(r, CT_RBITSET(false),
+              n, CT_RANGE(nbits, 0, MAX_STRING_SIZE * CHAR_BIT));
+  if (rbitset_max(r) >= nbits)
+    RUNTIME_ERROR(error_bad_value, "bitset too small");
+  long bytes = (nbits + CHAR_BIT - 1) / CHAR_BIT;
+  GCPRO(r);
+  struct string *b = alloc_empty_string(bytes);
+  UNGCPRO();
+  memset(b->str, 0, bytes);
+  for (long i = 0, nchunks = intval(r->nchunks); i < nchunks; ++i)
+    {
+      long base = (long)rb_keys(r)[i] << CHUNK_BITS;
+      uint32_t card = rb_cards(r)[i];
+      if (is_bitmap(card))
+        {
+          long start = base / CHAR_BIT;
+          long size = (bytes - start < BITMAP_BYTES
+                       ? bytes - start : BITMAP_BYTES);
+          memcpy(b->str + start, rb_chunk(r, i)->str, size);
+          continue;
+        }
+      const uint16_t *a = chunk_array(r, i);
+      for (uint32_t j = 0; j < card; ++j)
+        {
+          long x = base + a[j];
+          b->str[x / CHAR_BIT] |= P(x % CHAR_BIT);
+        }
+    }
+  return b;
+}
+
+void rbitset_init(void)
+{
+  DEFINE(make_rbitset);
+  DEFINE(rbitsetp);
+  DEFINE(rbitset_addb);
+  DEFINE(rbitset_removeb);
+  DEFINE(rbitset_hasp);
+  DEFINE(rbitset_count);
+  DEFINE(rbitset_emptyp);
+  DEFINE(rbitset_clearb);
+  DEFINE(rbitset_next);
+  DEFINE(rbitset_list);
+  DEFINE(rbitset_union);
+  DEFINE(rbitset_intersection);
+  DEFINE(rbitset_difference);
+  DEFINE(rbitset_eqp);
+  DEFINE(rbitset_inp);
+  DEFINE(rbitset_intersectsp);
+  DEFINE(bitset_to_rbitset);
+  DEFINE(rbitset_to_bitset);
+}
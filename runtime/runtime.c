@@ -42,17 +42,25 @@
 #include "bigint.h"
 #include "bitset.h"
 #include "bool.h"
+#include "btree.h"
+#include "csrgraph.h"
 #include "debug.h"
+#include "deque.h"
 #include "files.h"
+#include "hashmap.h"
 #include "io.h"
 #include "list.h"
 #include "mudlle-float.h"
 #include "mudlle-string.h"
 #include "mudlle-xml.h"
 #include "pattern.h"
+#include "pqueue.h"
+#include "rbitset.h"
 #include "runtime.h"
 #include "support.h"
 #include "symbol.h"
+#include "twheel.h"
+#include "typedarray.h"
 #include "vector.h"
 
 
@@ -523,6 +531,14 @@ void runtime_init(void)
   float_init();
   bigint_init();
   pattern_init();
+  hashmap_init();
+  btree_init();
+  pqueue_init();
+  twheel_init();
+  deque_init();
+  csrgraph_init();
+  rbitset_init();
+  typedarray_init();
   mudlle_consts_init();
   xml_init();
   module_set("system", module_protected, 0);
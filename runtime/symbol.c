@@ -29,6 +29,17 @@
 #include "../call.h"
 #include "../table.h"
 
+struct titer {
+  struct mprivate p;
+  struct table *table;
+  value changes;                /* table->changes when iteration started */
+  value pos;                    /* next table->buckets[] entry */
+};
+
+#ifdef LOCAL_MUDLLE_TYPES
+#undef LOCAL_MUDLLE_TYPES
+#define LOCAL_MUDLLE_TYPES struct titer *: true,
+#endif
 
 TYPEDOP(symbolp, "symbol?", "`x -> `b. True if `x is a symbol.", (value v),
 	OP_LEAF | OP_NOALLOC | OP_NOESCAPE | OP_STR_READONLY, "x.n")
@@ -321,6 +332,83 @@ TYPEDOP(table_existsp, "table_exists?",
   return res;
 }
 
+static bool is_titer(value _ti)
+{
+  struct titer *ti = _ti;
+  return (TYPE(ti, private)
+          && ti->p.ptype == makeint(PRIVATE_TITER));
+}
+
+static enum runtime_error ct_titer(value v, const char **errmsg, int unused)
+{
+  if (is_titer(v))
+    return error_none;
+  *errmsg = "expected table iterator";
+  return error_bad_type;
+}
+
+#define CT_TITER F(TSET(private), ct_titer, 0)
+
+static void start_titer(struct titer *ti, struct table *table)
+{
+  table_finish_resize(table);
+  ti->table = table;
+  ti->changes = table->changes;
+  ti->pos = makeint(0);
+}
+
+TYPEDOP(make_table_iterator, ,
+        "`table -> `ti. Returns an iterator over the non-null symbols of"
+        " `table. Use `table_iterator_next!() to step through them without"
+        " allocating.\n"
+        "Adding or removing entries in `table makes the next step fail;"
+        " changing symbol values is safe.",
+        (struct table *table), OP_LEAF | OP_NOESCAPE, "t.o")
+{
+  CHECK_TYPES(table, table);
+  GCPRO(table);
+  struct titer *ti = (struct titer *)alloc_private(PRIVATE_TITER, 3);
+  UNGCPRO();
+  start_titer(ti, table);
+  return ti;
+}
+
+TYPEDOP(table_iteratorp, "table_iterator?",
+        "`x -> `b. True if `x is a table iterator.",
+        (value x), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "x.n")
+{
+  return makebool(is_titer(x));
+}
+
+TYPEDOP(table_iterator_reset, "table_iterator_reset!",
+        "`ti `table -> . Restarts table iterator `ti from the beginning of"
+        " `table.",
+        (struct titer *ti, struct table *table),
+        OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "ot.")
+{
+  CHECK_TYPES(ti,    CT_TITER,
+              table, table);
+  start_titer(ti, table);
+  undefined();
+}
+
+TYPEDOP(table_iterator_next, "table_iterator_next!",
+        "`ti -> `x. Returns the next non-null symbol of table iterator `ti,"
+        " or false when there are no more. The order is arbitrary.\n"
+        "Causes an error if entries have been added to or removed from"
+        " the table since the iteration started.",
+        (struct titer *ti), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "o.[yz]")
+{
+  CHECK_TYPES(ti, CT_TITER);
+  struct table *table = ti->table;
+  if (table->changes != ti->changes)
+    RUNTIME_ERROR(error_bad_value, "table modified during iteration");
+  ulong pos = intval(ti->pos);
+  struct symbol *sym = table_next(table, &pos);
+  ti->pos = makeint(pos);
+  return sym ? sym : makebool(false);
+}
+
 TYPEDOP(table_vector, ,
         "`table -> `v. Returns a vector of the non-null entries in `table.",
 	(struct table *table),
@@ -344,7 +432,9 @@ TYPEDOP(table_vector, ,
 
 TYPEDOP(table_prefix, , "`table `s -> `l. Returns list of all symbols in"
         " `table whose value is non-null and whose name starts with `s.\n"
-        "For non-ctables, case and accentuation are ignored.",
+        "For non-ctables, case and accentuation are ignored.\n"
+        "If `table has a prefix index, the list is sorted by name."
+        " Cf. `table_prefix_index!().",
         (struct table *table, struct string *name),
         OP_LEAF | OP_NOESCAPE | OP_STR_READONLY, "ts.l")
 {
@@ -353,6 +443,24 @@ TYPEDOP(table_prefix, , "`table `s -> `l. Returns list of all symbols in"
   return table_prefix(table, name);
 }
 
+TYPEDOP(table_prefix_index, "table_prefix_index!",
+        "`table `b -> . If `b is true, makes `table keep a sorted index of"
+        " its names, so that `table_prefix() takes time proportional to the"
+        " length of the prefix and the number of results rather than to"
+        " the size of `table. The index is updated as entries are added"
+        " or removed.\n"
+        "If `b is false, drops the index.",
+        (struct table *table, value enable),
+        OP_LEAF | OP_NOESCAPE, "tx.")
+{
+  CHECK_TYPES(table,  table,
+              enable, any);
+  if (obj_readonlyp(&table->o))
+    runtime_error(error_value_read_only);
+  table_set_prefix_index(table, istrue(enable));
+  undefined();
+}
+
 EXT_TYPEDOP(table_ref, ,
             "`table `s -> `x. Returns the value of `s in `table, or null",
 	    (struct table *table, struct string *s), (table, s),
@@ -360,6 +468,7 @@ EXT_TYPEDOP(table_ref, ,
 {
   CHECK_TYPES(table, table,
               s,     string);
+  table_resize_step(table);
   struct symbol *sym = table_mlookup(table, s);
   return sym == NULL ? NULL : sym->data;
 }
@@ -371,6 +480,7 @@ TYPEDOP(table_lookup, , "`table `s -> `x. Returns the symbol for `s in"
 {
   CHECK_TYPES(table, table,
               s,     string);
+  table_resize_step(table);
   struct symbol *sym = table_mlookup(table, s);
   return sym ? sym : makebool(false);
 }
@@ -389,6 +499,24 @@ TYPEDOP(table_lookup_substring, , "`table `s `n0 `n1 -> `x. Returns the"
               mlen,  CT_RANGE(len, 0, LONG_MAX));
   if (idx + len > string_len(s))
     RUNTIME_ERROR(error_bad_index, NULL);
+  table_resize_step(table);
+  struct symbol *sym = table_mlookup_substring(table, s, idx, len);
+  return sym ? sym : makebool(false);
+}
+
+TYPEDOP(table_lookup_slice, , "`table `x0 -> `x1. Returns the symbol for"
+        " `x0, a string, string builder or string slice, in `table, or false"
+        " if not found.\n"
+        "Cf. `table_lookup(), `string_slice().",
+        (struct table *table, value x),
+        OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "tx.[yz]")
+{
+  CHECK_TYPES(table, table,
+              x,     CT_TEXT);
+  struct string *s;
+  long idx, len;
+  text_parts(x, &s, &idx, &len);
+  table_resize_step(table);
   struct symbol *sym = table_mlookup_substring(table, s, idx, len);
   return sym ? sym : makebool(false);
 }
@@ -494,6 +622,7 @@ void symbol_init(void)
   DEFINE(table_ref);
   DEFINE(table_lookup);
   DEFINE(table_lookup_substring);
+  DEFINE(table_lookup_slice);
   DEFINE(table_symbol_ref);
   DEFINE(table_set);
   DEFINE(table_remove);
@@ -503,10 +632,16 @@ void symbol_init(void)
   DEFINE(table_list);
   DEFINE(table_vector);
   DEFINE(table_prefix);
+  DEFINE(table_prefix_index);
   DEFINE(table_foreach);
   DEFINE(table_reduce);
   DEFINE(table_existsp);
 
+  DEFINE(make_table_iterator);
+  DEFINE(table_iteratorp);
+  DEFINE(table_iterator_reset);
+  DEFINE(table_iterator_next);
+
   DEFINE(vector_to_table);
   DEFINE(vector_to_ptable);
   DEFINE(vector_to_ctable);
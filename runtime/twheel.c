@@ -0,0 +1,463 @@
+/*
+ * Copyright (c) 1993-2012 David Gay and Gustav Hllberg
+ * All rights reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose, without fee, and without written agreement is hereby granted,
+ * provided that the above copyright notice and the following two paragraphs
+ * appear in all copies of this software.
+ *
+ * IN NO EVENT SHALL DAVID GAY OR GUSTAV HALLBERG BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES ARISING OUT
+ * OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF DAVID GAY OR
+ * GUSTAV HALLBERG HAVE BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * DAVID GAY AND GUSTAV HALLBERG SPECIFICALLY DISCLAIM ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN
+ * "AS IS" BASIS, AND DAVID GAY AND GUSTAV HALLBERG HAVE NO OBLIGATION TO
+ * PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ */
+
+
+#include "check-types.h"
+#include "prims.h"
+#include "twheel.h"
+
+#include "../alloc.h"
+
+/* Hierarchical timer wheels, keyed by integer times such as time() or a
+   tick counter.
+
+   Level 0 has one slot per tick for the next TW_SLOTS ticks; each higher
+   level has one slot per TW_SLOTS slots of the level below. When time
+   reaches the start of a slot's range, its timers cascade down to the
+   level below. Timers due further ahead than the top level covers wait in
+   the top level and are placed again when that slot cascades. Timers
+   that are already due when added wait in a separate overdue list, which
+   is sorted by due time when it expires.
+
+   Each slot is a doubly-linked list of timers, so adding and cancelling a
+   timer take constant time. Advancing the wheel skips over empty slots. */
+
+#define TW_BITS   6
+#define TW_SLOTS  (1L << TW_BITS)
+#define TW_MASK   (TW_SLOTS - 1)
+#define TW_LEVELS 4
+#define TW_SPAN   (1L << (TW_BITS * TW_LEVELS))
+
+#define TW_OVERDUE (TW_LEVELS * TW_SLOTS) /* index of the overdue list */
+
+struct twheel {
+  struct mprivate p;
+  value base;                   /* makeint(first unprocessed time) */
+  value used;                   /* makeint(number of pending timers) */
+  struct vector *slots;         /* list heads; see TW_OVERDUE */
+};
+
+struct timer {
+  struct mprivate p;
+  struct twheel *wheel;         /* NULL unless pending */
+  value expires;
+  value value;
+  value slot;                   /* makeint(index in wheel->slots) */
+  struct timer *next, *prev;
+};
+
+#ifdef LOCAL_MUDLLE_TYPES
+#undef LOCAL_MUDLLE_TYPES
+#define LOCAL_MUDLLE_TYPES struct twheel *: true, struct timer *: true,
+#endif
+
+static bool is_twheel(value _w)
+{
+  struct twheel *w = _w;
+  return (TYPE(w, private)
+          && w->p.ptype == makeint(PRIVATE_TWHEEL));
+}
+
+static bool is_timer(value _t)
+{
+  struct timer *t = _t;
+  return (TYPE(t, private)
+          && t->p.ptype == makeint(PRIVATE_TIMER));
+}
+
+static enum runtime_error ct_twheel(value v, const char **errmsg, bool write)
+{
+  if (!is_twheel(v))
+    {
+      *errmsg = "expected timer wheel";
+      return error_bad_type;
+    }
+  if (write && readonlyp(v))
+    return error_value_read_only;
+  return error_none;
+}
+
+static enum runtime_error ct_timer(value v, const char **errmsg, bool write)
+{
+  if (!is_timer(v))
+    {
+      *errmsg = "expected timer wheel entry";
+      return error_bad_type;
+    }
+  struct timer *t = v;
+  if (write && (readonlyp(t) || (t->wheel && readonlyp(t->wheel))))
+    return error_value_read_only;
+  return error_none;
+}
+
+#define CT_TWHEEL(write) F(TSET(private), ct_twheel, write)
+#define CT_TIMER(write) F(TSET(private), ct_timer, write)
+
+static struct timer **slot_head(struct twheel *w, long level, long idx)
+{
+  return (struct timer **)&w->slots->data[level * TW_SLOTS + idx];
+}
+
+static void link_timer(struct twheel *w, struct timer *t)
+{
+  long base = intval(w->base);
+  long expires = intval(t->expires);
+  long slot;
+  if (expires < base)
+    slot = TW_OVERDUE;
+  else
+    {
+      if (expires - base >= TW_SPAN)
+        expires = base + TW_SPAN - 1;
+      long delta = expires - base, level = 0;
+      while (delta >= 1L << (TW_BITS * (level + 1)))
+        ++level;
+      slot = level * TW_SLOTS + ((expires >> (TW_BITS * level)) & TW_MASK);
+    }
+
+  struct timer **head = (struct timer **)&w->slots->data[slot];
+  t->slot = makeint(slot);
+  t->prev = NULL;
+  t->next = *head;
+  if (t->next)
+    t->next->prev = t;
+  *head = t;
+}
+
+static void unlink_timer(struct twheel *w, struct timer *t)
+{
+  if (t->prev)
+    t->prev->next = t->next;
+  else
+    w->slots->data[intval(t->slot)] = t->next;
+  if (t->next)
+    t->next->prev = t->prev;
+  t->next = t->prev = NULL;
+}
+
+/* move the timers of the current slot on each level whose range starts at
+   w->base down a level */
+static void cascade(struct twheel *w)
+{
+  long base = intval(w->base);
+  for (long level = 1; level < TW_LEVELS; ++level)
+    {
+      long idx = (base >> (TW_BITS * level)) & TW_MASK;
+      struct timer **head = slot_head(w, level, idx);
+      struct timer *t = *head;
+      *head = NULL;
+      while (t)
+        {
+          struct timer *next = t->next;
+          link_timer(w, t);
+          t = next;
+        }
+      if (idx != 0)
+        break;
+    }
+}
+
+static bool slots_empty(struct twheel *w, long level, long from, long to)
+{
+  for (long idx = from; idx < to; ++idx)
+    if (*slot_head(w, level, idx))
+      return false;
+  return true;
+}
+
+/* returns the time up to which (exclusive) no timer can be due, so the
+   wheel can skip there directly */
+static long skip_to(struct twheel *w)
+{
+  long base = intval(w->base);
+  /* slots must cascade at the start of their range */
+  if ((base & TW_MASK) == 0)
+    return base;
+
+  long to = base;
+  for (long level = 0; level < TW_LEVELS; ++level)
+    {
+      long shift = TW_BITS * level;
+      long from = ((base >> shift) & TW_MASK) + (level > 0);
+      if (!slots_empty(w, level, from, TW_SLOTS))
+        break;
+      shift += TW_BITS;
+      to = ((base >> shift) + 1) << shift;
+      /* earlier slots hold timers due in the next range */
+      if (!slots_empty(w, level, 0, from))
+        break;
+    }
+  return to;
+}
+
+/* move the timers in the list at *head to the end of the chain from
+   *first, whose last timer is *last */
+static void expire_list(struct twheel *w, struct timer **head,
+                        struct timer **first, struct timer **last)
+{
+  struct timer *t = *head;
+  *head = NULL;
+  while (t)
+    {
+      struct timer *next = t->next;
+      t->wheel = NULL;
+      t->next = NULL;
+      t->prev = *last;
+      if (*last)
+        (*last)->next = t;
+      else
+        *first = t;
+      *last = t;
+      w->used = makeint(intval(w->used) - 1);
+      t = next;
+    }
+}
+
+/* return the chain of timers from t, linked by their next fields, in
+   reverse order */
+static struct timer *reverse_timers(struct timer *t)
+{
+  struct timer *rev = NULL;
+  while (t)
+    {
+      struct timer *next = t->next;
+      t->next = rev;
+      rev = t;
+      t = next;
+    }
+  return rev;
+}
+
+/* stable merge sort of the chain of timers from t by due time; only
+   their next fields are updated */
+static struct timer *sort_timers(struct timer *t)
+{
+  if (t == NULL || t->next == NULL)
+    return t;
+
+  struct timer *mid = t, *end = t->next;
+  while (end && end->next)
+    {
+      mid = mid->next;
+      end = end->next->next;
+    }
+  struct timer *b = sort_timers(mid->next);
+  mid->next = NULL;
+  struct timer *a = sort_timers(t);
+
+  struct timer *result, **tail = &result;
+  while (a && b)
+    {
+      struct timer **min = (intval(b->expires) < intval(a->expires)
+                            ? &b : &a);
+      *tail = *min;
+      tail = &(*min)->next;
+      *min = (*min)->next;
+    }
+  *tail = a ? a : b;
+  return result;
+}
+
+/* unlink the timers due by time target and chain them, in order, from
+   *first */
+static void expire_timers(struct twheel *w, long target, struct timer **first)
+{
+  struct timer *last = NULL;
+  *first = NULL;
+  /* the overdue list holds the most recently added timer first */
+  struct timer **overdue = (struct timer **)&w->slots->data[TW_OVERDUE];
+  *overdue = sort_timers(reverse_timers(*overdue));
+  expire_list(w, overdue, first, &last);
+  while (intval(w->base) <= target)
+    {
+      if (w->used == makeint(0))
+        {
+          w->base = makeint(target + 1);
+          break;
+        }
+      long skip = skip_to(w);
+      if (skip > target)
+        {
+          w->base = makeint(target + 1);
+          break;
+        }
+      w->base = makeint(skip);
+      if ((skip & TW_MASK) == 0)
+        cascade(w);
+
+      expire_list(w, slot_head(w, 0, skip & TW_MASK), first, &last);
+      w->base = makeint(skip + 1);
+    }
+}
+
+TYPEDOP(make_timer_wheel, ,
+        "`n -> `w. Returns a new timer wheel whose current time is `n.",
+        (value n), OP_LEAF | OP_NOESCAPE, "n.o")
+{
+  CHECK_TYPES(n, integer);
+  struct twheel *w = (struct twheel *)alloc_private(PRIVATE_TWHEEL, 3);
+  w->base = makeint(intval(n) + 1);
+  w->used = makeint(0);
+  GCPRO(w);
+  struct vector *slots = alloc_vector(TW_OVERDUE + 1);
+  UNGCPRO();
+  w->slots = slots;
+  return w;
+}
+
+TYPEDOP(timer_wheelp, "timer_wheel?",
+        "`x -> `b. True if `x is a timer wheel.",
+        (value x), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "x.n")
+{
+  return makebool(is_twheel(x));
+}
+
+TYPEDOP(timer_wheel_entryp, "timer_wheel_entry?",
+        "`x -> `b. True if `x is a timer wheel entry.",
+        (value x), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "x.n")
+{
+  return makebool(is_timer(x));
+}
+
+TYPEDOP(timer_wheel_now, ,
+        "`w -> `n. Returns the current time of timer wheel `w.",
+        (struct twheel *w), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "o.n")
+{
+  CHECK_TYPES(w, CT_TWHEEL(false));
+  return makeint(intval(w->base) - 1);
+}
+
+TYPEDOP(timer_wheel_entries, ,
+        "`w -> `n. Returns the number of pending timers in timer wheel"
+        " `w.",
+        (struct twheel *w), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "o.n")
+{
+  CHECK_TYPES(w, CT_TWHEEL(false));
+  return w->used;
+}
+
+TYPEDOP(timer_wheel_add, "timer_wheel_add!",
+        "`w `n `x -> `t. Adds a timer with value `x to timer wheel `w, due"
+        " at time `n. Timers that are already due expire at the next"
+        " call to `timer_wheel_advance!(). Returns the new entry `t, which can be"
+        " passed to `timer_wheel_cancel!().",
+        (struct twheel *w, value n, value x), OP_LEAF | OP_NOESCAPE,
+        "onx.o")
+{
+  CHECK_TYPES(w, CT_TWHEEL(true),
+              n, integer,
+              x, any);
+  GCPRO(w, x);
+  struct timer *t = (struct timer *)alloc_private(PRIVATE_TIMER, 6);
+  UNGCPRO();
+  t->wheel = w;
+  t->expires = n;
+  t->value = x;
+  link_timer(w, t);
+  w->used = makeint(intval(w->used) + 1);
+  return t;
+}
+
+TYPEDOP(timer_wheel_cancel, "timer_wheel_cancel!",
+        "`t -> `b. Cancels timer wheel entry `t. Returns true if it was"
+        " pending.",
+        (struct timer *t), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "o.n")
+{
+  CHECK_TYPES(t, CT_TIMER(true));
+  struct twheel *w = t->wheel;
+  if (w == NULL)
+    return makebool(false);
+  unlink_timer(w, t);
+  t->wheel = NULL;
+  w->used = makeint(intval(w->used) - 1);
+  return makebool(true);
+}
+
+TYPEDOP(timer_wheel_advance, "timer_wheel_advance!",
+        "`w `n -> `l. Sets the current time of timer wheel `w to `n and"
+        " returns a list of the values of the timers that expired, in the"
+        " order they were due. If `n is before the current time, the"
+        " time is left unchanged.",
+        (struct twheel *w, value n), OP_LEAF | OP_NOESCAPE, "on.l")
+{
+  CHECK_TYPES(w, CT_TWHEEL(true),
+              n, integer);
+  struct timer *first, *t = NULL;
+  struct list *l = NULL;
+  expire_timers(w, intval(n), &first);
+  if (first == NULL)
+    return NULL;
+
+  t = first;
+  while (t->next)
+    t = t->next;
+  /* the chain keeps the expired timers alive while allocating */
+  GCPRO(first, t, l);
+  while (t)
+    {
+      l = alloc_list(t->value, l);
+      struct timer *prev = t->prev;
+      t->next = t->prev = NULL;
+      t = prev;
+    }
+  UNGCPRO();
+  return l;
+}
+
+TYPEDOP(timer_wheel_entry_value, ,
+        "`t -> `x. Returns the value of timer wheel entry `t.",
+        (struct timer *t), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "o.x")
+{
+  CHECK_TYPES(t, CT_TIMER(false));
+  return t->value;
+}
+
+TYPEDOP(timer_wheel_entry_time, ,
+        "`t -> `n. Returns the time timer wheel entry `t is due.",
+        (struct timer *t), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "o.n")
+{
+  CHECK_TYPES(t, CT_TIMER(false));
+  return t->expires;
+}
+
+TYPEDOP(timer_wheel_entry_pendingp, "timer_wheel_entry_pending?",
+        "`t -> `b. True if timer wheel entry `t has neither expired nor"
+        " been cancelled.",
+        (struct timer *t), OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "o.n")
+{
+  CHECK_TYPES(t, CT_TIMER(false));
+  return makebool(t->wheel != NULL);
+}
+
+void twheel_init(void)
+{
+  DEFINE(make_timer_wheel);
+  DEFINE(timer_wheelp);
+  DEFINE(timer_wheel_entryp);
+  DEFINE(timer_wheel_now);
+  DEFINE(timer_wheel_entries);
+  DEFINE(timer_wheel_add);
+  DEFINE(timer_wheel_cancel);
+  DEFINE(timer_wheel_advance);
+  DEFINE(timer_wheel_entry_value);
+  DEFINE(timer_wheel_entry_time);
+  DEFINE(timer_wheel_entry_pendingp);
+}
@@ -0,0 +1,923 @@
+/*
+ * Copyright (c) 1993-2012 David Gay and Gustav Hllberg
+ * All rights reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose, without fee, and without written agreement is hereby granted,
+ * provided that the above copyright notice and the following two paragraphs
+ * appear in all copies of this software.
+ *
+ * IN NO EVENT SHALL DAVID GAY OR GUSTAV HALLBERG BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES ARISING OUT
+ * OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF DAVID GAY OR
+ * GUSTAV HALLBERG HAVE BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * DAVID GAY AND GUSTAV HALLBERG SPECIFICALLY DISCLAIM ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN
+ * "AS IS" BASIS, AND DAVID GAY AND GUSTAV HALLBERG HAVE NO OBLIGATION TO
+ * PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ */
+
+#include "../mudlle-config.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined __i386__ || defined __x86_64__
+#  include <immintrin.h>
+#  define USE_SIMD_KERNELS
+#endif
+
+#include "bigint.h"
+#include "check-types.h"
+#include "mudlle-float.h"
+#include "prims.h"
+#include "typedarray.h"
+
+#include "../alloc.h"
+#include "../utils.h"
+
+/* Typed arrays are strings holding unboxed numbers of one kind:
+
+     u8array    bytes (0 to 255)
+     i32array   signed 32-bit integers
+     i64array   signed 64-bit integers
+     f64array   doubles
+
+   Element i is stored in native byte order at byte offset i * (element
+   size); any trailing bytes are ignored. As strings are not necessarily
+   aligned for the element type, elements are accessed using memcpy().
+
+   There is no separate array type: every primitive accepts any string,
+   whatever created it. E.g., i32array_ref() reads a u8array (or any other
+   string) as 32-bit integers. The compiler does not inline element
+   access; the type signatures only let it infer the types of results.
+
+   The reductions run a vector at a time on CPUs with SSE2 or AVX2,
+   picking the best kernels in typedarray_init(). Floating-point sums and
+   dot products always add element i into lane i % F64_LANES, and combine
+   the lanes in the same order, so their results do not depend on which
+   kernels are used. */
+
+#define DEF_ELT_ACCESS(kind, ctype)                             \
+static inline ctype kind ## _get(const char *s, size_t i)       \
+{                                                               \
+  ctype x;                                                      \
+  memcpy(&x, s + i * sizeof x, sizeof x);                       \
+  return x;                                                     \
+}                                                               \
+                                                                \
+static inline void kind ## _put(char *s, size_t i, ctype x)     \
+{                                                               \
+  memcpy(s + i * sizeof x, &x, sizeof x);                       \
+}
+
+DEF_ELT_ACCESS(u8,  uint8_t)
+DEF_ELT_ACCESS(i32, int32_t)
+DEF_ELT_ACCESS(i64, int64_t)
+DEF_ELT_ACCESS(f64, double)
+
+#define PICK_min(a, b) ((b) < (a) ? (b) : (a))
+#define PICK_max(a, b) ((b) > (a) ? (b) : (a))
+
+/* Scalar kernels; on empty input, min and max return their identity */
+
+#define DEF_SCALAR_PICK(kind, ctype, op, init)                  \
+static ctype scalar_ ## kind ## _ ## op(const char *s, size_t n) \
+{                                                               \
+  ctype m = init;                                               \
+  for (size_t i = 0; i < n; ++i)                                \
+    m = PICK_ ## op(m, kind ## _get(s, i));                     \
+  return m;                                                     \
+}
+
+DEF_SCALAR_PICK(u8,  uint8_t, min, UINT8_MAX)
+DEF_SCALAR_PICK(u8,  uint8_t, max, 0)
+DEF_SCALAR_PICK(i32, int32_t, min, INT32_MAX)
+DEF_SCALAR_PICK(i32, int32_t, max, INT32_MIN)
+DEF_SCALAR_PICK(i64, int64_t, min, INT64_MAX)
+DEF_SCALAR_PICK(i64, int64_t, max, INT64_MIN)
+
+static uint64_t scalar_u8_sum(const char *s, size_t n)
+{
+  uint64_t sum = 0;
+  for (size_t i = 0; i < n; ++i)
+    sum += u8_get(s, i);
+  return sum;
+}
+
+/* cannot overflow as there are fewer than 2^32 elements */
+static int64_t scalar_i32_sum(const char *s, size_t n)
+{
+  int64_t sum = 0;
+  for (size_t i = 0; i < n; ++i)
+    sum += i32_get(s, i);
+  return sum;
+}
+
+#define F64_LANES 4
+
+/* These add elements from..n-1 into the lanes in l[] and then combine
+   the lanes; l[] holds the result of processing elements 0..from-1 */
+static double f64_sum_tail(const char *s, size_t from, size_t n,
+                           double l[F64_LANES])
+{
+  for (size_t i = from; i < n; ++i)
+    l[i % F64_LANES] += f64_get(s, i);
+  return (l[0] + l[1]) + (l[2] + l[3]);
+}
+
+static double f64_dot_tail(const char *a, const char *b, size_t from,
+                           size_t n, double l[F64_LANES])
+{
+  for (size_t i = from; i < n; ++i)
+    l[i % F64_LANES] += f64_get(a, i) * f64_get(b, i);
+  return (l[0] + l[1]) + (l[2] + l[3]);
+}
+
+/* NaNs are skipped, like by the SSE2 and AVX2 min and max instructions
+   when the NaN is the first operand */
+#define DEF_F64_PICK_TAIL(op)                                           \
+static double f64_ ## op ## _tail(const char *s, size_t from, size_t n, \
+                                  double l[F64_LANES])                  \
+{                                                                       \
+  for (size_t i = from; i < n; ++i)                                     \
+    l[i % F64_LANES] = PICK_ ## op(l[i % F64_LANES], f64_get(s, i));    \
+  double m = l[0];                                                      \
+  for (int k = 1; k < F64_LANES; ++k)                                   \
+    m = PICK_ ## op(m, l[k]);                                           \
+  return m;                                                             \
+}
+
+DEF_F64_PICK_TAIL(min)
+DEF_F64_PICK_TAIL(max)
+
+static double scalar_f64_sum(const char *s, size_t n)
+{
+  double l[F64_LANES] = { 0 };
+  return f64_sum_tail(s, 0, n, l);
+}
+
+static double scalar_f64_dot(const char *a, const char *b, size_t n)
+{
+  double l[F64_LANES] = { 0 };
+  return f64_dot_tail(a, b, 0, n, l);
+}
+
+static double scalar_f64_min(const char *s, size_t n)
+{
+  double l[F64_LANES] = { INFINITY, INFINITY, INFINITY, INFINITY };
+  return f64_min_tail(s, 0, n, l);
+}
+
+static double scalar_f64_max(const char *s, size_t n)
+{
+  double l[F64_LANES] = { -INFINITY, -INFINITY, -INFINITY, -INFINITY };
+  return f64_max_tail(s, 0, n, l);
+}
+
+#ifdef USE_SIMD_KERNELS
+
+static inline __attribute__((target("sse2")))
+__m128i sse2_min_epi32(__m128i a, __m128i b)
+{
+  __m128i gt = _mm_cmpgt_epi32(a, b);
+  return _mm_or_si128(_mm_and_si128(gt, b), _mm_andnot_si128(gt, a));
+}
+
+static inline __attribute__((target("sse2")))
+__m128i sse2_max_epi32(__m128i a, __m128i b)
+{
+  __m128i gt = _mm_cmpgt_epi32(a, b);
+  return _mm_or_si128(_mm_and_si128(gt, a), _mm_andnot_si128(gt, b));
+}
+
+/* adds the sign-extended 32-bit lanes of v into the 64-bit lanes of acc */
+static inline __attribute__((target("sse2")))
+__m128i sse2_add_i32_i64(__m128i acc, __m128i v)
+{
+  __m128i sign = _mm_srai_epi32(v, 31);
+  acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(v, sign));
+  return _mm_add_epi64(acc, _mm_unpackhi_epi32(v, sign));
+}
+
+static inline __attribute__((target("avx2")))
+__m256i avx2_add_i32_i64(__m256i acc, __m256i v)
+{
+  acc = _mm256_add_epi64(
+    acc, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(v)));
+  return _mm256_add_epi64(
+    acc, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1)));
+}
+
+#define sse2_vec       __m128i
+#define sse2_width     16
+#define sse2_load      _mm_loadu_si128
+#define sse2_store     _mm_storeu_si128
+#define sse2_zero      _mm_setzero_si128
+#define sse2_set1_epi8 _mm_set1_epi8
+#define sse2_set1_i32  _mm_set1_epi32
+#define sse2_add_epi64 _mm_add_epi64
+#define sse2_sad_epu8  _mm_sad_epu8
+#define sse2_min_u8    _mm_min_epu8
+#define sse2_max_u8    _mm_max_epu8
+#define sse2_min_i32   sse2_min_epi32
+#define sse2_max_i32   sse2_max_epi32
+#define sse2_dvec      __m128d
+#define sse2_dwidth    2
+#define sse2_dload     _mm_loadu_pd
+#define sse2_dstore    _mm_storeu_pd
+#define sse2_dset1     _mm_set1_pd
+#define sse2_dadd      _mm_add_pd
+#define sse2_dmul      _mm_mul_pd
+#define sse2_dmin      _mm_min_pd
+#define sse2_dmax      _mm_max_pd
+
+#define avx2_vec       __m256i
+#define avx2_width     32
+#define avx2_load      _mm256_loadu_si256
+#define avx2_store     _mm256_storeu_si256
+#define avx2_zero      _mm256_setzero_si256
+#define avx2_set1_epi8 _mm256_set1_epi8
+#define avx2_set1_i32  _mm256_set1_epi32
+#define avx2_add_epi64 _mm256_add_epi64
+#define avx2_sad_epu8  _mm256_sad_epu8
+#define avx2_min_u8    _mm256_min_epu8
+#define avx2_max_u8    _mm256_max_epu8
+#define avx2_min_i32   _mm256_min_epi32
+#define avx2_max_i32   _mm256_max_epi32
+#define avx2_dvec      __m256d
+#define avx2_dwidth    4
+#define avx2_dload     _mm256_loadu_pd
+#define avx2_dstore    _mm256_storeu_pd
+#define avx2_dset1     _mm256_set1_pd
+#define avx2_dadd      _mm256_add_pd
+#define avx2_dmul      _mm256_mul_pd
+#define avx2_dmin      _mm256_min_pd
+#define avx2_dmax      _mm256_max_pd
+
+#define V(isa, op) isa ## _ ## op
+
+#define VLOAD(isa, s) V(isa, load)((const V(isa, vec) *)(s))
+#define VSTORE(isa, s, v) V(isa, store)((V(isa, vec) *)(s), v)
+/* loads the doubles starting at element i of s */
+#define VDLOAD(isa, s, i) V(isa, dload)((const double *)(s) + (i))
+
+/* each group of F64_LANES doubles is covered by VDN(isa) vectors */
+#define VDN(isa) (F64_LANES / V(isa, dwidth))
+
+#define DEF_SIMD_PICK(isa, kind, ctype, op, init)                       \
+static __attribute__((target(#isa)))                                    \
+ctype isa ## _ ## kind ## _ ## op(const char *s, size_t n)              \
+{                                                                       \
+  enum { step = V(isa, width) / sizeof (ctype) };                       \
+  V(isa, vec) acc = init;                                               \
+  size_t i = 0;                                                         \
+  for (; i + step <= n; i += step)                                      \
+    acc = V(isa, op ## _ ## kind)(acc, VLOAD(isa, s + i * sizeof (ctype))); \
+  ctype l[step];                                                        \
+  VSTORE(isa, l, acc);                                                  \
+  ctype m = scalar_ ## kind ## _ ## op(s + i * sizeof (ctype), n - i);  \
+  for (int k = 0; k < step; ++k)                                        \
+    m = PICK_ ## op(m, l[k]);                                           \
+  return m;                                                             \
+}
+
+#define DEF_SIMD_F64_PICK(isa, op, init)                                \
+static __attribute__((target(#isa)))                                    \
+double isa ## _f64_ ## op(const char *s, size_t n)                      \
+{                                                                       \
+  V(isa, dvec) acc[VDN(isa)];                                           \
+  for (int k = 0; k < VDN(isa); ++k)                                    \
+    acc[k] = V(isa, dset1)(init);                                       \
+  size_t i = 0;                                                         \
+  for (; i + F64_LANES <= n; i += F64_LANES)                            \
+    for (int k = 0; k < VDN(isa); ++k)                                  \
+      acc[k] = V(isa, d ## op)(                                         \
+        VDLOAD(isa, s, i + k * V(isa, dwidth)), acc[k]);                \
+  double l[F64_LANES];                                                  \
+  for (int k = 0; k < VDN(isa); ++k)                                    \
+    V(isa, dstore)(l + k * V(isa, dwidth), acc[k]);                     \
+  return f64_ ## op ## _tail(s, i, n, l);                               \
+}
+
+#define DEF_SIMD_KERNELS(isa)                                           \
+DEF_SIMD_PICK(isa, u8,  uint8_t, min, V(isa, set1_epi8)(-1))            \
+DEF_SIMD_PICK(isa, u8,  uint8_t, max, V(isa, zero)())                   \
+DEF_SIMD_PICK(isa, i32, int32_t, min, V(isa, set1_i32)(INT32_MAX))      \
+DEF_SIMD_PICK(isa, i32, int32_t, max, V(isa, set1_i32)(INT32_MIN))      \
+DEF_SIMD_F64_PICK(isa, min, INFINITY)                                   \
+DEF_SIMD_F64_PICK(isa, max, -INFINITY)                                  \
+                                                                        \
+static __attribute__((target(#isa)))                                    \
+uint64_t isa ## _u8_sum(const char *s, size_t n)                        \
+{                                                                       \
+  V(isa, vec) acc = V(isa, zero)();                                     \
+  size_t i = 0;                                                         \
+  for (; i + V(isa, width) <= n; i += V(isa, width))                    \
+    acc = V(isa, add_epi64)(                                            \
+      acc, V(isa, sad_epu8)(VLOAD(isa, s + i), V(isa, zero)()));        \
+  uint64_t l[V(isa, width) / sizeof (uint64_t)];                        \
+  VSTORE(isa, l, acc);                                                  \
+  uint64_t sum = scalar_u8_sum(s + i, n - i);                           \
+  for (int k = 0; k < VLENGTH(l); ++k)                                  \
+    sum += l[k];                                                        \
+  return sum;                                                           \
+}                                                                       \
+                                                                        \
+static __attribute__((target(#isa)))                                    \
+int64_t isa ## _i32_sum(const char *s, size_t n)                        \
+{                                                                       \
+  enum { step = V(isa, width) / sizeof (int32_t) };                     \
+  V(isa, vec) acc = V(isa, zero)();                                     \
+  size_t i = 0;                                                         \
+  for (; i + step <= n; i += step)                                      \
+    acc = V(isa, add_i32_i64)(                                          \
+      acc, VLOAD(isa, s + i * sizeof (int32_t)));                       \
+  int64_t l[V(isa, width) / sizeof (int64_t)];                          \
+  VSTORE(isa, l, acc);                                                  \
+  int64_t sum = scalar_i32_sum(s + i * sizeof (int32_t), n - i);        \
+  for (int k = 0; k < VLENGTH(l); ++k)                                  \
+    sum += l[k];                                                        \
+  return sum;                                                           \
+}                                                                       \
+                                                                        \
+static __attribute__((target(#isa)))                                    \
+double isa ## _f64_sum(const char *s, size_t n)                         \
+{                                                                       \
+  V(isa, dvec) acc[VDN(isa)];                                           \
+  for (int k = 0; k < VDN(isa); ++k)                                    \
+    acc[k] = V(isa, dset1)(0);                                          \
+  size_t i = 0;                                                         \
+  for (; i + F64_LANES <= n; i += F64_LANES)                            \
+    for (int k = 0; k < VDN(isa); ++k)                                  \
+      acc[k] = V(isa, dadd)(                                            \
+        acc[k], VDLOAD(isa, s, i + k * V(isa, dwidth)));                \
+  double l[F64_LANES];                                                  \
+  for (int k = 0; k < VDN(isa); ++k)                                    \
+    V(isa, dstore)(l + k * V(isa, dwidth), acc[k]);                     \
+  return f64_sum_tail(s, i, n, l);                                      \
+}                                                                       \
+                                                                        \
+static __attribute__((target(#isa)))                                    \
+double isa ## _f64_dot(const char *a, const char *b, size_t n)          \
+{                                                                       \
+  V(isa, dvec) acc[VDN(isa)];                                           \
+  for (int k = 0; k < VDN(isa); ++k)                                    \
+    acc[k] = V(isa, dset1)(0);                                          \
+  size_t i = 0;                                                         \
+  for (; i + F64_LANES <= n; i += F64_LANES)                            \
+    for (int k = 0; k < VDN(isa); ++k)                                  \
+      {                                                                 \
+        size_t j = i + k * V(isa, dwidth);                              \
+        acc[k] = V(isa, dadd)(                                          \
+          acc[k], V(isa, dmul)(VDLOAD(isa, a, j), VDLOAD(isa, b, j)));  \
+      }                                                                 \
+  double l[F64_LANES];                                                  \
+  for (int k = 0; k < VDN(isa); ++k)                                    \
+    V(isa, dstore)(l + k * V(isa, dwidth), acc[k]);                     \
+  return f64_dot_tail(a, b, i, n, l);                                   \
+}
+
+DEF_SIMD_KERNELS(sse2)
+DEF_SIMD_KERNELS(avx2)
+
+#endif  /* USE_SIMD_KERNELS */
+
+/* The best kernels for this CPU; set by typedarray_init() */
+static struct {
+  uint64_t (*u8_sum)(const char *s, size_t n);
+  uint8_t (*u8_min)(const char *s, size_t n);
+  uint8_t (*u8_max)(const char *s, size_t n);
+  int64_t (*i32_sum)(const char *s, size_t n);
+  int32_t (*i32_min)(const char *s, size_t n);
+  int32_t (*i32_max)(const char *s, size_t n);
+  int64_t (*i64_min)(const char *s, size_t n);
+  int64_t (*i64_max)(const char *s, size_t n);
+  double (*f64_sum)(const char *s, size_t n);
+  double (*f64_dot)(const char *a, const char *b, size_t n);
+  double (*f64_min)(const char *s, size_t n);
+  double (*f64_max)(const char *s, size_t n);
+} kernels = {
+  .u8_sum  = scalar_u8_sum,
+  .u8_min  = scalar_u8_min,
+  .u8_max  = scalar_u8_max,
+  .i32_sum = scalar_i32_sum,
+  .i32_min = scalar_i32_min,
+  .i32_max = scalar_i32_max,
+  .i64_min = scalar_i64_min,
+  .i64_max = scalar_i64_max,
+  .f64_sum = scalar_f64_sum,
+  .f64_dot = scalar_f64_dot,
+  .f64_min = scalar_f64_min,
+  .f64_max = scalar_f64_max,
+};
+
+/* Result type signatures of values that always fit in a tagged integer
+   on 64-bit hosts, but may need a bigint on 32-bit ones */
+#if MAX_TAGGED_INT > INT32_MAX
+#  define SIG_WIDE "n"
+#else
+#  define SIG_WIDE "B"
+#endif
+
+#ifdef USE_GMP
+#  define INT64_TYPESET (TSET(integer) | TSET(bigint))
+#else
+#  define INT64_TYPESET TSET(integer)
+#endif
+
+static enum runtime_error get_int64(value v, const char **errmsg,
+                                    int64_t *dst)
+{
+  if (integerp(v))
+    {
+      *dst = intval(v);
+      return error_none;
+    }
+#ifdef USE_GMP
+  long long ll;
+  if (TYPE(v, bigint) && bigint_to_llong(v, &ll))
+    {
+      *dst = ll;
+      return error_none;
+    }
+#endif
+  *errmsg = "integer out of range";
+  return error_bad_value;
+}
+
+/* Element type checks, usable with F() in CHECK_TYPES() */
+
+#define TYPESET_u8 TSET(integer)
+static enum runtime_error ct_u8_elt(value v, const char **errmsg,
+                                    uint8_t *dst)
+{
+  long l = intval(v);
+  if (l < 0 || l > UINT8_MAX)
+    {
+      *errmsg = "byte out of range";
+      return error_bad_value;
+    }
+  *dst = l;
+  return error_none;
+}
+
+#define TYPESET_i32 INT64_TYPESET
+static enum runtime_error ct_i32_elt(value v, const char **errmsg,
+                                     int32_t *dst)
+{
+  int64_t l;
+  enum runtime_error e = get_int64(v, errmsg, &l);
+  if (e != error_none)
+    return e;
+  if (l < INT32_MIN || l > INT32_MAX)
+    {
+      *errmsg = "integer out of range";
+      return error_bad_value;
+    }
+  *dst = l;
+  return error_none;
+}
+
+#define TYPESET_i64 INT64_TYPESET
+static enum runtime_error ct_i64_elt(value v, const char **errmsg,
+                                     int64_t *dst)
+{
+  return get_int64(v, errmsg, dst);
+}
+
+#define TYPESET_f64 FLOAT_TYPESET
+static enum runtime_error ct_f64_elt(value v, const char **errmsg,
+                                     double *dst)
+{
+  return get_floatval(dst, v);
+}
+
+#define CT_ELT(kind, dst) F(TYPESET_ ## kind, ct_ ## kind ## _elt, &(dst))
+
+#define BOX_u8(x)  makeint(x)
+#define BOX_i32(x) make_int_or_bigint(x)
+#define BOX_i64(x) make_int_or_bigint(x)
+#define BOX_f64(x) alloc_float(x)
+
+static enum runtime_error ct_array_index(long idx, const char **errmsg,
+                                         long len, bool beyond, long *dst)
+{
+  if (idx < 0)
+    idx += len;
+  if (idx < 0 || idx >= len + beyond)
+    {
+      *errmsg = "array index out of range";
+      return error_bad_index;
+    }
+  *dst = idx;
+  return error_none;
+}
+
+#define __CT_ARRAY_IDX_E(v, msg, dst_len_beyond)                        \
+  ct_array_index(v, msg, ARGN2 dst_len_beyond, ARGN3 dst_len_beyond,    \
+                 &(ARGN1 dst_len_beyond))
+/* like CT_STR_IDX() for an array of 'len' elements */
+#define CT_ARRAY_IDX(dst, len, beyond) \
+  CT_INT_P((dst, len, beyond), __CT_ARRAY_IDX_E)
+
+/* fills n elements of 'size' bytes at s with the element at x */
+static void fill_elements(char *s, size_t n, const void *x, size_t size)
+{
+  if (n == 0)
+    return;
+  memcpy(s, x, size);
+  /* keep doubling the filled prefix */
+  size_t total = n * size;
+  for (size_t done = size; done < total; )
+    {
+      size_t len = done < total - done ? done : total - done;
+      memcpy(s + done, s, len);
+      done += len;
+    }
+}
+
+/* Defines the primitives common to all kinds of typed arrays; 'what'
+   describes the elements, 'isig' and 'osig' are the type signatures of
+   elements passed to and returned from the primitives, and 'pnote' is
+   added to the documentation of min and max */
+#define DEF_TYPED_ARRAY(kind, ctype, what, isig, osig, pnote)           \
+                                                                        \
+static inline long kind ## array_len(struct string *a)                  \
+{                                                                       \
+  return string_len(a) / sizeof (ctype);                                \
+}                                                                       \
+                                                                        \
+TYPEDOP(make_ ## kind ## array, ,                                       \
+        "`n -> `a. Returns a new " #kind "array of `n " what ", all"    \
+        " zero.",                                                       \
+        (value n),                                                      \
+        OP_LEAF | OP_NOESCAPE, "n.s")                                   \
+{                                                                       \
+  long len;                                                             \
+  CHECK_TYPES(n, CT_RANGE(len, 0, MAX_STRING_SIZE / sizeof (ctype)));   \
+  struct string *a = alloc_empty_string(len * sizeof (ctype));          \
+  memset(a->str, 0, len * sizeof (ctype));                              \
+  return a;                                                             \
+}                                                                       \
+                                                                        \
+TYPEDOP(kind ## array_length, ,                                         \
+        "`a -> `n. Returns the number of elements of the " #kind        \
+        "array `a.",                                                    \
+        (struct string *a),                                             \
+        OP_LEAF | OP_NOALLOC | OP_NOESCAPE | OP_STR_READONLY | OP_CONST, \
+        "s.n")                                                          \
+{                                                                       \
+  CHECK_TYPES(a, string);                                               \
+  return makeint(kind ## array_len(a));                                 \
+}                                                                       \
+                                                                        \
+TYPEDOP(kind ## array_ref, ,                                            \
+        "`a `n -> `x. Returns element `n of the " #kind "array `a."     \
+        " Negative `n are counted from the end of `a.",                 \
+        (struct string *a, value n),                                    \
+        OP_LEAF | OP_NOESCAPE | OP_STR_READONLY | OP_CONST,             \
+        "sn." osig)                                                     \
+{                                                                       \
+  long idx;                                                             \
+  CHECK_TYPES(a, string,                                                \
+              n, CT_ARRAY_IDX(idx, kind ## array_len(a), false));       \
+  return BOX_ ## kind(kind ## _get(a->str, idx));                       \
+}                                                                       \
+                                                                        \
+TYPEDOP(kind ## array_set, #kind "array_set!",                          \
+        "`a `n `x -> `x. Sets element `n of the " #kind "array `a"      \
+        " to `x. Negative `n are counted from the end of `a.",          \
+        (struct string *a, value n, value x),                           \
+        OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "sn" isig ".3")             \
+{                                                                       \
+  long idx;                                                             \
+  ctype e;                                                              \
+  CHECK_TYPES(a, string,                                                \
+              n, CT_ARRAY_IDX(idx, kind ## array_len(a), false),        \
+              x, CT_ELT(kind, e));                                      \
+  if (obj_readonlyp(&a->o))                                             \
+    RUNTIME_ERROR(error_value_read_only, NULL);                         \
+  kind ## _put(a->str, idx, e);                                         \
+  return x;                                                             \
+}                                                                       \
+                                                                        \
+TYPEDOP(kind ## array_fill, #kind "array_fill!",                        \
+        "`a `x -> `a. Sets all elements of the " #kind "array `a"       \
+        " to `x.",                                                      \
+        (struct string *a, value x),                                    \
+        OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "s" isig ".1")              \
+{                                                                       \
+  ctype e;                                                              \
+  CHECK_TYPES(a, string,                                                \
+              x, CT_ELT(kind, e));                                      \
+  long len = kind ## array_len(a);                                      \
+  /* allow readonly for empty arrays */                                 \
+  if (len == 0)                                                         \
+    return a;                                                           \
+  if (obj_readonlyp(&a->o))                                             \
+    RUNTIME_ERROR(error_value_read_only, NULL);                         \
+  fill_elements(a->str, len, &e, sizeof e);                             \
+  return a;                                                             \
+}                                                                       \
+                                                                        \
+TYPEDOP(kind ## array_copy, #kind "array_copy!",                        \
+        "`a0 `n0 `a1 `n1 `n2 -> `a0. Copies `n2 elements of the "       \
+        #kind "array `a1, starting at element `n1, to `a0 starting"     \
+        " at element `n0. The ranges may overlap. Negative `n0 and `n1"  \
+        " are counted from the end of the respective array.",          \
+        (struct string *dst, value mdidx, struct string *src,           \
+         value msidx, value mcount),                                    \
+        OP_LEAF | OP_NOALLOC | OP_NOESCAPE, "snsnn.1")                  \
+{                                                                       \
+  long didx, sidx, count;                                               \
+  CHECK_TYPES(dst,    string,                                           \
+              mdidx,  CT_ARRAY_IDX(didx, kind ## array_len(dst), true), \
+              src,    string,                                           \
+              msidx,  CT_ARRAY_IDX(sidx, kind ## array_len(src), true), \
+              mcount, CT_RANGE(count, 0, LONG_MAX));                    \
+  if (didx + count > kind ## array_len(dst)                             \
+      || sidx + count > kind ## array_len(src))                         \
+    RUNTIME_ERROR(error_bad_index, NULL);                               \
+  if (count == 0)                                                       \
+    return dst;                                                         \
+  if (obj_readonlyp(&dst->o))                                           \
+    RUNTIME_ERROR(error_value_read_only, NULL);                         \
+  memmove(dst->str + didx * sizeof (ctype),                             \
+          src->str + sidx * sizeof (ctype),                             \
+          count * sizeof (ctype));                                      \
+  return dst;                                                           \
+}                                                                       \
+                                                                        \
+TYPEDOP(kind ## array_slice, ,                                          \
+        "`a0 `n0 `n1 -> `a1. Returns a new " #kind "array holding the"  \
+        " `n1 elements of `a0 starting at element `n0. Negative `n0 are" \
+        " counted from the end of `a0.",                                \
+        (struct string *a, value mstart, value mcount),                 \
+        OP_LEAF | OP_NOESCAPE | OP_STR_READONLY, "snn.s")               \
+{                                                                       \
+  long start, count;                                                    \
+  CHECK_TYPES(a,      string,                                           \
+              mstart, CT_ARRAY_IDX(start, kind ## array_len(a), true),  \
+              mcount, CT_RANGE(count, 0, LONG_MAX));                    \
+  if (start + count > kind ## array_len(a))                             \
+    RUNTIME_ERROR(error_bad_index, NULL);                               \
+                                                                        \
+  GCPRO(a);                                                             \
+  struct string *r = alloc_empty_string(count * sizeof (ctype));        \
+  UNGCPRO();                                                            \
+  memcpy(r->str, a->str + start * sizeof (ctype),                       \
+         count * sizeof (ctype));                                       \
+  return r;                                                             \
+}                                                                       \
+                                                                        \
+TYPEDOP(kind ## array_min, ,                                            \
+        "`a -> `x. Returns the smallest element of the non-empty "      \
+        #kind "array `a." pnote,                                        \
+        (struct string *a),                                             \
+        OP_LEAF | OP_NOESCAPE | OP_STR_READONLY | OP_CONST, "s." osig)  \
+{                                                                       \
+  CHECK_TYPES(a, string);                                               \
+  long len = kind ## array_len(a);                                      \
+  if (len == 0)                                                         \
+    RUNTIME_ERROR(error_bad_value, "empty array");                      \
+  return BOX_ ## kind(kernels.kind ## _min(a->str, len));               \
+}                                                                       \
+                                                                        \
+TYPEDOP(kind ## array_max, ,                                            \
+        "`a -> `x. Returns the largest element of the non-empty "       \
+        #kind "array `a." pnote,                                        \
+        (struct string *a),                                             \
+        OP_LEAF | OP_NOESCAPE | OP_STR_READONLY | OP_CONST, "s." osig)  \
+{                                                                       \
+  CHECK_TYPES(a, string);                                               \
+  long len = kind ## array_len(a);                                      \
+  if (len == 0)                                                         \
+    RUNTIME_ERROR(error_bad_value, "empty array");                      \
+  return BOX_ ## kind(kernels.kind ## _max(a->str, len));               \
+}                                                                       \
+                                                                        \
+TYPEDOP(kind ## array_to_vector, ,                                      \
+        "`a -> `v. Returns a new vector of the elements of the "        \
+        #kind "array `a.",                                              \
+        (struct string *a),                                             \
+        OP_LEAF | OP_NOESCAPE | OP_STR_READONLY, "s.v")                 \
+{                                                                       \
+  CHECK_TYPES(a, string);                                               \
+  long len = kind ## array_len(a);                                      \
+  if (len > MAX_VECTOR_SIZE)                                            \
+    RUNTIME_ERROR(error_bad_value, "array too long");                   \
+  struct vector *v = NULL;                                              \
+  GCPRO(a, v);                                                          \
+  v = alloc_vector(len);                                                \
+  for (long i = 0; i < len; ++i)                                        \
+    {                                                                   \
+      value x = BOX_ ## kind(kind ## _get(a->str, i));                  \
+      v->data[i] = x;                                                   \
+    }                                                                   \
+  UNGCPRO();                                                            \
+  return v;                                                             \
+}                                                                       \
+                                                                        \
+TYPEDOP(vector_to_ ## kind ## array, ,                                  \
+        "`v -> `a. Returns a new " #kind "array with the elements of"   \
+        " `v, which must all be " what ".",                             \
+        (struct vector *v),                                             \
+        OP_LEAF | OP_NOESCAPE, "v.s")                                   \
+{                                                                       \
+  CHECK_TYPES(v, vector);                                               \
+  long len = vector_len(v);                                             \
+  GCPRO(v);                                                             \
+  struct string *a = alloc_empty_string(len * sizeof (ctype));          \
+  UNGCPRO();                                                            \
+  for (long i = 0; i < len; ++i)                                        \
+    {                                                                   \
+      if (!is_typeset(v->data[i], TYPESET_ ## kind))                    \
+        RUNTIME_ERROR(error_bad_type, NULL);                            \
+      const char *msg = NULL;                                           \
+      ctype e;                                                          \
+      enum runtime_error err = ct_ ## kind ## _elt(v->data[i], &msg, &e); \
+      if (err != error_none)                                            \
+        RUNTIME_ERROR(err, msg);                                        \
+      kind ## _put(a->str, i, e);                                       \
+    }                                                                   \
+  return a;                                                             \
+}
+
+DEF_TYPED_ARRAY(u8,  uint8_t, "bytes",            "n",   "n",      "")
+DEF_TYPED_ARRAY(i32, int32_t, "32-bit integers",  "B",   SIG_WIDE, "")
+DEF_TYPED_ARRAY(i64, int64_t, "64-bit integers",  "B",   "B",      "")
+DEF_TYPED_ARRAY(f64, double,  "numbers",          "D",   "d",
+                " NaN elements are ignored; if all elements are NaN, min"
+                " returns infinity and max -infinity.")
+
+/* The sums and dot products need their own accumulators */
+
+TYPEDOP(u8array_sum, , "`a -> `n. Returns the sum of the elements of the"
+        " u8array `a.",
+        (struct string *a),
+        OP_LEAF | OP_NOESCAPE | OP_STR_READONLY | OP_CONST, "s." SIG_WIDE)
+{
+  CHECK_TYPES(a, string);
+  return make_int_or_bigint(kernels.u8_sum(a->str, u8array_len(a)));
+}
+
+TYPEDOP(i32array_sum, , "`a -> `n. Returns the sum of the elements of the"
+        " i32array `a.",
+        (struct string *a),
+        OP_LEAF | OP_NOESCAPE | OP_STR_READONLY | OP_CONST, "s." SIG_WIDE)
+{
+  CHECK_TYPES(a, string);
+  return make_int_or_bigint(kernels.i32_sum(a->str, i32array_len(a)));
+}
+
+TYPEDOP(i64array_sum, , "`a -> `n. Returns the sum of the elements of the"
+        " i64array `a. Causes an error if the sum does not fit in 64"
+        " bits.",
+        (struct string *a),
+        OP_LEAF | OP_NOESCAPE | OP_STR_READONLY | OP_CONST, "s.B")
+{
+  CHECK_TYPES(a, string);
+  long len = i64array_len(a);
+  int64_t sum = 0;
+  for (long i = 0; i < len; ++i)
+    if (__builtin_add_overflow(sum, i64_get(a->str, i), &sum))
+      RUNTIME_ERROR(error_bad_value, "integer overflow");
+  return make_int_or_bigint(sum);
+}
+
+TYPEDOP(f64array_sum, , "`a -> `f. Returns the sum of the elements of the"
+        " f64array `a.",
+        (struct string *a),
+        OP_LEAF | OP_NOESCAPE | OP_STR_READONLY | OP_CONST, "s.d")
+{
+  CHECK_TYPES(a, string);
+  return alloc_float(kernels.f64_sum(a->str, f64array_len(a)));
+}
+
+#define CHECK_SAME_LENGTH(kind, a, b) do {                      \
+  if (kind ## array_len(a) != kind ## array_len(b))             \
+    RUNTIME_ERROR(error_bad_value, "array lengths differ");     \
+} while (0)
+
+TYPEDOP(u8array_dot, , "`a0 `a1 -> `n. Returns the dot product of the"
+        " u8arrays `a0 and `a1, which must have the same length.",
+        (struct string *a, struct string *b),
+        OP_LEAF | OP_NOESCAPE | OP_STR_READONLY | OP_CONST, "ss." SIG_WIDE)
+{
+  CHECK_TYPES(a, string,
+              b, string);
+  CHECK_SAME_LENGTH(u8, a, b);
+  long len = u8array_len(a);
+  /* cannot overflow as there are fewer than 2^32 elements */
+  uint64_t sum = 0;
+  for (long i = 0; i < len; ++i)
+    sum += (uint32_t)u8_get(a->str, i) * u8_get(b->str, i);
+  return make_int_or_bigint(sum);
+}
+
+TYPEDOP(i32array_dot, , "`a0 `a1 -> `n. Returns the dot product of the"
+        " i32arrays `a0 and `a1, which must have the same length."
+        " Causes an error if the result does not fit in 64 bits.",
+        (struct string *a, struct string *b),
+        OP_LEAF | OP_NOESCAPE | OP_STR_READONLY | OP_CONST, "ss.B")
+{
+  CHECK_TYPES(a, string,
+              b, string);
+  CHECK_SAME_LENGTH(i32, a, b);
+  long len = i32array_len(a);
+  int64_t sum = 0;
+  for (long i = 0; i < len; ++i)
+    if (__builtin_add_overflow(
+          sum, (int64_t)i32_get(a->str, i) * i32_get(b->str, i), &sum))
+      RUNTIME_ERROR(error_bad_value, "integer overflow");
+  return make_int_or_bigint(sum);
+}
+
+TYPEDOP(i64array_dot, , "`a0 `a1 -> `n. Returns the dot product of the"
+        " i64arrays `a0 and `a1, which must have the same length."
+        " Causes an error if the result does not fit in 64 bits.",
+        (struct string *a, struct string *b),
+        OP_LEAF | OP_NOESCAPE | OP_STR_READONLY | OP_CONST, "ss.B")
+{
+  CHECK_TYPES(a, string,
+              b, string);
+  CHECK_SAME_LENGTH(i64, a, b);
+  long len = i64array_len(a);
+  int64_t sum = 0;
+  for (long i = 0; i < len; ++i)
+    {
+      int64_t p;
+      if (__builtin_mul_overflow(i64_get(a->str, i), i64_get(b->str, i), &p)
+          || __builtin_add_overflow(sum, p, &sum))
+        RUNTIME_ERROR(error_bad_value, "integer overflow");
+    }
+  return make_int_or_bigint(sum);
+}
+
+TYPEDOP(f64array_dot, , "`a0 `a1 -> `f. Returns the dot product of the"
+        " f64arrays `a0 and `a1, which must have the same length.",
+        (struct string *a, struct string *b),
+        OP_LEAF | OP_NOESCAPE | OP_STR_READONLY | OP_CONST, "ss.d")
+{
+  CHECK_TYPES(a, string,
+              b, string);
+  CHECK_SAME_LENGTH(f64, a, b);
+  return alloc_float(kernels.f64_dot(a->str, b->str, f64array_len(a)));
+}
+
+#define DEFINE_TYPED_ARRAY(kind) do {           \
+  DEFINE(make_ ## kind ## array);               \
+  DEFINE(kind ## array_length);                 \
+  DEFINE(kind ## array_ref);                    \
+  DEFINE(kind ## array_set);                    \
+  DEFINE(kind ## array_fill);                   \
+  DEFINE(kind ## array_copy);                   \
+  DEFINE(kind ## array_slice);                  \
+  DEFINE(kind ## array_sum);                    \
+  DEFINE(kind ## array_min);                    \
+  DEFINE(kind ## array_max);                    \
+  DEFINE(kind ## array_dot);                    \
+  DEFINE(kind ## array_to_vector);              \
+  DEFINE(vector_to_ ## kind ## array);          \
+} while (0)
+
+void typedarray_init(void)
+{
+  DEFINE_TYPED_ARRAY(u8);
+  DEFINE_TYPED_ARRAY(i32);
+  DEFINE_TYPED_ARRAY(i64);
+  DEFINE_TYPED_ARRAY(f64);
+
+#ifdef USE_SIMD_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    {
+      kernels.u8_sum  = avx2_u8_sum;
+      kernels.u8_min  = avx2_u8_min;
+      kernels.u8_max  = avx2_u8_max;
+      kernels.i32_sum = avx2_i32_sum;
+      kernels.i32_min = avx2_i32_min;
+      kernels.i32_max = avx2_i32_max;
+      kernels.f64_sum = avx2_f64_sum;
+      kernels.f64_dot = avx2_f64_dot;
+      kernels.f64_min = avx2_f64_min;
+      kernels.f64_max = avx2_f64_max;
+    }
+  else if (__builtin_cpu_supports("sse2"))
+    {
+      kernels.u8_sum  = sse2_u8_sum;
+      kernels.u8_min  = sse2_u8_min;
+      kernels.u8_max  = sse2_u8_max;
+      kernels.i32_sum = sse2_i32_sum;
+      kernels.i32_min = sse2_i32_min;
+      kernels.i32_max = sse2_i32_max;
+      kernels.f64_sum = sse2_f64_sum;
+      kernels.f64_dot = sse2_f64_dot;
+      kernels.f64_min = sse2_f64_min;
+      kernels.f64_max = sse2_f64_max;
+    }
+#endif
+}
@@ -84,6 +84,8 @@ struct table *alloc_table(ulong size)
     type_table, grecord_fields(*newp));
   GCPRO(newp);
   newp->used = table_methods.make_used(0);
+  newp->resize_pos = makeint(0);
+  newp->changes = makeint(0);
   value vec = alloc_vector(size);
   newp->buckets = vec;
   UNGCPRO();
@@ -106,26 +108,36 @@ static const struct table_methods *get_methods(struct table *t)
   return is_ctable(t) ? &ctable_methods : &table_methods;
 }
 
+/* Tables with at least this many buckets are grown incrementally: the
+   old and new bucket vectors coexist, and each insertion moves
+   TABLE_RESIZE_STEP old buckets over until the old vector is empty.
+   Lookups from mudlle do the same through table_resize_step(), so that a
+   table that stops growing does not keep both vectors; C lookups never
+   modify the table. */
+#define TABLE_INCREMENTAL_SIZE 4096
+#define TABLE_RESIZE_STEP      32
+
 static ulong add_position;
 
-/* return position of the symbol, or -1 if not found; updates add_position */
-static long table_find(struct table *table, const char *name, size_t nlength)
+/* return position of name in buckets, or -1 if not found; *free_pos is set
+   to the position where name should be added */
+static long bucket_find(struct vector *buckets,
+                        const struct table_methods *methods,
+                        const char *name, size_t nlength, ulong *free_pos)
 {
-  const struct table_methods *methods = get_methods(table);
-
-  ulong size = vector_len(table->buckets);
+  ulong size = vector_len(buckets);
   int size_bits = ffs(size) - 1;
   assert(size <= UINT_MAX);
   assert(P(size_bits) == size);
 
   ulong hashcode = methods->hash(name, nlength, size_bits);
   long scan = hashcode;
-  struct symbol **bucket = (struct symbol **)&table->buckets->data[scan];
+  struct symbol **bucket = (struct symbol **)&buckets->data[scan];
   for (;;)
     {
       if (*bucket == NULL)
         {
-          add_position = scan;
+          *free_pos = scan;
           return -1;
         }
       if (string_len((*bucket)->name) == nlength
@@ -136,22 +148,91 @@ static long table_find(struct table *table, const char *name, size_t nlength)
       if (scan == size)
         {
           scan = 0;
-          bucket = (struct symbol **)&table->buckets->data[scan];
+          bucket = (struct symbol **)&buckets->data[scan];
         }
       assert(scan != hashcode);	/* The table is never allowed to be full */
     }
 }
 
+/* move up to n entries from table->old_buckets to table->buckets */
+static void resize_step(struct table *table, ulong n)
+{
+  const struct table_methods *methods = get_methods(table);
+  struct vector *old = table->old_buckets;
+  struct vector *buckets = table->buckets;
+  ulong osize = vector_len(old);
+  ulong size = vector_len(buckets);
+  int size_bits = ffs(size) - 1;
+
+  ulong pos = intval(table->resize_pos);
+  ulong end = n < osize - pos ? pos + n : osize;
+  for (; pos < end; ++pos)
+    {
+      struct symbol *sym = old->data[pos];
+      if (sym == NULL)
+        continue;
+      /* sym cannot be in buckets[] yet: it would have been found in
+         old_buckets[] first */
+      ulong scan = methods->hash(sym->name->str, string_len(sym->name),
+                                 size_bits);
+      while (buckets->data[scan])
+        scan = (scan + 1) & (size - 1);
+      buckets->data[scan] = sym;
+    }
+
+  if (pos < osize)
+    {
+      table->resize_pos = makeint(pos);
+      return;
+    }
+  table->old_buckets = NULL;
+  table->resize_pos = makeint(0);
+}
+
+void table_finish_resize(struct table *table)
+{
+  if (table->old_buckets)
+    resize_step(table, vector_len(table->old_buckets));
+}
+
+void table_resize_step(struct table *table)
+{
+  /* read-only tables are never resizing, but be careful anyway */
+  if (table->old_buckets && !obj_readonlyp(&table->o))
+    resize_step(table, TABLE_RESIZE_STEP);
+}
+
+/* return the symbol called name, or NULL if not found; updates
+   add_position */
+static struct symbol *table_find(struct table *table, const char *name,
+                                 size_t nlength)
+{
+  const struct table_methods *methods = get_methods(table);
+
+  long pos = bucket_find(table->buckets, methods, name, nlength,
+                         &add_position);
+  if (pos >= 0)
+    return table->buckets->data[pos];
+
+  /* old_buckets[] is left intact while resizing; any entry found before
+     resize_pos would also have been found in buckets[] */
+  if (table->old_buckets)
+    {
+      ulong unused;
+      pos = bucket_find(table->old_buckets, methods, name, nlength, &unused);
+      if (pos >= 0)
+        return table->old_buckets->data[pos];
+    }
+  return NULL;
+}
+
 /* Returns symbol for name in table, or NULL. table_add_fast() can be called
    immediately if you wish to add an entry to name to the symbol table (but no
    intervening call to the module should be made). */
 struct symbol *table_lookup_len(struct table *table, const char *name,
                                 size_t len)
 {
-  long pos = table_find(table, name, len);
-  if (pos < 0)
-    return NULL;
-  return table->buckets->data[pos];
+  return table_find(table, name, len);
 }
 
 struct symbol *table_mlookup_substring(struct table *table,
@@ -161,6 +242,85 @@ struct symbol *table_mlookup_substring(struct table *table,
   return table_lookup_len(table, name->str + idx, len);
 }
 
+/* The prefix index holds the number of indexed symbols, followed by the
+   symbols sorted by name, then spare room for additions. */
+
+/* compare names so that all names with a given prefix are adjacent */
+static int name_cmp(const char *a, ulong alen, const char *b, ulong blen,
+                    int (*compare)(const void *a, const void *b, size_t n))
+{
+  int r = compare(a, b, alen < blen ? alen : blen);
+  if (r != 0)
+    return r;
+  return alen < blen ? -1 : alen > blen;
+}
+
+static ulong index_entries(struct vector *index)
+{
+  return intval(index->data[0]);
+}
+
+/* return the position of the first symbol in index not ordered before
+   name */
+static ulong index_find(struct table *table, const char *name, ulong len)
+{
+  int (*compare)(const void *a, const void *b, size_t n)
+    = get_methods(table)->compare;
+  struct vector *index = table->prefix_index;
+  ulong lo = 1, hi = index_entries(index) + 1;
+  while (lo < hi)
+    {
+      ulong mid = lo + (hi - lo) / 2;
+      struct string *mname = ((struct symbol *)index->data[mid])->name;
+      if (name_cmp(mname->str, string_len(mname), name, len, compare) < 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+  return lo;
+}
+
+/* add sym to table's prefix index, if any; may GC */
+static void index_add(struct table *table, struct symbol *sym)
+{
+  if (table->prefix_index == NULL)
+    return;
+
+  ulong n = index_entries(table->prefix_index);
+  if (n + 1 == vector_len(table->prefix_index))
+    {
+      GCPRO(table, sym);
+      struct vector *index = alloc_vector(2 * n + 2);
+      UNGCPRO();
+      memcpy(index->data, table->prefix_index->data,
+             (n + 1) * sizeof index->data[0]);
+      table->prefix_index = index;
+    }
+
+  struct vector *index = table->prefix_index;
+  ulong pos = index_find(table, sym->name->str, string_len(sym->name));
+  memmove(&index->data[pos + 1], &index->data[pos],
+          (n + 1 - pos) * sizeof index->data[0]);
+  index->data[pos] = sym;
+  index->data[0] = makeint(n + 1);
+}
+
+/* remove sym from table's prefix index, if any */
+static void index_remove(struct table *table, struct symbol *sym)
+{
+  struct vector *index = table->prefix_index;
+  if (index == NULL)
+    return;
+
+  ulong n = index_entries(index);
+  ulong pos = index_find(table, sym->name->str, string_len(sym->name));
+  assert(pos <= n && index->data[pos] == sym);
+  memmove(&index->data[pos], &index->data[pos + 1],
+          (n - pos) * sizeof index->data[0]);
+  index->data[n] = NULL;
+  index->data[0] = makeint(n - 1);
+}
+
 struct symbol *table_remove(struct table *table, const char *name)
 {
   return table_remove_len(table, name, strlen(name));
@@ -173,7 +333,12 @@ struct symbol *table_remove_len(struct table *table, const char *name,
    Returns: false if the entry wasn't found
 */
 {
-  long scan = table_find(table, name, nlength);
+  table_finish_resize(table);
+
+  const struct table_methods *methods = get_methods(table);
+
+  ulong unused;
+  long scan = bucket_find(table->buckets, methods, name, nlength, &unused);
   if (scan < 0)
     return NULL;
 
@@ -186,8 +351,6 @@ struct symbol *table_remove_len(struct table *table, const char *name,
 
   *bucket = NULL;
 
-  const struct table_methods *methods = get_methods(table);
-
   for (;;)
     {
       ++bucket;
@@ -219,6 +382,8 @@ struct symbol *table_remove_len(struct table *table, const char *name,
       *newbuck = sym;
     }
   table->used = mudlle_iadd(table->used, -methods->used_delta);
+  table->changes = makeint(intval(table->changes) + 1);
+  index_remove(table, result);
   return result;
 }
 
@@ -335,6 +500,14 @@ struct symbol *table_add_sym_fast(struct table *table, struct symbol *sym)
 
   table->buckets->data[add_position] = sym;
   table->used = mudlle_iadd(table->used, methods->used_delta);
+  table->changes = makeint(intval(table->changes) + 1);
+
+  /* may GC */
+  index_add(table, sym);
+
+  /* must come after using add_position, as it may fill that bucket */
+  if (table->old_buckets)
+    resize_step(table, TABLE_RESIZE_STEP);
 
   /* If table is 3/4 full, increase its size */
   ulong max = size / 2 + size / 4;
@@ -345,19 +518,35 @@ struct symbol *table_add_sym_fast(struct table *table, struct symbol *sym)
   GCPRO(table, sym);
   struct vector *newp = alloc_vector(2 * size);
   UNGCPRO();
+
+  if (size >= TABLE_INCREMENTAL_SIZE)
+    {
+      /* normally a no-op, unless TABLE_RESIZE_STEP is too small */
+      table_finish_resize(table);
+      table->old_buckets = table->buckets;
+      table->buckets = newp;
+      table->resize_pos = makeint(0);
+      resize_step(table, TABLE_RESIZE_STEP);
+      return sym;
+    }
+
   struct vector *old = table->buckets;
   table->buckets = newp;
   table->used = methods->make_used(0);
 
+  /* the entries are the same, so keep the prefix index as it is */
+  struct vector *index = table->prefix_index;
+  table->prefix_index = NULL;
   for (long i = 0; i < size; ++i)
     {
       struct symbol *osym = old->data[i];
       if (osym == NULL)
         continue;
-      if (table_find(table, osym->name->str, string_len(osym->name)) >= 0)
+      if (table_find(table, osym->name->str, string_len(osym->name)))
         abort();
       table_add_sym_fast(table, osym);
     }
+  table->prefix_index = index;
   return sym;
 }
 
@@ -367,6 +556,8 @@ struct list *table_list(struct table *table)
      The order is arbitrary.
 */
 {
+  table_finish_resize(table);
+
   struct list *l = NULL;
   struct symbol *sym;
   ulong size = vector_len(table->buckets);
@@ -383,11 +574,86 @@ struct list *table_list(struct table *table)
   return l;
 }
 
+static int (*index_compare)(const void *a, const void *b, size_t n);
+
+static int index_sort_cmp(const void *_a, const void *_b)
+{
+  struct symbol *const *a = _a, *const *b = _b;
+  return name_cmp((*a)->name->str, string_len((*a)->name),
+                  (*b)->name->str, string_len((*b)->name),
+                  index_compare);
+}
+
+void table_set_prefix_index(struct table *table, bool enable)
+{
+  assert(!obj_readonlyp(&table->o));
+  if (!enable)
+    {
+      table->prefix_index = NULL;
+      return;
+    }
+  if (table->prefix_index)
+    return;
+
+  GCPRO(table);
+  struct vector *index = alloc_vector(table_entries(table) + 1);
+  UNGCPRO();
+
+  table_finish_resize(table);
+  struct vector *buckets = table->buckets;
+  ulong size = vector_len(buckets);
+  ulong n = 1;
+  for (ulong i = 0; i < size; ++i)
+    if (buckets->data[i])
+      index->data[n++] = buckets->data[i];
+  assert(n == vector_len(index));
+
+  index_compare = get_methods(table)->compare;
+  qsort(index->data + 1, n - 1, sizeof index->data[0], index_sort_cmp);
+
+  index->data[0] = makeint(n - 1);
+  table->prefix_index = index;
+}
+
+static struct list *index_prefix(struct table *table, struct string *prefix)
+{
+  int (*compare)(const void *a, const void *b, size_t n)
+    = get_methods(table)->compare;
+  struct vector *index = table->prefix_index;
+  ulong prelen = string_len(prefix);
+
+  ulong start = index_find(table, prefix->str, prelen);
+  ulong end = start;
+  for (ulong last = index_entries(index); end <= last; ++end)
+    {
+      struct string *name = ((struct symbol *)index->data[end])->name;
+      if (string_len(name) < prelen
+          || compare(name->str, prefix->str, prelen) != 0)
+        break;
+    }
+
+  struct list *l = NULL;
+  GCPRO(l, index);
+  while (end-- > start)
+    {
+      struct symbol *sym = index->data[end];
+      if (sym->data)
+        l = alloc_list(sym, l);
+    }
+  UNGCPRO();
+  return l;
+}
+
 struct list *table_prefix(struct table *table, struct string *prefix)
 /* Returns: A list of all the symbols in table whose name starts with
      prefix (case insensitive, like all table ops)
 */
 {
+  if (table->prefix_index)
+    return index_prefix(table, prefix);
+
+  table_finish_resize(table);
+
   ulong prelen = string_len(prefix);
   struct vector *buckets = table->buckets;
   ulong size = vector_len(table->buckets);
@@ -412,7 +678,25 @@ struct list *table_prefix(struct table *table, struct string *prefix)
   return l;
 }
 
-/* 'check' must not cause GC */
+struct symbol *table_next(struct table *table, ulong *pos)
+{
+  assert(table->old_buckets == NULL);
+  struct vector *buckets = table->buckets;
+  ulong size = vector_len(buckets);
+  for (ulong i = *pos; i < size; ++i)
+    {
+      struct symbol *sym = buckets->data[i];
+      if (sym && sym->data)
+        {
+          *pos = i + 1;
+          return sym;
+        }
+    }
+  *pos = size;
+  return NULL;
+}
+
+/* 'check' must not cause GC; does not modify table */
 struct symbol *table_exists(struct table *table,
                             bool (*check)(struct symbol *sym, void *data),
                             void *data)
@@ -423,6 +707,18 @@ struct symbol *table_exists(struct table *table,
     if (*bucket && check(*bucket, data))
       return *bucket;
 
+  if (table->old_buckets == NULL)
+    return NULL;
+
+  /* entries not yet moved to buckets[] */
+  size = vector_len(table->old_buckets);
+  for (long i = intval(table->resize_pos); i < size; ++i)
+    {
+      struct symbol *sym = table->old_buckets->data[i];
+      if (sym && check(sym, data))
+        return sym;
+    }
+
   return NULL;
 }
 
@@ -430,6 +726,8 @@ struct symbol *table_exists(struct table *table,
 void table_foreach(struct table *table, void *data,
                    void (*action)(struct symbol *, void *))
 {
+  table_finish_resize(table);
+
   GCPRO(table);
   long size = vector_len(table->buckets);
   for (long i = 0; i < size; ++i)
@@ -445,6 +743,7 @@ void table_foreach(struct table *table, void *data,
 struct table *table_shallow_copy(struct table *table)
 {
   assert(TYPE(table, table));
+  table_finish_resize(table);
   const struct table_methods *m = get_methods(table);
   size_t nbuckets = vector_len(table->buckets);
   GCPRO(table);
@@ -460,6 +759,8 @@ struct table *table_shallow_copy(struct table *table)
 /* makes a copy of the non-null elements of table */
 struct table *table_copy(struct table *table)
 {
+  table_finish_resize(table);
+
   struct vector *buckets = table->buckets;
   ulong blen = vector_len(buckets);
   ulong count = 0;
@@ -489,6 +790,8 @@ struct table *table_copy(struct table *table)
 
 void rehash_table(struct table *table)
 {
+  table_finish_resize(table);
+
   struct vector *buckets = table->buckets;
   ulong blen = vector_len(buckets);
 
@@ -506,7 +809,10 @@ void rehash_table(struct table *table)
 
   const struct table_methods *methods = get_methods(table);
   value oused = table->used;
+  value ochanges = table->changes;
+  struct vector *index = table->prefix_index;
   table->used = methods->make_used(0);
+  table->prefix_index = NULL;
 
   for (long i = 0; i < blen; ++i)
     {
@@ -516,13 +822,16 @@ void rehash_table(struct table *table)
 
       struct string *name = sym->name;
       assert(obj_readonlyp(&name->o));
-      if (table_find(table, name->str, string_len(name)) >= 0)
+      if (table_find(table, name->str, string_len(name)))
         abort();
       table_add_sym_fast(table, sym);
       assert(table->buckets == buckets);
     }
 
   assert(table->used == oused);
+  /* the entries are the same, so the prefix index is still valid */
+  table->changes = ochanges;
+  table->prefix_index = index;
 
   table->o.flags = tflags;
   buckets->o.flags = bflags;
@@ -530,14 +839,24 @@ void rehash_table(struct table *table)
   free(old);
 }
 
+static void protect_prefix_index(struct table *table, ulong flags)
+{
+  if (table->prefix_index)
+    table->prefix_index->o.flags |= flags;
+}
+
 void protect_table(struct table *table)
 {
+  table_finish_resize(table);
+  protect_prefix_index(table, OBJ_READONLY);
   table->o.flags |= OBJ_READONLY;
   table->buckets->o.flags |= OBJ_READONLY;
 }
 
 void immutable_table(struct table *table)
 {
+  table_finish_resize(table);
+  protect_prefix_index(table, OBJ_READONLY | OBJ_IMMUTABLE);
   table->o.flags |= OBJ_READONLY | OBJ_IMMUTABLE;
   table->buckets->o.flags |= OBJ_READONLY | OBJ_IMMUTABLE;
 }
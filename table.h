@@ -106,7 +106,40 @@ struct list *table_list(struct table *table);
 
 struct list *table_prefix(struct table *table, struct string *prefix);
 /* Returns: A list of all the symbols in table whose name starts with
-     prefix (case insensitive, like all table ops)
+     prefix (case insensitive, like all table ops). If table has a prefix
+     index, the list is sorted by name.
+*/
+
+void table_set_prefix_index(struct table *table, bool enable);
+/* Effects: Makes table keep (or drop) a sorted index of its names, making
+     table_prefix() O(log n + results). The index is kept sorted as
+     entries are added or removed.
+   Requires: table not be readonly.
+   Modifies: table
+   May GC.
+*/
+
+void table_finish_resize(struct table *table);
+/* Effects: Completes any incremental resize of table, so that all its
+     entries are in table->buckets.
+   Modifies: table
+*/
+
+void table_resize_step(struct table *table);
+/* Effects: Moves a bounded number of entries of table to table->buckets
+     if it is being resized incrementally and is not read-only. Lookup
+     primitives call this so that a table that stops growing eventually
+     completes its resize.
+   Modifies: table
+   Does not allocate.
+*/
+
+struct symbol *table_next(struct table *table, ulong *pos);
+/* Requires: table not be resizing (cf. table_finish_resize()).
+   Returns: The first symbol in table->buckets at or after *pos whose value
+     is non-null, or NULL if there is none. *pos is set to the position
+     after the returned symbol.
+   Does not allocate.
 */
 
 void protect_table(struct table *table);
@@ -298,6 +298,10 @@ struct table			/* Is a record */
   struct obj o;
   value used;                   /* ~n for case/accent-sensitive tables */
   struct vector *buckets;       /* vector_len() must be power of 2 */
+  struct vector *old_buckets;   /* previous buckets while resizing, or NULL */
+  value resize_pos;             /* next old_buckets[] entry to move */
+  value changes;                /* counts entry additions and removals */
+  struct vector *prefix_index;  /* [count, sorted symbols...] or NULL */
 };
 
 /* can be either a string or a record */
@@ -338,8 +342,25 @@ void check_bigint(struct bigint *bi);
    records identified by their first element with one of the following
    constants: */
 enum mprivate_type {
-  PRIVATE_MJMPBUF = 1,
-  PRIVATE_REGEXP  = 2,
+  PRIVATE_MJMPBUF  = 1,
+  PRIVATE_REGEXP   = 2,
+  PRIVATE_SBUILDER = 3,
+  PRIVATE_SSLICE   = 4,
+  PRIVATE_KMATCHER = 5,
+  PRIVATE_CFORMAT  = 6,
+  PRIVATE_IPORT    = 7,
+  PRIVATE_EVLOOP   = 8,
+  PRIVATE_WITER    = 9,
+  PRIVATE_TITER    = 10,
+  PRIVATE_HMAP     = 11,
+  PRIVATE_OMAP     = 12,
+  PRIVATE_PQUEUE   = 13,
+  PRIVATE_PQENTRY  = 14,
+  PRIVATE_TWHEEL   = 15,
+  PRIVATE_TIMER    = 16,
+  PRIVATE_DEQUE    = 17,
+  PRIVATE_CSRGRAPH = 18,
+  PRIVATE_RBITSET  = 19,
 };
 
 struct mprivate *alloc_private(enum mprivate_type id, ulong size);